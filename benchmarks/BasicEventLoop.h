@@ -0,0 +1,221 @@
+#pragma once
+
+// 静态分发版本的 Channel / Poller / EventLoop，只给 bench_dispatch 用来
+// 对比分发开销，不属于库本身。库里没有可选的静态分发路径：TcpConnection
+// 等连接类型仍然只走虚函数 Poller + std::function 回调。bench_dispatch
+// 测得的差距约 5%，不足以维护第二套 reactor。
+//
+// 默认的 EventLoop 通过虚函数 Poller::poll 拿到 Channel，再经 std::function
+// 回调到 TcpConnection。这里的模板版本在编译期确定 Poller 类型和 Handler 类型：
+// Channel 直接持有 Handler*，事件分发是普通的成员函数调用，可以被内联。
+//
+// Handler 需要提供：
+//   void handleRead();
+//   void handleWrite();
+//   void handleClose();
+
+#include "Channel.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+template <typename Handler> class BasicChannel {
+public:
+  BasicChannel(int fd, Handler *handler)
+      : fd_(fd), handler_(handler), inEpoll_(false), events_(0), revents_(0) {}
+
+  int getFd() const { return fd_; }
+  uint32_t getEvents() const { return events_; }
+  void setEvents(uint32_t events) { events_ = events; }
+  void setReadEvent(uint32_t rev) { revents_ = rev; }
+  bool isInEpoll() const { return inEpoll_; }
+  void setInEpoll(bool on) { inEpoll_ = on; }
+  bool isWriting() const { return events_ & EPOLLOUT; }
+
+  void handleEvent() {
+    if (revents_ & EPOLLRDHUP) {
+      handler_->handleClose();
+      return;
+    }
+    if (revents_ & (EPOLLIN | EPOLLPRI)) {
+      handler_->handleRead();
+    }
+    if ((revents_ & EPOLLOUT) && isWriting()) {
+      handler_->handleWrite();
+    }
+  }
+
+private:
+  int fd_;
+  Handler *handler_;
+  bool inEpoll_;
+  uint32_t events_;
+  uint32_t revents_;
+};
+
+// 非虚的 epoll 封装，和 Epoll 行为一致
+template <typename Handler> class BasicEpoll {
+public:
+  using ChannelType = BasicChannel<Handler>;
+
+  BasicEpoll() : epollfd_(::epoll_create1(EPOLL_CLOEXEC)), events_(1024) {
+    if (epollfd_ == -1) {
+      logError(strerror(errno), __func__);
+      exit(EXIT_FAILURE);
+    }
+  }
+  ~BasicEpoll() { ::close(epollfd_); }
+
+  BasicEpoll(const BasicEpoll &) = delete;
+  BasicEpoll &operator=(const BasicEpoll &) = delete;
+
+  // 返回就绪事件数，ptrs[i] 为注册时的 data.ptr
+  int poll(std::vector<void *> &ptrs, int timeoutMs) {
+    int nfds;
+    do {
+      nfds = ::epoll_wait(epollfd_, events_.data(), events_.size(), timeoutMs);
+    } while (nfds < 0 && errno == EINTR);
+    for (int i = 0; i < nfds; ++i) {
+      ptrs.push_back(events_[i].data.ptr);
+      if (ptrs.back() != nullptr) {
+        static_cast<ChannelType *>(ptrs.back())
+            ->setReadEvent(events_[i].events);
+      }
+    }
+    if (nfds == static_cast<int>(events_.size())) {
+      events_.resize(events_.size() * 2);
+    }
+    return nfds;
+  }
+
+  void updateChannel(ChannelType *channel) {
+    struct epoll_event ev;
+    bzero(&ev, sizeof(ev));
+    ev.data.ptr = channel;
+    ev.events = channel->getEvents();
+    int op = channel->isInEpoll() ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (::epoll_ctl(epollfd_, op, channel->getFd(), &ev) == -1) {
+      logError(strerror(errno), __func__);
+    }
+    channel->setInEpoll(true);
+  }
+
+  void removeChannel(ChannelType *channel) {
+    if (channel->isInEpoll()) {
+      ::epoll_ctl(epollfd_, EPOLL_CTL_DEL, channel->getFd(), nullptr);
+      channel->setInEpoll(false);
+    }
+  }
+
+  // 注册 data.ptr 为 nullptr 的内部 fd（loop 的 eventfd），不经过 Channel
+  void addInternalFd(int fd) {
+    struct epoll_event ev;
+    bzero(&ev, sizeof(ev));
+    ev.data.ptr = nullptr;
+    ev.events = EPOLLIN;
+    ::epoll_ctl(epollfd_, EPOLL_CTL_ADD, fd, &ev);
+  }
+
+private:
+  int epollfd_;
+  std::vector<epoll_event> events_;
+};
+
+// 编译期确定 Poller 与 Handler 的 EventLoop，接口与 EventLoop 保持一致
+template <typename Handler,
+          template <typename> class PollerT = BasicEpoll>
+class BasicEventLoop {
+public:
+  using PollerType = PollerT<Handler>;
+  using ChannelType = BasicChannel<Handler>;
+
+  BasicEventLoop()
+      : quit_(false), threadId_(std::this_thread::get_id()),
+        wakeupFd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if (wakeupFd_ < 0) {
+      logError("Failed to create wakeupFd", __func__);
+    }
+    poller_.addInternalFd(wakeupFd_);
+  }
+  ~BasicEventLoop() { ::close(wakeupFd_); }
+
+  BasicEventLoop(const BasicEventLoop &) = delete;
+  BasicEventLoop &operator=(const BasicEventLoop &) = delete;
+
+  void loop() {
+    std::vector<void *> active;
+    while (!quit_) {
+      active.clear();
+      poller_.poll(active, -1);
+      for (void *ptr : active) {
+        if (ptr == nullptr) {
+          handleWakeup();
+        } else {
+          static_cast<ChannelType *>(ptr)->handleEvent();
+        }
+      }
+      doPendingFunctions();
+    }
+  }
+
+  void quit() {
+    quit_ = true;
+    if (!isInLoopThread()) {
+      wakeup();
+    }
+  }
+
+  PollerType *getPoller() { return &poller_; }
+  bool isInLoopThread() const {
+    return threadId_ == std::this_thread::get_id();
+  }
+
+  void queueInLoop(std::function<void()> func) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pendingFuncs_.push_back(std::move(func));
+    }
+    if (!isInLoopThread()) {
+      wakeup();
+    }
+  }
+
+  void wakeup() {
+    uint64_t one = 1;
+    ssize_t n = ::write(wakeupFd_, &one, sizeof(one));
+    (void)n;
+  }
+
+private:
+  void handleWakeup() {
+    uint64_t one;
+    ssize_t n = ::read(wakeupFd_, &one, sizeof(one));
+    (void)n;
+  }
+
+  void doPendingFunctions() {
+    std::vector<std::function<void()>> functions;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      functions.swap(pendingFuncs_);
+    }
+    for (const auto &func : functions) {
+      func();
+    }
+  }
+
+  PollerType poller_;
+  std::atomic<bool> quit_;
+  std::vector<std::function<void()>> pendingFuncs_;
+  std::mutex mutex_;
+  const std::thread::id threadId_;
+  int wakeupFd_;
+};
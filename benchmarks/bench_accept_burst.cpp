@@ -0,0 +1,100 @@
+// 连接洪峰：客户端一次发起 burst 个非阻塞 connect，等服务器把它们全部建立
+// （connectionCallback 被调用），然后全部关闭，重复 rounds 轮。统计每轮从
+// 第一个 connect 到最后一个连接建立的时间。
+//
+// 用法: bench_accept_burst [burst] [rounds] [threads]
+
+#include "TcpServer.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static constexpr uint16_t kPort = 19546;
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<int> gEstablished{0};
+
+static void runServer(int threads, std::atomic<TcpServer *> &out) {
+  TcpServer server("127.0.0.1", kPort);
+  server.setThreadNum(threads);
+  server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      gEstablished.fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  server.setMessageCallback([](const TcpConnectionPtr &, Buffer &buf) {
+    buf.retrieveAll();
+  });
+  out = &server;
+  server.start();
+}
+
+static std::vector<int> connectBurst(int burst) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  std::vector<int> fds;
+  fds.reserve(burst);
+  for (int i = 0; i < burst; ++i) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    fds.push_back(fd);
+  }
+  return fds;
+}
+
+int main(int argc, char *argv[]) {
+  int burst = argc > 1 ? atoi(argv[1]) : 512;
+  int rounds = argc > 2 ? atoi(argv[2]) : 50;
+  int threads = argc > 3 ? atoi(argv[3]) : 4;
+  setLogEnabled(false);
+
+  std::atomic<TcpServer *> server{nullptr};
+  std::thread t(runServer, threads, std::ref(server));
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  double totalUs = 0;
+  double worstUs = 0;
+  int expected = 0;
+  for (int r = 0; r < rounds; ++r) {
+    Clock::time_point start = Clock::now();
+    std::vector<int> fds = connectBurst(burst);
+    expected += burst;
+    Clock::time_point deadline = start + std::chrono::seconds(5);
+    while (gEstablished.load(std::memory_order_relaxed) < expected &&
+           Clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+    double us =
+        std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    totalUs += us;
+    worstUs = std::max(worstUs, us);
+    for (int fd : fds) {
+      ::close(fd);
+    }
+    // 等服务器处理完关闭，下一轮从空闲状态开始
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+
+  printf("%d threads, %d rounds of %d connects: established %d/%d\n", threads,
+         rounds, burst, gEstablished.load(), expected);
+  printf("burst to all established: avg %.0f us, worst %.0f us, "
+         "%.0f connections/s\n",
+         totalUs / rounds, worstUs, expected / totalUs * 1e6);
+
+  server.load()->stop();
+  t.join();
+  return 0;
+}
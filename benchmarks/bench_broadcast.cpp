@@ -0,0 +1,124 @@
+// 广播开销：服务端把同一条消息发给所有连接，对比
+//   send     在调用线程里逐个 conn->send(msg)，每个连接一次拷贝、一次投递
+//   broadcast  TcpServer::broadcast，一次拷贝，每个 I/O loop 一次投递
+// 统计调用线程花费的时间和所有客户端收齐的时间。
+//
+// 用法: bench_broadcast [connections] [messages] [message_size]
+
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr uint16_t kPort = 19542;
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<uint64_t> gReceived{0};
+static std::mutex gConnsMutex;
+static std::vector<TcpConnectionPtr> gServerConns;
+
+static void runServer(std::atomic<TcpServer *> &out) {
+  TcpServer server("127.0.0.1", kPort);
+  server.setThreadNum(4);
+  server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      std::lock_guard<std::mutex> lock(gConnsMutex);
+      gServerConns.push_back(conn);
+    }
+  });
+  out = &server;
+  server.start();
+}
+
+static void runClients(int connections, std::atomic<EventLoop *> &out) {
+  EventLoop loop;
+  std::vector<std::unique_ptr<TcpClient>> clients;
+  for (int i = 0; i < connections; ++i) {
+    auto client = std::make_unique<TcpClient>(
+        &loop, InetAddress("127.0.0.1", kPort), "subscriber");
+    client->setConnectionCallback([](const TcpConnectionPtr &) {});
+    client->setMessageCallback([](const TcpConnectionPtr &, Buffer &buf) {
+      gReceived.fetch_add(buf.readableBytes(), std::memory_order_relaxed);
+      buf.retrieveAll();
+    });
+    client->connect();
+    clients.push_back(std::move(client));
+  }
+  out = &loop;
+  loop.loop();
+  for (auto &client : clients) {
+    client->disconnect();
+  }
+}
+
+template <typename Fanout>
+static void run(const char *label, int connections, int messages,
+                size_t messageSize, Fanout fanout) {
+  gReceived = 0;
+  uint64_t expected = static_cast<uint64_t>(connections) * messages *
+                      messageSize;
+  std::string message(messageSize, 'm');
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < messages; ++i) {
+    fanout(message);
+  }
+  double callerSecs =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  while (gReceived.load() < expected) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  double totalSecs =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  printf("%-9s %d conns x %d messages: caller %.2f ms, delivered %.2f ms\n",
+         label, connections, messages, callerSecs * 1e3, totalSecs * 1e3);
+}
+
+int main(int argc, char *argv[]) {
+  int connections = argc > 1 ? atoi(argv[1]) : 2000;
+  int messages = argc > 2 ? atoi(argv[2]) : 100;
+  size_t messageSize = argc > 3 ? atoi(argv[3]) : 128;
+  setLogEnabled(false);
+
+  std::atomic<TcpServer *> server{nullptr};
+  std::thread serverThread(runServer, std::ref(server));
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::atomic<EventLoop *> clientLoop{nullptr};
+  std::thread clientThread(runClients, connections, std::ref(clientLoop));
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(gConnsMutex);
+      if (gServerConns.size() == static_cast<size_t>(connections)) {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  run("send", connections, messages, messageSize,
+      [](const std::string &message) {
+        for (const TcpConnectionPtr &conn : gServerConns) {
+          conn->send(message);
+        }
+      });
+  run("broadcast", connections, messages, messageSize,
+      [&server](const std::string &message) {
+        server.load()->broadcast(message);
+      });
+
+  gServerConns.clear();
+  clientLoop.load()->quit();
+  clientThread.join();
+  server.load()->stop();
+  serverThread.join();
+  return 0;
+}
@@ -0,0 +1,133 @@
+// 流量录制的开销：两个 echo 服务器，一个不录制，一个 setCapture 录到文件，
+// 各自用 connections 个连接并发 ping-pong，比较每个往返的平均延迟，
+// 并报告录制文件大小（默认 /tmp/bench_capture.rcap，可以接着用
+// traffic_replay 重放）。
+//
+// 用法: bench_capture [connections] [round_trips_per_connection] [output]
+
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "TrafficCapture.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+static constexpr uint16_t kPlainPort = 19549;
+static constexpr uint16_t kCapturePort = 19550;
+static constexpr size_t kMessageSize = 128;
+
+using Clock = std::chrono::steady_clock;
+
+static void runServer(uint16_t port,
+                      const std::shared_ptr<TrafficCapture> &capture,
+                      std::atomic<TcpServer *> &out) {
+  TcpServer server("127.0.0.1", port);
+  server.setThreadNum(1);
+  server.setCapture(capture);
+  server.setConnectionCallback([](const TcpConnectionPtr &) {});
+  server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer &buf) {
+    conn->send(buf.retrieveAllAsString());
+  });
+  out = &server;
+  server.start();
+}
+
+// 所有连接同时 ping-pong，返回每个往返的平均微秒数
+static double pingPongUs(uint16_t port, int connections, int roundTrips) {
+  EventLoop loop;
+  std::string message(kMessageSize, 'c');
+  std::vector<std::unique_ptr<TcpClient>> clients;
+  int remaining = connections;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < connections; ++i) {
+    auto client = std::make_unique<TcpClient>(
+        &loop, InetAddress("127.0.0.1", port), "capture");
+    client->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+      if (conn->connected()) {
+        conn->send(message);
+      }
+    });
+    auto done = std::make_shared<int>(0);
+    client->setMessageCallback(
+        [&, done](const TcpConnectionPtr &conn, Buffer &buf) {
+          while (buf.readableBytes() >= kMessageSize) {
+            buf.retrieve(kMessageSize);
+            if (++*done == roundTrips) {
+              conn->shutdown();
+              if (--remaining == 0) {
+                loop.quit();
+              }
+              return;
+            }
+            conn->send(message);
+          }
+        });
+    client->connect();
+    clients.push_back(std::move(client));
+  }
+  loop.loop();
+  double us =
+      std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+  return us / (static_cast<double>(connections) * roundTrips);
+}
+
+static double measure(uint16_t port,
+                      const std::shared_ptr<TrafficCapture> &capture,
+                      int connections, int roundTrips) {
+  std::atomic<TcpServer *> server{nullptr};
+  std::thread t(runServer, port, capture, std::ref(server));
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  double us = pingPongUs(port, connections, roundTrips);
+  // 等服务端处理完关闭
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  server.load()->stop();
+  t.join();
+  return us;
+}
+
+int main(int argc, char *argv[]) {
+  int connections = argc > 1 ? atoi(argv[1]) : 16;
+  int roundTrips = argc > 2 ? atoi(argv[2]) : 2000;
+  std::string output = argc > 3 ? argv[3] : "/tmp/bench_capture.rcap";
+  setLogEnabled(false);
+
+  double plainUs = measure(kPlainPort, nullptr, connections, roundTrips);
+  uint64_t dropped = 0;
+  uint64_t truncated = 0;
+  double captureUs = 0;
+  {
+    auto capture = TrafficCapture::open(output);
+    if (!capture) {
+      return 1;
+    }
+    captureUs = measure(kCapturePort, capture, connections, roundTrips);
+    dropped = capture->droppedBytes();
+    truncated = capture->truncatedConnections();
+    // 析构时写完剩余记录
+  }
+
+  struct stat st;
+  off_t fileSize = ::stat(output.c_str(), &st) == 0 ? st.st_size : 0;
+  uint64_t payload =
+      static_cast<uint64_t>(connections) * roundTrips * kMessageSize;
+  printf("%d connections x %d round trips of %zu bytes\n", connections,
+         roundTrips, kMessageSize);
+  printf("capture off: %.2f us per round trip\n", plainUs);
+  printf("capture on:  %.2f us per round trip\n", captureUs);
+  printf("%s: %lld bytes for %llu payload bytes (%.1f%% overhead), "
+         "%llu bytes dropped (%llu connections truncated)\n",
+         output.c_str(), static_cast<long long>(fileSize),
+         static_cast<unsigned long long>(payload),
+         payload > 0 ? (static_cast<double>(fileSize) / payload - 1) * 100 : 0,
+         static_cast<unsigned long long>(dropped),
+         static_cast<unsigned long long>(truncated));
+  return 0;
+}
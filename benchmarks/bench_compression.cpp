@@ -0,0 +1,353 @@
+// 连接级 deflate 压缩与明文对比。客户端发一条 JSON 风格的消息，等服务端
+// 原样回显完整后校验内容再发下一条，统计往返延迟、线上字节、压缩比和
+// 两端压缩 / 解压花的 CPU 时间。三种组合：
+//   plain      两端都不开压缩
+//   deflate    两端都开压缩
+//   fallback   不开压缩的客户端连开了压缩的服务端，应当退回明文
+//   coroutine  两端都开压缩，服务端用协程 readUntil / write 回显
+// 回环上带宽不是瓶颈，这里主要看压缩比和每条消息多花的 CPU 时间。
+// 之后检查开了压缩的服务端先说话时，等不到 hello 的明文客户端能在协商超时后
+// 收到欢迎消息；最后用裸 socket 发一个解压后远超帧上限的小帧（解压炸弹），
+// 服务端应当断开。
+//
+// 用法: bench_compression [messages] [message_bytes] [level]
+
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "Task.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+static constexpr uint16_t kPlainPort = 19558;
+static constexpr uint16_t kDeflatePort = 19559;
+static constexpr uint16_t kCoroutinePort = 19560;
+static constexpr uint16_t kBannerPort = 19561;
+static const std::string kBanner = "220 ready\r\n";
+
+using Clock = std::chrono::steady_clock;
+
+// 服务端连接断开时把压缩统计汇总到这里
+struct ServerStats {
+  std::atomic<uint64_t> compressNs{0};
+  std::atomic<uint64_t> decompressNs{0};
+  std::atomic<int> compressed{0};
+  std::atomic<int> closed{0};
+};
+
+enum class Mode { kEcho, kCoroutine, kBanner };
+
+// 每条消息是一个 JSON 数组，只有结尾是 ']'
+static Task<> serve(TcpConnectionPtr conn) {
+  while (true) {
+    std::string msg = co_await conn->readUntil("]");
+    if (msg.empty() || msg.back() != ']' || !co_await conn->write(msg)) {
+      break;
+    }
+  }
+}
+
+static void runServer(uint16_t port, const CompressionOptions *compression,
+                      Mode mode, ServerStats &stats,
+                      std::atomic<TcpServer *> &out) {
+  TcpServer server("127.0.0.1", port);
+  server.setThreadNum(1);
+  if (compression != nullptr) {
+    server.setCompression(*compression);
+  }
+  server.setConnectionCallback([&stats, mode](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      if (mode == Mode::kCoroutine) {
+        serve(conn).detach();
+      } else if (mode == Mode::kBanner) {
+        conn->send(kBanner);
+      }
+      return;
+    }
+    if (const CompressionStats *s = conn->compressionStats()) {
+      stats.compressNs += s->compressTime.count();
+      stats.decompressNs += s->decompressTime.count();
+    }
+    stats.compressed += conn->isCompressed() ? 1 : 0;
+    ++stats.closed;
+  });
+  if (mode != Mode::kCoroutine) {
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer &buf) {
+      conn->send(buf.retrieveAllAsString());
+    });
+  }
+  out = &server;
+  server.start();
+}
+
+// 生成一批大小约为 size 的 JSON 记录，字段值随机，键和结构重复
+static std::string makeMessage(std::mt19937 &rng, size_t size) {
+  static const char *const kStatus[] = {"active", "idle", "suspended"};
+  static const char *const kRegion[] = {"cn-north", "cn-east", "us-west",
+                                        "eu-central"};
+  std::string msg = "[";
+  char record[256];
+  while (msg.size() < size) {
+    int n = snprintf(
+        record, sizeof(record),
+        "{\"id\":%u,\"user\":\"user-%u\",\"status\":\"%s\",\"region\":\"%s\","
+        "\"score\":%u.%02u,\"ts\":%u},",
+        static_cast<unsigned>(rng() % 1000000),
+        static_cast<unsigned>(rng() % 5000), kStatus[rng() % 3],
+        kRegion[rng() % 4], static_cast<unsigned>(rng() % 1000),
+        static_cast<unsigned>(rng() % 100),
+        1700000000u + static_cast<unsigned>(rng() % 86400));
+    msg.append(record, n);
+  }
+  msg.back() = ']';
+  return msg;
+}
+
+// 返回回显的内容是否全部正确
+static bool run(const char *label, uint16_t port, bool compress,
+                const CompressionOptions &options, ServerStats &serverStats,
+                int messages, size_t messageBytes) {
+  EventLoop loop;
+  TcpClient client(&loop, InetAddress("127.0.0.1", port), label);
+  if (compress) {
+    client.enableCompression(options);
+  }
+  std::mt19937 rng(42);
+  std::string expected;
+  std::string echoed;
+  std::vector<double> latencies;
+  latencies.reserve(messages);
+  size_t payloadBytes = 0;
+  size_t mismatches = 0;
+  bool compressed = false;
+  CompressionStats clientStats;
+  Clock::time_point sentAt;
+  Clock::time_point start;
+
+  auto sendNext = [&](const TcpConnectionPtr &conn) {
+    expected = makeMessage(rng, messageBytes);
+    echoed.clear();
+    payloadBytes += expected.size();
+    sentAt = Clock::now();
+    conn->send(expected);
+  };
+  client.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      start = Clock::now();
+      sendNext(conn);
+    } else {
+      loop.quit();
+    }
+  });
+  client.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer &buf) {
+    echoed += buf.retrieveAllAsString();
+    if (echoed.size() < expected.size()) {
+      return;
+    }
+    latencies.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - sentAt)
+            .count());
+    mismatches += echoed != expected ? 1 : 0;
+    if (static_cast<int>(latencies.size()) < messages) {
+      sendNext(conn);
+      return;
+    }
+    compressed = conn->isCompressed();
+    if (const CompressionStats *s = conn->compressionStats()) {
+      clientStats = *s;
+    }
+    // 服务端看到 EOF 后关闭连接，客户端的连接回调里退出
+    conn->shutdown();
+  });
+  int closedBefore = serverStats.closed.load();
+  int compressedBefore = serverStats.compressed.load();
+  uint64_t compressNsBefore = serverStats.compressNs.load();
+  uint64_t decompressNsBefore = serverStats.decompressNs.load();
+  client.connect();
+  loop.loop();
+  double secs = std::chrono::duration<double>(Clock::now() - start).count();
+  // 服务端在连接关闭时才汇总统计
+  while (serverStats.closed.load() == closedBefore) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  double n = static_cast<double>(messages);
+  printf("%-9s %s, %d msgs of %zu bytes, %zu mismatched: %.0f msgs/s, "
+         "rtt p50 %.1f us p99 %.1f us\n",
+         label, compressed ? "compressed" : "plain", messages,
+         payloadBytes / messages, mismatches, n / secs,
+         latencies[latencies.size() / 2],
+         latencies[latencies.size() * 99 / 100]);
+  if (!compress) {
+    printf("          server side %s\n",
+           serverStats.compressed.load() > compressedBefore ? "compressed"
+                                                            : "plain");
+    return mismatches == 0;
+  }
+  // 请求方向是客户端压缩，回显方向是服务端压缩，两个方向的数据相同
+  printf("          wire bytes out %lu (ratio %.2f), in %lu (ratio %.2f); "
+         "frames %lu deflate %lu raw\n",
+         clientStats.wireBytesOut, clientStats.ratioOut(),
+         clientStats.wireBytesIn, clientStats.ratioIn(),
+         clientStats.framesCompressed, clientStats.framesRaw);
+  auto perMsg = [n](uint64_t ns) { return ns / 1000.0 / n; };
+  printf("          cpu per msg: client deflate %.2f us inflate %.2f us, "
+         "server deflate %.2f us inflate %.2f us\n",
+         perMsg(clientStats.compressTime.count()),
+         perMsg(clientStats.decompressTime.count()),
+         perMsg(serverStats.compressNs.load() - compressNsBefore),
+         perMsg(serverStats.decompressNs.load() - decompressNsBefore));
+  return mismatches == 0;
+}
+
+static int connectTo(uint16_t port) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  timeval timeout{5, 0};
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+// 明文客户端等服务端先发欢迎消息，返回是否收到
+static bool banner(uint16_t port, const CompressionOptions &options) {
+  int fd = connectTo(port);
+  if (fd < 0) {
+    return false;
+  }
+  Clock::time_point start = Clock::now();
+  std::string got;
+  char buf[256];
+  ssize_t n;
+  while (got.size() < kBanner.size() &&
+         (n = ::read(fd, buf, sizeof(buf))) > 0) {
+    got.append(buf, n);
+  }
+  ::close(fd);
+  printf("banner    plain client waiting for the server: %s after %.0f ms "
+         "(negotiation timeout %lld ms)\n",
+         got == kBanner ? "received" : "NOT received",
+         std::chrono::duration<double, std::milli>(Clock::now() - start)
+             .count(),
+         static_cast<long long>(options.negotiationTimeout.count()));
+  return got == kBanner;
+}
+
+// 握手之后发一帧 64MB 的 0 压缩成的 deflate 数据，返回服务端是否断开了连接
+static bool bomb(uint16_t port) {
+  int fd = connectTo(port);
+  if (fd < 0) {
+    return false;
+  }
+  const char hello[] = {'R', 'Z', 'C', CompressionCodec::kVersion,
+                        1 << CompressionCodec::kDeflate};
+  char ack[CompressionCodec::kHandshakeSize];
+  ::write(fd, hello, sizeof(hello));
+  ::read(fd, ack, sizeof(ack));
+
+  std::string zeros(64 << 20, '\0');
+  std::string body(::compressBound(zeros.size()), '\0');
+  z_stream z{};
+  ::deflateInit2(&z, 9, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+  z.next_in = reinterpret_cast<Bytef *>(zeros.data());
+  z.avail_in = static_cast<uInt>(zeros.size());
+  z.next_out = reinterpret_cast<Bytef *>(body.data());
+  z.avail_out = static_cast<uInt>(body.size());
+  ::deflate(&z, Z_SYNC_FLUSH);
+  body.resize(body.size() - z.avail_out);
+  ::deflateEnd(&z);
+  uint32_t len = htonl(static_cast<uint32_t>(body.size()));
+  std::string frame(1, static_cast<char>(CompressionCodec::kDeflateFrame));
+  frame.append(reinterpret_cast<const char *>(&len), sizeof(len));
+  frame += body;
+  ::write(fd, frame.data(), frame.size());
+
+  // 服务端断开时读到 EOF
+  char buf[4096];
+  ssize_t n;
+  while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+  }
+  ::close(fd);
+  printf("bomb      %zu byte frame inflating to 64 MB: connection %s\n",
+         frame.size(), n == 0 ? "closed" : "still open");
+  return n == 0;
+}
+
+int main(int argc, char *argv[]) {
+  int messages = argc > 1 ? atoi(argv[1]) : 20000;
+  size_t messageBytes = argc > 2 ? atol(argv[2]) : 4096;
+  CompressionOptions options;
+  options.level = argc > 3 ? atoi(argv[3]) : 1;
+  if (messages <= 0) {
+    return 1;
+  }
+  setLogEnabled(false);
+
+  struct Server {
+    Server(uint16_t port, const CompressionOptions *compression, Mode mode)
+        : port(port), compression(compression), mode(mode) {}
+    uint16_t port;
+    const CompressionOptions *compression;
+    Mode mode;
+    ServerStats stats;
+    std::atomic<TcpServer *> server{nullptr};
+    std::thread thread;
+  };
+  Server servers[] = {{kPlainPort, nullptr, Mode::kEcho},
+                      {kDeflatePort, &options, Mode::kEcho},
+                      {kCoroutinePort, &options, Mode::kCoroutine},
+                      {kBannerPort, &options, Mode::kBanner}};
+  for (Server &s : servers) {
+    s.thread = std::thread(runServer, s.port, s.compression, s.mode,
+                           std::ref(s.stats), std::ref(s.server));
+  }
+  for (Server &s : servers) {
+    while (s.server.load() == nullptr) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  printf("deflate level %d, min size %zu, window bits %d\n", options.level,
+         options.minSize, options.windowBits);
+  Server &plain = servers[0];
+  Server &deflate = servers[1];
+  Server &coroutine = servers[2];
+  bool ok = run("plain", plain.port, false, options, plain.stats, messages,
+                messageBytes);
+  ok = run("deflate", deflate.port, true, options, deflate.stats, messages,
+           messageBytes) &&
+       ok;
+  ok = run("fallback", deflate.port, false, options, deflate.stats, messages,
+           messageBytes) &&
+       ok;
+  ok = run("coroutine", coroutine.port, true, options, coroutine.stats,
+           messages, messageBytes) &&
+       ok;
+  ok = banner(kBannerPort, options) && ok;
+  ok = bomb(deflate.port) && ok;
+
+  for (Server &s : servers) {
+    s.server.load()->stop();
+    s.thread.join();
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+// 写合并效果：服务端每个请求分 4 次 send 回一个 64 字节的响应，
+// 客户端 ping-pong，对比普通模式和写合并（setCorked）模式下
+// 每个请求的平均往返延迟和发出的 TCP 报文段数。
+//
+// 报文段数取自 /proc/net/snmp 的 Tcp OutSegs，是全系统的计数，
+// 包括客户端的请求和 ACK，两种模式之差就是服务端响应少发的段数。
+//
+// 用法: bench_cork [iterations]
+
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+static constexpr uint16_t kPlainPort = 19540;
+static constexpr uint16_t kCorkedPort = 19541;
+static constexpr size_t kRequestSize = 16;
+static constexpr size_t kPieceSize = 16;
+static constexpr int kPieces = 4;
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t tcpOutSegs() {
+  std::ifstream in("/proc/net/snmp");
+  std::string header, values;
+  while (std::getline(in, header) && std::getline(in, values)) {
+    if (header.rfind("Tcp:", 0) != 0) {
+      continue;
+    }
+    std::istringstream names(header), nums(values);
+    std::string name, value;
+    while (names >> name && nums >> value) {
+      if (name == "OutSegs") {
+        return std::stoull(value);
+      }
+    }
+  }
+  return 0;
+}
+
+static void runServer(uint16_t port, bool corked,
+                      std::atomic<TcpServer *> &out) {
+  TcpServer server("127.0.0.1", port);
+  server.setThreadNum(1);
+  server.setConnectionCallback([corked](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      conn->setCorked(corked);
+    }
+  });
+  server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer &buf) {
+    std::string piece(kPieceSize, 'r');
+    while (buf.readableBytes() >= kRequestSize) {
+      buf.retrieve(kRequestSize);
+      for (int i = 0; i < kPieces; ++i) {
+        conn->send(piece);
+      }
+    }
+  });
+  out = &server;
+  server.start();
+}
+
+static void runClient(const char *label, uint16_t port, int iterations) {
+  EventLoop loop;
+  TcpClient client(&loop, InetAddress("127.0.0.1", port), label);
+  std::string request(kRequestSize, 'q');
+  constexpr size_t kResponseSize = kPieceSize * kPieces;
+  int done = 0;
+  Clock::time_point start;
+  uint64_t segsStart = 0;
+
+  client.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      start = Clock::now();
+      segsStart = tcpOutSegs();
+      conn->send(request);
+    }
+  });
+  client.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer &buf) {
+    while (buf.readableBytes() >= kResponseSize) {
+      buf.retrieve(kResponseSize);
+      if (++done == iterations) {
+        loop.quit();
+        return;
+      }
+      conn->send(request);
+    }
+  });
+  client.connect();
+  loop.loop();
+  double secs = std::chrono::duration<double>(Clock::now() - start).count();
+  uint64_t segs = tcpOutSegs() - segsStart;
+  printf("%-7s %d requests: %.2f us avg, %.2f segments per request\n", label,
+         iterations, secs * 1e6 / iterations,
+         static_cast<double>(segs) / iterations);
+  client.disconnect();
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 50000;
+  setLogEnabled(false);
+
+  std::atomic<TcpServer *> plainServer{nullptr}, corkedServer{nullptr};
+  std::thread t1(runServer, kPlainPort, false, std::ref(plainServer));
+  std::thread t2(runServer, kCorkedPort, true, std::ref(corkedServer));
+  while (plainServer.load() == nullptr || corkedServer.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  runClient("plain", kPlainPort, iterations);
+  runClient("corked", kCorkedPort, iterations);
+
+  plainServer.load()->stop();
+  corkedServer.load()->stop();
+  t1.join();
+  t2.join();
+  return 0;
+}
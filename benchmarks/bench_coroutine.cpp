@@ -0,0 +1,201 @@
+// 协程与回调的开销对比：同一个 64 字节定长消息的 ping-pong，
+// 服务端分别用 MessageCallback 和协程（co_await read / write）实现，
+// 统计每个往返的平均延迟和整个进程的堆分配次数。
+//
+// 客户端两种模式完全相同，所以每往返分配次数之差就是服务端写法带来的差别。
+// 协程帧从 loop 的 FrameAllocator 分配，只在连接建立时分配一次。
+//
+// 开始前先检查跨线程的协程帧：在没有 loop 的线程上启动、在 loop 上结束的
+// 协程，帧会进那个 loop 的池；之后在 loop 上启动的协程复用这些帧时，
+// 局部变量必须落在帧实际分配到的内存里。
+//
+// 用法: bench_coroutine [iterations]
+
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "EventLoopThread.h"
+#include "Task.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <new>
+#include <string>
+#include <thread>
+
+static std::atomic<uint64_t> gAllocations{0};
+
+void *operator new(size_t size) {
+  gAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+static constexpr uint16_t kCallbackPort = 19536;
+static constexpr uint16_t kCoroutinePort = 19537;
+static constexpr size_t kMessageSize = 64;
+
+using Clock = std::chrono::steady_clock;
+
+// 取当前协程帧的地址，不挂起
+struct FrameAddress {
+  void *frame = nullptr;
+  bool await_ready() const { return false; }
+  bool await_suspend(std::coroutine_handle<> handle) {
+    frame = handle.address();
+    return false;
+  }
+  void *await_resume() const { return frame; }
+};
+
+// 挂起并在 loop 线程上恢复
+struct ResumeOn {
+  EventLoop *loop;
+  bool await_ready() const { return false; }
+  void await_suspend(std::coroutine_handle<> handle) {
+    loop->queueInLoop([handle]() { handle.resume(); });
+  }
+  void await_resume() const {}
+};
+
+// pad 跨越挂起点，放在协程帧里；在 loop 上写满它并检查它没有超出帧的分配
+template <size_t N>
+static Task<> frameCheck(EventLoop *loop, std::atomic<int> &done,
+                         std::atomic<int> &failures) {
+  char pad[N];
+  auto *frame = static_cast<char *>(co_await FrameAddress{});
+  co_await ResumeOn{loop};
+  memset(pad, 0x5a, N);
+  if (pad < frame || pad + N > frame + malloc_usable_size(frame)) {
+    ++failures;
+  }
+  ++done;
+}
+
+// 各种帧大小分布在几个尺寸档里，同一档里有大有小
+template <size_t... Ns>
+static void startFrameChecks(EventLoop *loop, std::atomic<int> &done,
+                             std::atomic<int> &failures) {
+  (frameCheck<Ns>(loop, done, failures).detach(), ...);
+}
+
+static bool checkOffLoopFrames() {
+  EventLoopThread thread("frame-check");
+  EventLoop *loop = thread.startLoop();
+  std::atomic<int> done{0}, failures{0};
+  constexpr int kRounds = 100;
+  constexpr int kPerRound = 16;
+  auto start = [&]() {
+    startFrameChecks<8, 40, 72, 104, 136, 168, 200, 232, 264, 328, 392, 456,
+                     520, 776, 1032, 1544>(loop, done, failures);
+  };
+  for (int round = 1; round <= kRounds; ++round) {
+    // 这一轮的帧在本线程（没有 loop）分配，在 loop 上释放
+    start();
+    // 再在 loop 上启动同样的一批，复用刚还回池里的帧
+    loop->queueInLoop(start);
+    while (done.load() < round * kPerRound * 2) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  printf("off-loop frames: %d coroutines, %d overran their frame\n",
+         done.load(), failures.load());
+  return failures.load() == 0;
+}
+
+static Task<> serve(TcpConnectionPtr conn) {
+  while (true) {
+    std::string msg = co_await conn->read(kMessageSize);
+    if (msg.size() < kMessageSize || !co_await conn->write(msg)) {
+      break;
+    }
+  }
+}
+
+static void runServer(uint16_t port, bool coroutine,
+                      std::atomic<TcpServer *> &out) {
+  TcpServer server("127.0.0.1", port);
+  server.setThreadNum(1);
+  if (coroutine) {
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+      if (conn->connected()) {
+        serve(conn).detach();
+      }
+    });
+  } else {
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer &buf) {
+      while (buf.readableBytes() >= kMessageSize) {
+        conn->send(buf.retrieveAsString(kMessageSize));
+      }
+    });
+  }
+  out = &server;
+  server.start();
+}
+
+static void runClient(const char *label, uint16_t port, int iterations) {
+  EventLoop loop;
+  TcpClient client(&loop, InetAddress("127.0.0.1", port), label);
+  std::string message(kMessageSize, 'x');
+  int done = 0;
+  Clock::time_point start;
+  uint64_t allocStart = 0;
+
+  client.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      start = Clock::now();
+      allocStart = gAllocations.load();
+      conn->send(message);
+    }
+  });
+  client.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer &buf) {
+    while (buf.readableBytes() >= kMessageSize) {
+      buf.retrieve(kMessageSize);
+      if (++done == iterations) {
+        loop.quit();
+        return;
+      }
+      conn->send(message);
+    }
+  });
+  client.connect();
+  loop.loop();
+  double secs = std::chrono::duration<double>(Clock::now() - start).count();
+  uint64_t allocs = gAllocations.load() - allocStart;
+  printf("%-9s %d round trips: %.2f us avg, %.2f allocations per round trip\n",
+         label, iterations, secs * 1e6 / iterations,
+         static_cast<double>(allocs) / iterations);
+  client.disconnect();
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 50000;
+  setLogEnabled(false);
+  if (!checkOffLoopFrames()) {
+    return 1;
+  }
+
+  std::atomic<TcpServer *> callbackServer{nullptr}, coroutineServer{nullptr};
+  std::thread t1(runServer, kCallbackPort, false, std::ref(callbackServer));
+  std::thread t2(runServer, kCoroutinePort, true, std::ref(coroutineServer));
+  while (callbackServer.load() == nullptr ||
+         coroutineServer.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  runClient("callback", kCallbackPort, iterations);
+  runClient("coroutine", kCoroutinePort, iterations);
+
+  callbackServer.load()->stop();
+  coroutineServer.load()->stop();
+  t1.join();
+  t2.join();
+  return 0;
+}
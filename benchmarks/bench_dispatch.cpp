@@ -0,0 +1,147 @@
+// 比较默认 EventLoop（虚函数 Poller + std::function 回调）与
+// BasicEventLoop（模板静态分发）每秒能分发的事件数。
+// BasicEventLoop 只是测量用的实现，库本身不提供静态分发路径。
+//
+// 每对 socketpair 的两端都注册在同一个 loop 上，收到 1 字节就写回给对端，
+// 令牌在两端之间来回弹跳，直到总事件数达到目标。
+//
+// 用法: bench_dispatch [pairs] [events]
+
+#include "BasicEventLoop.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+static long gTarget = 0;
+static long gEvents = 0;
+
+static void makePairs(int pairs, std::vector<int> &fds) {
+  for (int i = 0; i < pairs; ++i) {
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) < 0) {
+      perror("socketpair");
+      exit(EXIT_FAILURE);
+    }
+    fds.push_back(sv[0]);
+    fds.push_back(sv[1]);
+  }
+}
+
+// 收到数据就回写 1 字节
+static inline void bounce(int fd) {
+  char c;
+  if (::read(fd, &c, 1) == 1) {
+    ssize_t n = ::write(fd, &c, 1);
+    (void)n;
+  }
+}
+
+static double runDynamic(int pairs) {
+  EventLoop loop;
+  std::vector<int> fds;
+  makePairs(pairs, fds);
+  std::vector<std::unique_ptr<Channel>> channels;
+  for (int fd : fds) {
+    auto ch = std::make_unique<Channel>(fd, loop.getPoller());
+    ch->setReadCallback([fd, &loop]() {
+      bounce(fd);
+      if (++gEvents >= gTarget) {
+        loop.quit();
+      }
+    });
+    ch->enableReading();
+    channels.push_back(std::move(ch));
+  }
+
+  gEvents = 0;
+  for (size_t i = 0; i < fds.size(); i += 2) {
+    ssize_t n = ::write(fds[i], "x", 1);
+    (void)n;
+  }
+  auto start = std::chrono::steady_clock::now();
+  loop.loop();
+  auto end = std::chrono::steady_clock::now();
+
+  for (auto &ch : channels) {
+    loop.getPoller()->removeChannel(ch.get());
+  }
+  for (int fd : fds) {
+    ::close(fd);
+  }
+  return gEvents / std::chrono::duration<double>(end - start).count();
+}
+
+// 具体的连接类型，BasicChannel 直接调用它的成员函数
+struct PingHandler {
+  int fd;
+  BasicEventLoop<PingHandler> *loop;
+
+  void handleRead() {
+    bounce(fd);
+    if (++gEvents >= gTarget) {
+      loop->quit();
+    }
+  }
+  void handleWrite() {}
+  void handleClose() {}
+};
+
+static double runStatic(int pairs) {
+  BasicEventLoop<PingHandler> loop;
+  std::vector<int> fds;
+  makePairs(pairs, fds);
+  std::vector<PingHandler> handlers(fds.size());
+  std::vector<std::unique_ptr<BasicChannel<PingHandler>>> channels;
+  for (size_t i = 0; i < fds.size(); ++i) {
+    handlers[i] = PingHandler{fds[i], &loop};
+    auto ch = std::make_unique<BasicChannel<PingHandler>>(fds[i], &handlers[i]);
+    ch->setEvents(EPOLLIN);
+    loop.getPoller()->updateChannel(ch.get());
+    channels.push_back(std::move(ch));
+  }
+
+  gEvents = 0;
+  for (size_t i = 0; i < fds.size(); i += 2) {
+    ssize_t n = ::write(fds[i], "x", 1);
+    (void)n;
+  }
+  auto start = std::chrono::steady_clock::now();
+  loop.loop();
+  auto end = std::chrono::steady_clock::now();
+
+  for (auto &ch : channels) {
+    loop.getPoller()->removeChannel(ch.get());
+  }
+  for (int fd : fds) {
+    ::close(fd);
+  }
+  return gEvents / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  int pairs = argc > 1 ? atoi(argv[1]) : 64;
+  gTarget = argc > 2 ? atol(argv[2]) : 2000000;
+
+  // 先各跑一次预热
+  long target = gTarget;
+  gTarget = target / 10;
+  runDynamic(pairs);
+  runStatic(pairs);
+  gTarget = target;
+
+  double dynamicRate = runDynamic(pairs);
+  double staticRate = runStatic(pairs);
+  printf("pairs=%d events=%ld\n", pairs, gTarget);
+  printf("dynamic (virtual Poller + std::function): %12.0f events/sec\n",
+         dynamicRate);
+  printf("static  (BasicEventLoop<Handler>):        %12.0f events/sec\n",
+         staticRate);
+  printf("speedup: %.3fx\n", staticRate / dynamicRate);
+  return 0;
+}
@@ -0,0 +1,101 @@
+// 短连接的 epoll_ctl 次数：客户端用阻塞 socket 依次建立 connections 个连接，
+// 每个连接发一条消息、收到回显后关闭。本程序自己定义 epoll_ctl，统计库里
+// 各种操作的调用次数后再转给内核，最后按连接数平均。
+//
+// 用法: bench_epoll_ctl [connections]
+
+#include "TcpServer.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+static constexpr uint16_t kPort = 19545;
+static constexpr size_t kMessageSize = 16;
+
+static std::atomic<uint64_t> gCtlCalls[4];
+
+// 覆盖 libc 的 epoll_ctl，静态库里的调用会解析到这里
+extern "C" int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) {
+  if (op >= 0 && op < 4) {
+    gCtlCalls[op].fetch_add(1, std::memory_order_relaxed);
+  }
+  return static_cast<int>(::syscall(SYS_epoll_ctl, epfd, op, fd, event));
+}
+
+static uint64_t ctlCalls(int op) { return gCtlCalls[op].load(); }
+
+static void runServer(std::atomic<TcpServer *> &out) {
+  TcpServer server("127.0.0.1", kPort);
+  server.setThreadNum(1);
+  server.setConnectionCallback([](const TcpConnectionPtr &) {});
+  server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer &buf) {
+    conn->send(buf.retrieveAllAsString());
+  });
+  out = &server;
+  server.start();
+}
+
+static bool roundTrip() {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    ::close(fd);
+    return false;
+  }
+  char buf[kMessageSize] = {'e'};
+  size_t received = 0;
+  bool ok = ::write(fd, buf, sizeof(buf)) == sizeof(buf);
+  while (ok && received < sizeof(buf)) {
+    ssize_t n = ::read(fd, buf, sizeof(buf) - received);
+    ok = n > 0;
+    received += ok ? n : 0;
+  }
+  ::close(fd);
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  int connections = argc > 1 ? atoi(argv[1]) : 2000;
+  setLogEnabled(false);
+
+  std::atomic<TcpServer *> server{nullptr};
+  std::thread t(runServer, std::ref(server));
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  // 等服务器启动时的注册做完再开始计数
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  uint64_t before[4];
+  for (int op = 1; op < 4; ++op) {
+    before[op] = ctlCalls(op);
+  }
+
+  int failed = 0;
+  for (int i = 0; i < connections; ++i) {
+    failed += roundTrip() ? 0 : 1;
+  }
+  // 最后一个连接的关闭在服务器线程里异步处理
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  uint64_t add = ctlCalls(EPOLL_CTL_ADD) - before[EPOLL_CTL_ADD];
+  uint64_t mod = ctlCalls(EPOLL_CTL_MOD) - before[EPOLL_CTL_MOD];
+  uint64_t del = ctlCalls(EPOLL_CTL_DEL) - before[EPOLL_CTL_DEL];
+  double n = connections;
+  printf("%d connections (%d failed)\n", connections, failed);
+  printf("epoll_ctl per connection: ADD %.2f  MOD %.2f  DEL %.2f  total %.2f\n",
+         add / n, mod / n, del / n, (add + mod + del) / n);
+
+  server.load()->stop();
+  t.join();
+  return 0;
+}
@@ -0,0 +1,161 @@
+// 测量空闲连接的常驻内存：在本机回环上建立 N 条不收发数据的连接，
+// 比较建立前后进程 RSS 的差值，得到每条空闲连接占用的用户态内存。
+// 客户端和服务端在同一进程里，客户端只多占一个 int（fd）。
+//
+// 用法: bench_idle_memory [N ...] > /dev/null   （结果输出到 stderr）
+// 默认 N = 100000 1000000。每条连接需要两个 fd，N 会被 RLIMIT_NOFILE 限制；
+// 超过 28000 条左右时依次使用 127.0.0.x 作为源地址以避开临时端口上限。
+
+#include "TcpServer.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static constexpr uint16_t kPort = 19527;
+static constexpr int kConnsPerSourceIp = 25000;
+static std::atomic<long> gConnected{0};
+
+static long residentBytes() {
+  long pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f != nullptr) {
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+      resident = 0;
+    }
+    fclose(f);
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+static long raiseFdLimit() {
+  struct rlimit rl;
+  getrlimit(RLIMIT_NOFILE, &rl);
+  rl.rlim_cur = rl.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &rl);
+  getrlimit(RLIMIT_NOFILE, &rl);
+  return static_cast<long>(rl.rlim_cur);
+}
+
+static int connectFrom(int index) {
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in src;
+  bzero(&src, sizeof src);
+  src.sin_family = AF_INET;
+  src.sin_addr.s_addr = htonl(INADDR_LOOPBACK + index / kConnsPerSourceIp);
+  ::bind(fd, (struct sockaddr *)&src, sizeof src);
+
+  struct sockaddr_in dst;
+  bzero(&dst, sizeof dst);
+  dst.sin_family = AF_INET;
+  dst.sin_port = htons(kPort);
+  dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, (struct sockaddr *)&dst, sizeof dst) < 0 &&
+      errno != EINPROGRESS) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static bool waitForCount(long expected, int timeoutSec) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(timeoutSec);
+  while (gConnected.load() != expected) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<long> counts;
+  for (int i = 1; i < argc; ++i) {
+    counts.push_back(atol(argv[i]));
+  }
+  if (counts.empty()) {
+    counts = {100000, 1000000};
+  }
+  long maxConns = (raiseFdLimit() - 64) / 2;
+
+  // 主 EventLoop 属于构造 TcpServer 的线程，所以在服务线程里构造
+  std::atomic<TcpServer *> server{nullptr};
+  std::thread serverThread([&server]() {
+    TcpServer tcpServer("127.0.0.1", kPort);
+    tcpServer.setThreadNum(4);
+    tcpServer.setConnectionCallback([](const TcpConnectionPtr &conn) {
+      gConnected += conn->connected() ? 1 : -1;
+    });
+    tcpServer.setMessageCallback(
+        [](const TcpConnectionPtr &, Buffer &buf) { buf.retrieveAll(); });
+    server = &tcpServer;
+    tcpServer.start();
+  });
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  for (long requested : counts) {
+    long n = std::min(requested, maxConns);
+    if (n < requested) {
+      fprintf(stderr, "note: %ld connections requested, fd limit allows %ld\n",
+              requested, n);
+    }
+    std::vector<int> fds;
+    fds.reserve(n);
+    long before = residentBytes();
+
+    // 分批建立，等服务端 accept 跟上，避免 listen 队列溢出导致 SYN 重传
+    for (long i = 0; i < n; ++i) {
+      int fd = connectFrom(static_cast<int>(i));
+      if (fd < 0) {
+        fprintf(stderr, "connect #%ld failed: %s\n", i, strerror(errno));
+        break;
+      }
+      fds.push_back(fd);
+      if (fds.size() % 1000 == 0) {
+        waitForCount(static_cast<long>(fds.size()), 30);
+      }
+    }
+    long established = static_cast<long>(fds.size());
+    if (!waitForCount(established, 60)) {
+      fprintf(stderr, "only %ld of %ld connections established\n",
+              gConnected.load(), established);
+    }
+    // 给 I/O 线程一点时间处理完 connectEstablished
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    long after = residentBytes();
+
+    fprintf(stderr,
+            "connections=%ld rss_before=%ld rss_after=%ld "
+            "bytes_per_idle_connection=%.1f\n",
+            established, before, after,
+            established > 0
+                ? static_cast<double>(after - before) / established
+                : 0.0);
+
+    for (int fd : fds) {
+      ::close(fd);
+    }
+    waitForCount(0, 60);
+  }
+
+  server.load()->stop();
+  serverThread.join();
+  return 0;
+}
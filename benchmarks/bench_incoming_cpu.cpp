@@ -0,0 +1,160 @@
+// 按 SO_INCOMING_CPU 分配连接的回环验证。I/O 线程轮流绑到进程允许的 CPU 上，
+// 客户端在每个允许的 CPU 上各起一个绑核的线程，逐个建立短连接并发送自己
+// 所在的 CPU 号。回环上收包的软中断就在发送方的 CPU 上处理，所以服务端
+// socket 的 SO_INCOMING_CPU 应该等于客户端线程的 CPU。
+//
+// 服务端收到请求时记录：连接的 SO_INCOMING_CPU、连接所在 loop 绑定的 CPU。
+// 对比三种分配方式里“loop 就在收包 CPU 上”的比例：
+//   round-robin   默认轮询
+//   steer         主 loop accept 后按 SO_INCOMING_CPU 选 loop
+//   per-loop      每个 loop 自己的 SO_REUSEPORT 监听 socket 加 SO_INCOMING_CPU
+// 只有一个 CPU 时第二个 loop 登记一个不存在的 CPU 号（绑核会失败并报错），
+// 这样轮询约有一半连接落在它上面，按 CPU 分配应该全部落在 CPU 0 的 loop 上。
+//
+// 用法: bench_incoming_cpu [connections_per_cpu]
+
+#include "TcpServer.h"
+#include "ThreadAffinity.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static constexpr uint16_t kRoundRobinPort = 19555;
+static constexpr uint16_t kSteerPort = 19556;
+static constexpr uint16_t kPerLoopPort = 19557;
+
+struct Sample {
+  int clientCpu;
+  int incomingCpu;
+  int loopCpu;
+};
+
+static void runServer(uint16_t port, const ServerOptions &options,
+                      const std::vector<int> &ioCpus, std::mutex &mutex,
+                      std::vector<Sample> &samples,
+                      std::atomic<TcpServer *> &out) {
+  TcpServer server(InetAddress("127.0.0.1", port), options);
+  ThreadAffinity affinity;
+  affinity.ioCpus = ioCpus;
+  server.setThreadAffinity(affinity);
+  server.setConnectionCallback([](const TcpConnectionPtr &) {});
+  server.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer &buf) {
+    // 请求是 4 字节的客户端 CPU 号
+    while (buf.readableBytes() >= sizeof(int32_t)) {
+      int32_t cpu = 0;
+      memcpy(&cpu, buf.peek(), sizeof(cpu));
+      buf.retrieve(sizeof(cpu));
+      Sample sample{cpu, Socket::getIncomingCpu(conn->fd()),
+                    conn->getLoop()->cpu()};
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        samples.push_back(sample);
+      }
+      conn->send("k");
+    }
+  });
+  out = &server;
+  server.start();
+}
+
+// 在 cpu 上绑核的线程里逐个建立短连接
+static void client(uint16_t port, int cpu, int connections) {
+  pinCurrentThread(cpu);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  for (int i = 0; i < connections; ++i) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int32_t request = cpu;
+    char reply;
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) !=
+            0 ||
+        ::write(fd, &request, sizeof(request)) != sizeof(request) ||
+        ::read(fd, &reply, 1) != 1) {
+      fprintf(stderr, "request from cpu %d failed\n", cpu);
+    }
+    ::close(fd);
+  }
+}
+
+static void run(const char *label, uint16_t port, const ServerOptions &options,
+                const std::vector<int> &cpus, const std::vector<int> &ioCpus,
+                int connectionsPerCpu) {
+  std::mutex mutex;
+  std::vector<Sample> samples;
+  std::atomic<TcpServer *> server{nullptr};
+  std::thread t(runServer, port, std::cref(options), std::cref(ioCpus),
+                std::ref(mutex), std::ref(samples), std::ref(server));
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::vector<std::thread> clients;
+  for (int cpu : cpus) {
+    clients.emplace_back(client, port, cpu, connectionsPerCpu);
+  }
+  for (std::thread &c : clients) {
+    c.join();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  server.load()->stop();
+  t.join();
+
+  size_t onIncoming = 0;
+  size_t incomingIsClient = 0;
+  std::map<int, size_t> perLoopCpu;
+  for (const Sample &s : samples) {
+    onIncoming += s.loopCpu == s.incomingCpu ? 1 : 0;
+    incomingIsClient += s.incomingCpu == s.clientCpu ? 1 : 0;
+    ++perLoopCpu[s.loopCpu];
+  }
+  double n = samples.empty() ? 1 : static_cast<double>(samples.size());
+  printf("%-12s %zu connections: loop on incoming cpu %5.1f%%, "
+         "incoming cpu == client cpu %5.1f%%, connections per loop cpu:",
+         label, samples.size(), onIncoming * 100 / n,
+         incomingIsClient * 100 / n);
+  for (const auto &[cpu, count] : perLoopCpu) {
+    printf(" %d:%zu", cpu, count);
+  }
+  printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+  int connectionsPerCpu = argc > 1 ? atoi(argv[1]) : 200;
+  setLogEnabled(false);
+  std::vector<int> cpus = allowedCpus();
+  std::vector<int> ioCpus = cpus;
+  if (ioCpus.size() == 1) {
+    ioCpus.push_back(ioCpus[0] + 1);
+    printf("1 allowed cpu: the second I/O loop claims cpu %d without being "
+           "pinned\n",
+           ioCpus[1]);
+  } else {
+    printf("%zu allowed cpus, one pinned I/O loop per cpu\n", cpus.size());
+  }
+
+  ServerOptions roundRobin;
+  roundRobin.numThreads = static_cast<int>(ioCpus.size());
+  ServerOptions steer = roundRobin;
+  steer.steerByIncomingCpu = true;
+  ServerOptions perLoop = steer;
+  perLoop.listenerPerLoop = true;
+
+  run("round-robin", kRoundRobinPort, roundRobin, cpus, ioCpus,
+      connectionsPerCpu);
+  run("steer", kSteerPort, steer, cpus, ioCpus, connectionsPerCpu);
+  run("per-loop", kPerLoopPort, perLoop, cpus, ioCpus, connectionsPerCpu);
+  return 0;
+}
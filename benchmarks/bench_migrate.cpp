@@ -0,0 +1,400 @@
+// 连接在 loop 之间迁移。
+//
+// 第一部分检查正确性：4 个 I/O 线程的服务器，echo 连接把收到的数据原样发回，
+// push 连接由一个外部线程跨线程 send 一串数据；同时另一个线程不停地把随机
+// 连接迁到随机的 loop 上。客户端逐字节核对两种字节流，报告错位字节数。
+// 第二遍给服务端连接加上很小的读预算并打开写合并，迁移时连接几乎总有排在
+// 就绪队列和 beforePoll 队列里的任务，检查这时迁移能完成且数据不乱。
+//
+// 第二部分看自动负载均衡：2 个 I/O 线程，每条消息在服务端忙等一段时间模拟
+// 计算。连接按顺序建立、轮流落在两个 loop 上，其中热连接（不停 ping-pong）
+// 都在同一个 loop 上，冷连接偶尔发一条。每隔一段时间打印两个 loop 线程的
+// CPU 占用、热连接的分布和迁移次数。单核机器上总吞吐不会因为均衡而提高，
+// 看的是负载是否被摊开。
+//
+// 用法: bench_migrate [bytes_per_connection] [balance_seconds]
+
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+static constexpr uint16_t kIntegrityPort = 19553;
+static constexpr uint16_t kBalancePort = 19554;
+static constexpr int kEchoConnections = 8;
+static constexpr int kPushConnections = 4;
+// echo 连接最多这么多字节在途
+static constexpr size_t kEchoWindow = 64 * 1024;
+static constexpr size_t kPushChunk = 4096;
+static constexpr int kHotConnections = 4;
+static constexpr int kColdConnections = 4;
+static constexpr size_t kBalanceMessage = 1024;
+static constexpr auto kWorkPerMessage = std::chrono::microseconds(20);
+
+using Clock = std::chrono::steady_clock;
+
+// 两种字节流的内容都由偏移量决定，不含 'P'（push 连接的开场字节）
+static char patternAt(uint64_t offset) { return 'a' + offset % 26; }
+
+static std::string pattern(uint64_t offset, size_t len) {
+  std::string s(len, '\0');
+  for (size_t i = 0; i < len; ++i) {
+    s[i] = patternAt(offset + i);
+  }
+  return s;
+}
+
+template <typename Setup>
+static void runServer(uint16_t port, int threads, Setup setup,
+                      std::atomic<TcpServer *> &out) {
+  ServerOptions options;
+  options.numThreads = threads;
+  TcpServer server(InetAddress("127.0.0.1", port), options);
+  setup(server);
+  out = &server;
+  server.start();
+}
+
+static TcpServer *waitForServer(std::atomic<TcpServer *> &server) {
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  // start() 里启动线程池之后才有 ioLoops
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  return server.load();
+}
+
+// 客户端一侧的一条被核对的字节流
+struct Stream {
+  std::unique_ptr<TcpClient> client;
+  bool push = false;
+  uint64_t sent = 0;
+  uint64_t received = 0;
+  bool done = false;
+};
+
+// busy 为 true 时服务端连接用很小的读预算并打开写合并
+static bool integrity(uint64_t bytesPerConnection, bool busy) {
+  std::mutex mutex;
+  std::vector<TcpConnectionPtr> all;
+  std::vector<TcpConnectionPtr> pushing;
+  std::atomic<TcpServer *> serverPtr{nullptr};
+  std::thread serverThread(
+      runServer<std::function<void(TcpServer &)>>, kIntegrityPort, 4,
+      [&](TcpServer &server) {
+        if (busy) {
+          server.setReadBudget(1024, 1);
+        }
+        server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+          if (conn->connected()) {
+            conn->setCorked(busy);
+            std::lock_guard<std::mutex> lock(mutex);
+            all.push_back(conn);
+          }
+        });
+        server.setMessageCallback(
+            [&](const TcpConnectionPtr &conn, Buffer &buf) {
+              if (*buf.peek() == 'P') {
+                buf.retrieve(1);
+                std::lock_guard<std::mutex> lock(mutex);
+                pushing.push_back(conn);
+                return;
+              }
+              conn->send(buf.retrieveAllAsString());
+            });
+      },
+      std::ref(serverPtr));
+  TcpServer *server = waitForServer(serverPtr);
+
+  std::atomic<bool> stop{false};
+  // 外部线程往 push 连接上发数据，每次 send 都跨线程投递
+  std::thread pusher([&]() {
+    std::unordered_map<TcpConnection *, uint64_t> offsets;
+    while (!stop) {
+      std::vector<TcpConnectionPtr> conns;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        conns = pushing;
+      }
+      for (const TcpConnectionPtr &conn : conns) {
+        uint64_t &offset = offsets[conn.get()];
+        if (offset < bytesPerConnection) {
+          size_t len = std::min<uint64_t>(kPushChunk,
+                                          bytesPerConnection - offset);
+          conn->send(pattern(offset, len));
+          offset += len;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  });
+  std::atomic<uint64_t> requested{0};
+  std::thread migrator([&]() {
+    std::mt19937 rng(42);
+    std::vector<EventLoop *> loops = server->ioLoops();
+    while (!stop) {
+      TcpConnectionPtr conn;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!all.empty()) {
+          conn = all[rng() % all.size()];
+        }
+      }
+      if (conn) {
+        server->migrateConnection(conn, loops[rng() % loops.size()]);
+        ++requested;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+  });
+
+  EventLoop loop;
+  std::vector<std::unique_ptr<Stream>> streams;
+  uint64_t mismatches = 0;
+  int remaining = kEchoConnections + kPushConnections;
+  std::mt19937 rng(7);
+  auto finish = [&](Stream &s, const TcpConnectionPtr &conn) {
+    s.done = true;
+    conn->shutdown();
+    if (--remaining == 0) {
+      loop.quit();
+    }
+  };
+  // echo 连接：在途数据不超过窗口，随机大小的块
+  auto fill = [&](Stream &s, const TcpConnectionPtr &conn) {
+    while (s.sent < bytesPerConnection && s.sent - s.received < kEchoWindow) {
+      size_t len = std::min<uint64_t>(1 + rng() % 8192,
+                                      bytesPerConnection - s.sent);
+      conn->send(pattern(s.sent, len));
+      s.sent += len;
+    }
+  };
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < kEchoConnections + kPushConnections; ++i) {
+    auto stream = std::make_unique<Stream>();
+    Stream &s = *stream;
+    s.push = i >= kEchoConnections;
+    s.client = std::make_unique<TcpClient>(
+        &loop, InetAddress("127.0.0.1", kIntegrityPort), "migrate");
+    s.client->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+      if (!conn->connected()) {
+        return;
+      }
+      if (s.push) {
+        conn->send("P");
+      } else {
+        fill(s, conn);
+      }
+    });
+    s.client->setMessageCallback(
+        [&](const TcpConnectionPtr &conn, Buffer &buf) {
+          size_t n = buf.readableBytes();
+          const char *data = buf.peek();
+          for (size_t k = 0; k < n; ++k) {
+            if (data[k] != patternAt(s.received + k)) {
+              ++mismatches;
+            }
+          }
+          buf.retrieveAll();
+          s.received += n;
+          if (!s.done && s.received >= bytesPerConnection) {
+            finish(s, conn);
+          } else if (!s.push) {
+            fill(s, conn);
+          }
+        });
+    s.client->connect();
+    streams.push_back(std::move(stream));
+  }
+  bool timedOut = false;
+  loop.runAfter(std::chrono::seconds(60), [&]() {
+    timedOut = true;
+    loop.quit();
+  });
+  loop.loop();
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  stop = true;
+  pusher.join();
+  migrator.join();
+  // 停止迁移之后每个迁移都应该很快结束，卡住的迁移会让跨线程任务一直积压
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  int stuck = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const TcpConnectionPtr &conn : all) {
+      stuck += conn->migrating() ? 1 : 0;
+    }
+  }
+  uint64_t migrations = server->migrations();
+  server->stop();
+  serverThread.join();
+
+  uint64_t verified = 0;
+  for (const auto &s : streams) {
+    verified += s->received;
+  }
+  printf("integrity%s: %d echo + %d push connections, %.1f MB verified in "
+         "%.2f s, %llu migrations (%llu requested), %d stuck, %llu mismatched "
+         "bytes%s\n",
+         busy ? " (read budget + cork)" : "", kEchoConnections,
+         kPushConnections, verified / 1048576.0, seconds,
+         static_cast<unsigned long long>(migrations),
+         static_cast<unsigned long long>(requested.load()), stuck,
+         static_cast<unsigned long long>(mismatches),
+         timedOut ? ", TIMED OUT" : "");
+  return mismatches == 0 && stuck == 0 && !timedOut;
+}
+
+static void balance(int seconds) {
+  std::mutex mutex;
+  std::vector<TcpConnectionPtr> hot;
+  std::atomic<uint64_t> messages{0};
+  std::atomic<TcpServer *> serverPtr{nullptr};
+  std::thread serverThread(
+      runServer<std::function<void(TcpServer &)>>, kBalancePort, 2,
+      [&](TcpServer &server) {
+        RebalanceOptions options;
+        options.period = std::chrono::milliseconds(200);
+        options.minImbalance = 0.2;
+        server.enableRebalancer(options);
+        server.setConnectionCallback([](const TcpConnectionPtr &) {});
+        server.setMessageCallback(
+            [&](const TcpConnectionPtr &conn, Buffer &buf) {
+              while (buf.readableBytes() >= kBalanceMessage) {
+                // 热连接的消息以 'H' 开头，第一次见到时记下来
+                if (*buf.peek() == 'H') {
+                  std::lock_guard<std::mutex> lock(mutex);
+                  hot.push_back(conn);
+                }
+                Clock::time_point until = Clock::now() + kWorkPerMessage;
+                while (Clock::now() < until) {
+                }
+                conn->send(buf.retrieveAsString(kBalanceMessage));
+                ++messages;
+              }
+            });
+      },
+      std::ref(serverPtr));
+  TcpServer *server = waitForServer(serverPtr);
+  std::vector<EventLoop *> loops = server->ioLoops();
+
+  // 客户端在自己的线程里按顺序建立连接，保证轮流落在两个 loop 上
+  EventLoop *clientLoop = nullptr;
+  std::atomic<bool> ready{false};
+  std::thread clientThread([&]() {
+    EventLoop loop;
+    clientLoop = &loop;
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    std::function<void(int)> connectNext = [&](int i) {
+      if (i == kHotConnections + kColdConnections) {
+        ready = true;
+        return;
+      }
+      // 偶数号是热连接
+      bool isHot = i % 2 == 0;
+      auto client = std::make_unique<TcpClient>(
+          &loop, InetAddress("127.0.0.1", kBalancePort), "balance");
+      std::string first(kBalanceMessage, isHot ? 'H' : 'c');
+      std::string next(kBalanceMessage, isHot ? 'h' : 'c');
+      client->setConnectionCallback(
+          [&, i, first](const TcpConnectionPtr &conn) {
+            if (conn->connected()) {
+              conn->send(first);
+              connectNext(i + 1);
+            }
+          });
+      client->setMessageCallback(
+          [&loop, isHot, next](const TcpConnectionPtr &conn, Buffer &buf) {
+            while (buf.readableBytes() >= kBalanceMessage) {
+              buf.retrieve(kBalanceMessage);
+              if (isHot) {
+                conn->send(next);
+              } else {
+                std::weak_ptr<TcpConnection> weak = conn;
+                loop.runAfter(std::chrono::milliseconds(50), [weak, next]() {
+                  if (TcpConnectionPtr c = weak.lock()) {
+                    c->send(next);
+                  }
+                });
+              }
+            }
+          });
+      client->connect();
+      clients.push_back(std::move(client));
+    };
+    connectNext(0);
+    loop.loop();
+  });
+  while (!ready) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  printf("balance: %d hot + %d cold connections on %zu loops, %lld us of "
+         "work per message\n",
+         kHotConnections, kColdConnections, loops.size(),
+         static_cast<long long>(kWorkPerMessage.count()));
+  std::vector<uint64_t> lastCpu;
+  for (EventLoop *loop : loops) {
+    lastCpu.push_back(loop->cpuTimeNanos());
+  }
+  uint64_t lastMessages = messages;
+  Clock::time_point last = Clock::now();
+  const auto interval = std::chrono::milliseconds(500);
+  for (int tick = 1; tick <= seconds * 2; ++tick) {
+    std::this_thread::sleep_for(interval);
+    Clock::time_point now = Clock::now();
+    double elapsed =
+        std::chrono::duration<double, std::nano>(now - last).count();
+    last = now;
+    printf("  t=%4.1fs cpu", tick * 0.5);
+    for (size_t i = 0; i < loops.size(); ++i) {
+      uint64_t cpu = loops[i]->cpuTimeNanos();
+      printf(" %5.1f%%", (cpu - lastCpu[i]) / elapsed * 100);
+      lastCpu[i] = cpu;
+    }
+    std::vector<int> hotPerLoop(loops.size(), 0);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (const TcpConnectionPtr &conn : hot) {
+        for (size_t i = 0; i < loops.size(); ++i) {
+          hotPerLoop[i] += conn->getLoop() == loops[i] ? 1 : 0;
+        }
+      }
+    }
+    printf("  hot connections");
+    for (int n : hotPerLoop) {
+      printf(" %d", n);
+    }
+    uint64_t m = messages;
+    printf("  %.0f msg/s  %llu migrations\n",
+           (m - lastMessages) * 1e9 / elapsed,
+           static_cast<unsigned long long>(server->migrations()));
+    lastMessages = m;
+  }
+
+  clientLoop->quit();
+  clientThread.join();
+  server->stop();
+  serverThread.join();
+}
+
+int main(int argc, char *argv[]) {
+  uint64_t bytes = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4 << 20;
+  int seconds = argc > 2 ? atoi(argv[2]) : 4;
+  setLogEnabled(false);
+  bool ok = integrity(bytes, false);
+  ok = integrity(bytes, true) && ok;
+  balance(seconds);
+  return ok ? 0 : 1;
+}
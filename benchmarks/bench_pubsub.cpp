@@ -0,0 +1,192 @@
+// 发布/订阅的扇出延迟：同进程起一个 PubSubBroker，subscribers 个连接订阅
+// 同一个主题，一个发布者每隔 interval 微秒发一条带发送时间戳的消息，
+// 统计从发布到每个订阅者收到的延迟分布。
+//
+// 开始计时前先反复发探测消息，直到每个订阅者都收到过，确认订阅已生效。
+//
+// 用法: bench_pubsub [subscribers] [messages] [interval_us] [payload_size]
+
+#include "PubSubBroker.h"
+#include "TcpClient.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr uint16_t kPort = 19543;
+static const std::string kTopic = "bench";
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<int> gReady{0};
+static std::atomic<uint64_t> gReceived{0};
+// 只在订阅者线程里写，线程结束后由 main 读
+static std::vector<int64_t> gLatencies;
+
+static int64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+// 负载开头 8 字节是发送时间，0 表示探测消息
+static std::string makePayload(int64_t sentNs, size_t size) {
+  std::string payload(std::max(size, sizeof(sentNs)), 'p');
+  memcpy(payload.data(), &sentNs, sizeof(sentNs));
+  return payload;
+}
+
+static void runSubscribers(int subscribers, std::atomic<EventLoop *> &out) {
+  EventLoop loop;
+  std::vector<std::unique_ptr<TcpClient>> clients;
+  std::vector<char> ready(subscribers, 0);
+  for (int i = 0; i < subscribers; ++i) {
+    auto client = std::make_unique<TcpClient>(
+        &loop, InetAddress("127.0.0.1", kPort), "subscriber");
+    client->setConnectionCallback([](const TcpConnectionPtr &conn) {
+      if (conn->connected()) {
+        conn->send(encodePubSubFrame(kSubscribe, kTopic, ""));
+      }
+    });
+    client->setMessageCallback(
+        [i, &ready](const TcpConnectionPtr &, Buffer &buf) {
+          PubSubFrame frame;
+          while (decodePubSubFrame(buf, frame, 1 << 20) > 0) {
+            int64_t sentNs = 0;
+            memcpy(&sentNs, frame.payload.data(), sizeof(sentNs));
+            if (sentNs == 0) {
+              if (!ready[i]) {
+                ready[i] = 1;
+                gReady.fetch_add(1);
+              }
+              continue;
+            }
+            gLatencies.push_back(nowNs() - sentNs);
+            gReceived.fetch_add(1, std::memory_order_relaxed);
+          }
+        });
+    client->connect();
+    clients.push_back(std::move(client));
+  }
+  out = &loop;
+  loop.loop();
+  for (auto &client : clients) {
+    client->disconnect();
+  }
+}
+
+// 发布者：先发探测直到全部订阅者就绪，再按间隔发 messages 条计时消息
+struct Publisher {
+  EventLoop *loop;
+  TcpConnectionPtr conn;
+  int subscribers;
+  int messages;
+  std::chrono::microseconds interval;
+  size_t payloadSize;
+  int sent = 0;
+
+  void probe() {
+    if (gReady.load() == subscribers) {
+      publishNext();
+      return;
+    }
+    conn->send(encodePubSubFrame(kPublish, kTopic, makePayload(0, 8)));
+    loop->runAfter(std::chrono::milliseconds(10), [this]() { probe(); });
+  }
+
+  void publishNext() {
+    conn->send(encodePubSubFrame(kPublish, kTopic,
+                                 makePayload(nowNs(), payloadSize)));
+    if (++sent < messages) {
+      loop->runAfter(interval, [this]() { publishNext(); });
+    } else {
+      loop->quit();
+    }
+  }
+};
+
+static void runPublisher(Publisher &publisher) {
+  EventLoop loop;
+  publisher.loop = &loop;
+  TcpClient client(&loop, InetAddress("127.0.0.1", kPort), "publisher");
+  client.setConnectionCallback([&publisher](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      publisher.conn = conn;
+      publisher.probe();
+    }
+  });
+  client.connect();
+  loop.loop();
+  publisher.conn.reset();
+  client.disconnect();
+}
+
+static double percentileUs(const std::vector<int64_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+  return static_cast<double>(sorted[index]) / 1e3;
+}
+
+int main(int argc, char *argv[]) {
+  int subscribers = argc > 1 ? atoi(argv[1]) : 1000;
+  int messages = argc > 2 ? atoi(argv[2]) : 200;
+  int intervalUs = argc > 3 ? atoi(argv[3]) : 20000;
+  size_t payloadSize = argc > 4 ? atoi(argv[4]) : 64;
+  setLogEnabled(false);
+
+  // TcpServer 要在构造它的线程里 start
+  std::atomic<PubSubBroker *> broker{nullptr};
+  std::thread brokerThread([&broker]() {
+    PubSubBroker server(InetAddress("127.0.0.1", kPort),
+                        PubSubBroker::Options());
+    server.setThreadNum(4);
+    broker = &server;
+    server.start();
+  });
+  while (broker.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  gLatencies.reserve(static_cast<size_t>(subscribers) * messages);
+  std::atomic<EventLoop *> subscriberLoop{nullptr};
+  std::thread subscriberThread(runSubscribers, subscribers,
+                               std::ref(subscriberLoop));
+  while (subscriberLoop.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  Publisher publisher{nullptr, nullptr, subscribers, messages,
+                      std::chrono::microseconds(intervalUs), payloadSize};
+  runPublisher(publisher);
+
+  // 等最后几条送达，最多 5 秒
+  uint64_t expected = static_cast<uint64_t>(subscribers) * messages;
+  Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+  while (gReceived.load() < expected && Clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  subscriberLoop.load()->quit();
+  subscriberThread.join();
+
+  std::sort(gLatencies.begin(), gLatencies.end());
+  printf("%d subscribers, %d messages of %zu bytes every %d us\n",
+         subscribers, messages, payloadSize, intervalUs);
+  printf("delivered %zu/%llu, broker dropped %llu\n", gLatencies.size(),
+         static_cast<unsigned long long>(expected),
+         static_cast<unsigned long long>(broker.load()->dropped()));
+  printf("latency us: p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+         percentileUs(gLatencies, 0.5), percentileUs(gLatencies, 0.99),
+         percentileUs(gLatencies, 0.999), percentileUs(gLatencies, 1.0));
+
+  broker.load()->stop();
+  brokerThread.join();
+  return 0;
+}
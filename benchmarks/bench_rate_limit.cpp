@@ -0,0 +1,122 @@
+// 限速效果：客户端尽可能快地灌数据，服务端限速读取，
+// 统计服务端实际收到的速率，和配置的速率比较。
+//   per-connection  每个连接各自 rate 字节/秒
+//   total           所有连接共享 rate 字节/秒
+//   messages        每个连接各自 rate / 64 条消息/秒，消息为 64 字节定长，
+//                   消息回调用 countMessages 报告解析出的条数
+//
+// 用法: bench_rate_limit [bytes_per_sec] [connections] [seconds]
+
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 两轮各用一个端口，避免上一轮客户端留下的 TIME_WAIT 影响 bind
+static constexpr uint16_t kPerConnectionPort = 19538;
+static constexpr uint16_t kTotalPort = 19539;
+static constexpr uint16_t kMessagesPort = 19562;
+static constexpr size_t kChunk = 64 * 1024;
+static constexpr size_t kMessageSize = 64;
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<uint64_t> gReceived{0};
+
+static void runServer(uint16_t port, const RateLimit &perConnection,
+                      const RateLimit &total, std::atomic<TcpServer *> &out) {
+  TcpServer server("127.0.0.1", port);
+  server.setThreadNum(2);
+  server.setRateLimit(perConnection, total);
+  server.setConnectionCallback([](const TcpConnectionPtr &) {});
+  bool messages = perConnection.messagesPerSec > 0;
+  server.setMessageCallback(
+      [messages](const TcpConnectionPtr &conn, Buffer &buf) {
+        if (!messages) {
+          gReceived.fetch_add(buf.readableBytes(), std::memory_order_relaxed);
+          buf.retrieveAll();
+          return;
+        }
+        size_t n = buf.readableBytes() / kMessageSize;
+        gReceived.fetch_add(n * kMessageSize, std::memory_order_relaxed);
+        buf.retrieve(n * kMessageSize);
+        conn->countMessages(n);
+      });
+  out = &server;
+  server.start();
+}
+
+// 每个连接保持输出缓冲区里有数据，发送速度只受服务端读速度限制
+static void runClients(uint16_t port, int connections, double seconds) {
+  EventLoop loop;
+  std::string chunk(kChunk, 'x');
+  std::vector<std::unique_ptr<TcpClient>> clients;
+  for (int i = 0; i < connections; ++i) {
+    auto client = std::make_unique<TcpClient>(
+        &loop, InetAddress("127.0.0.1", port), "flood");
+    client->setConnectionCallback([&chunk](const TcpConnectionPtr &conn) {
+      if (conn->connected()) {
+        conn->send(chunk);
+      }
+    });
+    client->setWriteCompleteCallback(
+        [&chunk](const TcpConnectionPtr &conn) { conn->send(chunk); });
+    client->connect();
+    clients.push_back(std::move(client));
+  }
+  loop.runAfter(std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(seconds)),
+                [&loop]() { loop.quit(); });
+  loop.loop();
+  for (auto &client : clients) {
+    client->disconnect();
+  }
+}
+
+static void run(const char *label, uint16_t port,
+                const RateLimit &perConnection, const RateLimit &total,
+                double expected, int connections, double seconds) {
+  gReceived = 0;
+  std::atomic<TcpServer *> server{nullptr};
+  std::thread t(runServer, port, std::cref(perConnection), std::cref(total),
+                std::ref(server));
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  Clock::time_point start = Clock::now();
+  runClients(port, connections, seconds);
+  double secs = std::chrono::duration<double>(Clock::now() - start).count();
+  double rate = static_cast<double>(gReceived.load()) / secs;
+  printf("%-15s %d conns: %.0f bytes/s received, limit %.0f (%.1f%%)\n", label,
+         connections, rate, expected, rate * 100 / expected);
+  server.load()->stop();
+  t.join();
+}
+
+int main(int argc, char *argv[]) {
+  double rate = argc > 1 ? atof(argv[1]) : 4 * 1024 * 1024;
+  int connections = argc > 2 ? atoi(argv[2]) : 4;
+  double seconds = argc > 3 ? atof(argv[3]) : 3;
+  setLogEnabled(false);
+
+  RateLimit limit;
+  limit.bytesPerSec = rate;
+  // 桶容量取 1/10 秒的量，突发对平均速率的影响小一些
+  limit.bytesBurst = rate / 10;
+  run("per-connection", kPerConnectionPort, limit, RateLimit{},
+      rate * connections, connections, seconds);
+  run("total", kTotalPort, RateLimit{}, limit, rate, connections, seconds);
+
+  RateLimit messages;
+  messages.messagesPerSec = rate / kMessageSize;
+  messages.messagesBurst = messages.messagesPerSec / 10;
+  run("messages", kMessagesPort, messages, RateLimit{}, rate * connections,
+      connections, seconds);
+  return 0;
+}
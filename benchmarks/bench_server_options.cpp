@@ -0,0 +1,142 @@
+// 短连接请求的监听 socket 调优：每个请求新建一个连接，发 16 字节请求，
+// 收到 64 字节响应后关闭。对比默认 ServerOptions 和打开 TCP_FASTOPEN +
+// TCP_DEFER_ACCEPT + TCP_QUICKACK 的服务器，客户端在后者上用
+// sendto(MSG_FASTOPEN) 把请求放进 SYN。
+//
+// 统计每个请求的平均耗时、全系统发出的 TCP 报文段数（/proc/net/snmp 的
+// OutSegs），以及服务端真正走了 TFO 的连接数（/proc/net/netstat 的
+// TCPFastOpenPassive）。服务端 TFO 需要 net.ipv4.tcp_fastopen 含 2 这一位。
+//
+// 用法: bench_server_options [requests]
+
+#include "TcpServer.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+static constexpr uint16_t kDefaultPort = 19547;
+static constexpr uint16_t kTunedPort = 19548;
+static constexpr size_t kRequestSize = 16;
+static constexpr size_t kResponseSize = 64;
+
+using Clock = std::chrono::steady_clock;
+
+// 取 /proc/net/snmp 或 /proc/net/netstat 里 prefix 那一组的 name 计数
+static uint64_t netCounter(const char *path, const std::string &prefix,
+                           const std::string &name) {
+  std::ifstream in(path);
+  std::string header, values;
+  while (std::getline(in, header) && std::getline(in, values)) {
+    if (header.rfind(prefix, 0) != 0) {
+      continue;
+    }
+    std::istringstream names(header), nums(values);
+    std::string key, value;
+    while (names >> key && nums >> value) {
+      if (key == name) {
+        return std::stoull(value);
+      }
+    }
+  }
+  return 0;
+}
+
+static void runServer(uint16_t port, const ServerOptions &options,
+                      std::atomic<TcpServer *> &out) {
+  TcpServer server(InetAddress("127.0.0.1", port), options);
+  server.setConnectionCallback([](const TcpConnectionPtr &) {});
+  server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer &buf) {
+    while (buf.readableBytes() >= kRequestSize) {
+      buf.retrieve(kRequestSize);
+      conn->send(std::string(kResponseSize, 'r'));
+    }
+  });
+  out = &server;
+  server.start();
+}
+
+static bool request(uint16_t port, bool fastOpen) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  auto *sa = reinterpret_cast<sockaddr *>(&addr);
+  char buf[kResponseSize] = {'q'};
+  bool ok;
+  if (fastOpen) {
+    // 还没有 cookie 时内核会退回普通握手，数据在握手完成后发出
+    ok = ::sendto(fd, buf, kRequestSize, MSG_FASTOPEN, sa, sizeof(addr)) ==
+         static_cast<ssize_t>(kRequestSize);
+  } else {
+    ok = ::connect(fd, sa, sizeof(addr)) == 0 &&
+         ::write(fd, buf, kRequestSize) == static_cast<ssize_t>(kRequestSize);
+  }
+  size_t received = 0;
+  while (ok && received < kResponseSize) {
+    ssize_t n = ::read(fd, buf, kResponseSize - received);
+    ok = n > 0;
+    received += ok ? n : 0;
+  }
+  ::close(fd);
+  return ok;
+}
+
+static void run(const char *label, uint16_t port, const ServerOptions &options,
+                bool fastOpen, int requests) {
+  std::atomic<TcpServer *> server{nullptr};
+  std::thread t(runServer, port, std::cref(options), std::ref(server));
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  // 先跑一个请求拿到 TFO cookie
+  request(port, fastOpen);
+
+  uint64_t segs = netCounter("/proc/net/snmp", "Tcp:", "OutSegs");
+  uint64_t tfo = netCounter("/proc/net/netstat", "TcpExt:",
+                            "TCPFastOpenPassive");
+  int failed = 0;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < requests; ++i) {
+    failed += request(port, fastOpen) ? 0 : 1;
+  }
+  double us =
+      std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+  // 等服务端处理完关闭，关闭的报文也算进去
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  segs = netCounter("/proc/net/snmp", "Tcp:", "OutSegs") - segs;
+  tfo = netCounter("/proc/net/netstat", "TcpExt:", "TCPFastOpenPassive") - tfo;
+
+  printf("%-8s %d requests (%d failed): %.1f us avg, %.2f segments per "
+         "request, %llu fast open\n",
+         label, requests, failed, us / requests,
+         static_cast<double>(segs) / requests,
+         static_cast<unsigned long long>(tfo));
+  server.load()->stop();
+  t.join();
+}
+
+int main(int argc, char *argv[]) {
+  int requests = argc > 1 ? atoi(argv[1]) : 5000;
+  setLogEnabled(false);
+
+  ServerOptions defaults;
+  defaults.numThreads = 1;
+  ServerOptions tuned = defaults;
+  tuned.fastOpenQueue = 256;
+  tuned.deferAcceptSeconds = 1;
+  tuned.quickAck = true;
+
+  run("default", kDefaultPort, defaults, false, requests);
+  run("tuned", kTunedPort, tuned, true, requests);
+  return 0;
+}
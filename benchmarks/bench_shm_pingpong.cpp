@@ -0,0 +1,91 @@
+// 共享内存传输的往返延迟：两个线程各跑一个 EventLoop，
+// 通过 ShmTransport 互相回显 8 字节消息。
+//
+// 用法: bench_shm_pingpong [iterations] [spin-iterations]
+// spin-iterations 为 0 时每条消息都靠 eventfd 唤醒；适当自旋后大部分消息
+// 在对端回到 epoll_wait 之前就能被读到，也就不需要通知。
+
+#include "ShmTransport.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+  int spin = argc > 2 ? atoi(argv[2]) : 2000;
+  setLogEnabled(false);
+
+  ShmEndpoint a, b;
+  if (!ShmTransport::createPair(64 * 1024, a, b)) {
+    return 1;
+  }
+
+  std::atomic<EventLoop *> pongLoop{nullptr};
+  uint64_t pongNotifications = 0;
+  std::thread pongThread([&]() {
+    EventLoop loop;
+    auto pong = std::make_shared<ShmTransport>(&loop, b);
+    pong->setSpinIterations(spin);
+    pong->setMessageCallback([](const ShmTransportPtr &t, Buffer &buf) {
+      t->send(buf.retrieveAllAsString());
+    });
+    pong->setCloseCallback([&loop](const ShmTransportPtr &) { loop.quit(); });
+    pong->start();
+    pongLoop = &loop;
+    loop.loop();
+    pongNotifications = pong->notifications();
+  });
+  while (pongLoop.load() == nullptr) {
+    std::this_thread::yield();
+  }
+
+  EventLoop loop;
+  auto ping = std::make_shared<ShmTransport>(&loop, a);
+  ping->setSpinIterations(spin);
+  std::vector<double> samples;
+  samples.reserve(iterations);
+  Clock::time_point sentAt;
+  const std::string message(8, 'p');
+
+  ping->setMessageCallback([&](const ShmTransportPtr &t, Buffer &buf) {
+    while (buf.readableBytes() >= message.size()) {
+      buf.retrieve(message.size());
+      samples.push_back(
+          std::chrono::duration<double, std::nano>(Clock::now() - sentAt)
+              .count());
+      if (static_cast<int>(samples.size()) >= iterations) {
+        t->close();
+        loop.quit();
+        return;
+      }
+      sentAt = Clock::now();
+      t->send(message);
+    }
+  });
+  ping->start();
+  loop.queueInLoop([&]() {
+    sentAt = Clock::now();
+    ping->send(message);
+  });
+  loop.loop();
+  pongThread.join();
+
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double v : samples) {
+    sum += v;
+  }
+  printf("shm rtt_ns: avg=%.0f p50=%.0f p99=%.0f (n=%zu, spin=%d)\n",
+         sum / samples.size(), samples[samples.size() / 2],
+         samples[samples.size() * 99 / 100], samples.size(), spin);
+  printf("eventfd notifications: ping=%lu pong=%lu\n",
+         static_cast<unsigned long>(ping->notifications()),
+         static_cast<unsigned long>(pongNotifications));
+  return 0;
+}
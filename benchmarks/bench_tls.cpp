@@ -0,0 +1,176 @@
+// TLS 握手速率和记录吞吐，与明文 TCP 对比。
+//
+// 服务端用现场生成的自签名证书（P-256），客户端不校验证书。
+// 握手：依次建立 handshakes 个 TLS 连接，从 connect 到连接回调算一次握手。
+// 吞吐：客户端每次写完一块（64KB）再写下一块，服务端收够 megabytes 后回一个字节。
+// 内核支持 kTLS（tls 模块、AES-GCM 套件）时服务端发送方向会交给内核，结果里会标出。
+//
+// 用法: bench_tls [handshakes] [megabytes]
+
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "TlsContext.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr uint16_t kTlsPort = 19533;
+static constexpr uint16_t kPlainPort = 19534;
+static constexpr size_t kChunk = 64 * 1024;
+
+using Clock = std::chrono::steady_clock;
+
+// 服务端统计收到的字节，收够 expected 后回一个字节
+struct Sink {
+  std::atomic<size_t> expected{0};
+  std::atomic<size_t> received{0};
+  std::atomic<bool> ktlsSend{false};
+};
+
+static void runServer(uint16_t port, const std::shared_ptr<TlsContext> &tls,
+                      Sink &sink, std::atomic<TcpServer *> &out) {
+  TcpServer server("127.0.0.1", port);
+  server.setThreadNum(1);
+  if (tls) {
+    server.setTlsContext(tls);
+  }
+  server.setConnectionCallback([&sink](const TcpConnectionPtr &conn) {
+    if (conn->connected() && conn->tlsSession() != nullptr) {
+      sink.ktlsSend = conn->tlsSession()->ktlsSend();
+    }
+  });
+  server.setMessageCallback([&sink](const TcpConnectionPtr &conn,
+                                    Buffer &buf) {
+    size_t n = buf.readableBytes();
+    buf.retrieveAll();
+    size_t total = sink.received.fetch_add(n) + n;
+    size_t expected = sink.expected.load();
+    if (expected > 0 && total >= expected && total - n < expected) {
+      conn->send("k");
+    }
+  });
+  out = &server;
+  server.start();
+}
+
+static void benchHandshakes(const char *label, uint16_t port,
+                            const std::shared_ptr<TlsContext> &tls,
+                            int count) {
+  EventLoop loop;
+  std::vector<std::unique_ptr<TcpClient>> clients;
+  clients.reserve(count);
+  int done = 0;
+  Clock::time_point start = Clock::now();
+  std::function<void()> next = [&]() {
+    auto client = std::make_unique<TcpClient>(
+        &loop, InetAddress("127.0.0.1", port), label);
+    if (tls) {
+      client->enableTls(tls);
+    }
+    client->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+      if (!conn->connected()) {
+        return;
+      }
+      conn->shutdown();
+      if (++done == count) {
+        loop.quit();
+      } else {
+        next();
+      }
+    });
+    client->setMessageCallback([](const TcpConnectionPtr &, Buffer &buf) {
+      buf.retrieveAll();
+    });
+    client->connect();
+    clients.push_back(std::move(client));
+  };
+  next();
+  loop.loop();
+  double secs = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("%-5s connect%s: %d in %.3fs, %.0f/s, %.1f us each\n", label,
+         tls ? "+handshake" : "          ", count, secs, count / secs,
+         secs * 1e6 / count);
+}
+
+static void benchThroughput(const char *label, uint16_t port,
+                            const std::shared_ptr<TlsContext> &tls,
+                            Sink &sink, size_t totalBytes) {
+  EventLoop loop;
+  TcpClient client(&loop, InetAddress("127.0.0.1", port), label);
+  if (tls) {
+    client.enableTls(tls);
+  }
+  std::string chunk(kChunk, 'x');
+  size_t sent = 0;
+  Clock::time_point start;
+  sink.received = 0;
+  sink.expected = totalBytes;
+
+  auto sendNext = [&](const TcpConnectionPtr &conn) {
+    if (sent < totalBytes) {
+      sent += chunk.size();
+      conn->send(chunk);
+    }
+  };
+  client.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      start = Clock::now();
+      sendNext(conn);
+    }
+  });
+  client.setWriteCompleteCallback(sendNext);
+  client.setMessageCallback([&](const TcpConnectionPtr &, Buffer &buf) {
+    buf.retrieveAll();
+    loop.quit();
+  });
+  client.connect();
+  loop.loop();
+  double secs = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("%-5s throughput: %zu MB in %.3fs, %.1f MB/s", label,
+         totalBytes >> 20, secs, (totalBytes >> 20) / secs);
+  if (tls) {
+    printf(" (server kTLS tx %s)", sink.ktlsSend ? "on" : "off");
+  }
+  printf("\n");
+  client.disconnect();
+}
+
+int main(int argc, char *argv[]) {
+  int handshakes = argc > 1 ? atoi(argv[1]) : 1000;
+  size_t megabytes = argc > 2 ? atol(argv[2]) : 256;
+  setLogEnabled(false);
+
+  auto serverTls = TlsContext::newSelfSignedServer();
+  // 服务端是现场生成的自签名证书，客户端明确不校验
+  auto clientTls = TlsContext::newClientInsecure();
+  if (!serverTls || !clientTls) {
+    return 1;
+  }
+
+  Sink tlsSink, plainSink;
+  std::atomic<TcpServer *> tlsServer{nullptr}, plainServer{nullptr};
+  std::thread tlsThread(runServer, kTlsPort, serverTls, std::ref(tlsSink),
+                        std::ref(tlsServer));
+  std::thread plainThread(runServer, kPlainPort, nullptr,
+                          std::ref(plainSink), std::ref(plainServer));
+  while (tlsServer.load() == nullptr || plainServer.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  benchHandshakes("plain", kPlainPort, nullptr, handshakes);
+  benchHandshakes("tls", kTlsPort, clientTls, handshakes);
+  benchThroughput("plain", kPlainPort, nullptr, plainSink, megabytes << 20);
+  benchThroughput("tls", kTlsPort, clientTls, tlsSink, megabytes << 20);
+
+  tlsServer.load()->stop();
+  plainServer.load()->stop();
+  tlsThread.join();
+  plainThread.join();
+  return 0;
+}
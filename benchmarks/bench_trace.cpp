@@ -0,0 +1,104 @@
+// 追踪开销：
+//   1. 空作用域上的 TRACE_SCOPE，分别在运行期关闭和打开时测每个事件的开销
+//   2. 打开追踪跑一段 echo ping-pong，和关闭时比较往返延迟，
+//      最后导出 Chrome trace JSON（默认 /tmp/bench_trace.json）
+//
+// 用法: bench_trace [events] [round_trips] [output]
+
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "Trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+static constexpr uint16_t kPort = 19544;
+static constexpr size_t kMessageSize = 64;
+
+using Clock = std::chrono::steady_clock;
+
+static double scopeCostNs(int events) {
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < events; ++i) {
+    TRACE_SCOPE("bench", i);
+    // 阻止编译器把空循环整个优化掉
+    asm volatile("" ::: "memory");
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+             .count() /
+         events;
+}
+
+static void runServer(std::atomic<TcpServer *> &out) {
+  TcpServer server("127.0.0.1", kPort);
+  server.setThreadNum(1);
+  server.setConnectionCallback([](const TcpConnectionPtr &) {});
+  server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer &buf) {
+    conn->send(buf.retrieveAllAsString());
+  });
+  out = &server;
+  server.start();
+}
+
+static double pingPongUs(int roundTrips) {
+  EventLoop loop;
+  TcpClient client(&loop, InetAddress("127.0.0.1", kPort), "tracer");
+  std::string message(kMessageSize, 't');
+  int done = 0;
+  Clock::time_point start;
+  client.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      start = Clock::now();
+      conn->send(message);
+    }
+  });
+  client.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer &buf) {
+    if (buf.readableBytes() < kMessageSize) {
+      return;
+    }
+    buf.retrieve(kMessageSize);
+    if (++done == roundTrips) {
+      loop.quit();
+      return;
+    }
+    conn->send(message);
+  });
+  client.connect();
+  loop.loop();
+  double us =
+      std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+  client.disconnect();
+  return us / roundTrips;
+}
+
+int main(int argc, char *argv[]) {
+  int events = argc > 1 ? atoi(argv[1]) : 10000000;
+  int roundTrips = argc > 2 ? atoi(argv[2]) : 20000;
+  std::string output = argc > 3 ? argv[3] : "/tmp/bench_trace.json";
+  setLogEnabled(false);
+
+  Tracer::setEnabled(false);
+  printf("TRACE_SCOPE disabled: %.1f ns/event\n", scopeCostNs(events));
+  Tracer::setEnabled(true);
+  printf("TRACE_SCOPE enabled:  %.1f ns/event\n", scopeCostNs(events));
+
+  std::atomic<TcpServer *> server{nullptr};
+  std::thread t(runServer, std::ref(server));
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  Tracer::setEnabled(false);
+  printf("echo, tracing off: %.2f us per round trip\n", pingPongUs(roundTrips));
+  Tracer::setEnabled(true);
+  printf("echo, tracing on:  %.2f us per round trip\n", pingPongUs(roundTrips));
+
+  if (Tracer::dump(output)) {
+    printf("trace written to %s\n", output.c_str());
+  }
+  server.load()->stop();
+  t.join();
+  return 0;
+}
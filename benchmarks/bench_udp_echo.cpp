@@ -0,0 +1,109 @@
+// UDP 回显吞吐：比较不同 recvmmsg/sendmmsg 批大小下的报文速率和系统调用次数。
+//
+// 服务端 UdpServer 在 127.0.0.1:kPort 上回显，客户端用 UdpSocket 保持 window 个
+// 报文在途，收到一个回复补发一个。批大小为 1 时相当于逐个 recvfrom/sendto。
+//
+// 用法: bench_udp_echo [datagrams] [batch-size] [window] [message-size]
+
+#include "UdpServer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+static constexpr uint16_t kPort = 19531;
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char *argv[]) {
+  long total = argc > 1 ? atol(argv[1]) : 200000;
+  int batch = argc > 2 ? atoi(argv[2]) : 32;
+  int window = argc > 3 ? atoi(argv[3]) : 64;
+  size_t msgSize = argc > 4 ? atol(argv[4]) : 64;
+  setLogEnabled(false);
+
+  UdpOptions options;
+  options.batchSize = batch;
+
+  std::atomic<UdpServer *> server{nullptr};
+  std::thread serverThread([&server, &options]() {
+    UdpServer udpServer(InetAddress("127.0.0.1", kPort), options);
+    udpServer.setMessageCallback([](UdpSocket &sock, const InetAddress &peer,
+                                    const char *data, size_t len) {
+      sock.send(peer, data, len);
+    });
+    // start() 里建好套接字之后才会执行这个任务
+    udpServer.getLoop()->queueInLoop([&]() { server = &udpServer; });
+    udpServer.start();
+  });
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  EventLoop loop;
+  UdpSocket client(&loop, InetAddress("127.0.0.1", 0), options);
+  const InetAddress serverAddr("127.0.0.1", kPort);
+  std::string message(msgSize, 'x');
+  std::atomic<long> received{0};
+  long sent = 0;
+
+  client.setMessageCallback(
+      [&](UdpSocket &sock, const InetAddress &, const char *, size_t) {
+        if (received.fetch_add(1, std::memory_order_relaxed) + 1 >= total) {
+          loop.quit();
+          return;
+        }
+        if (sent < total) {
+          ++sent;
+          sock.send(serverAddr, message);
+        }
+      });
+  client.start();
+  for (; sent < window && sent < total; ++sent) {
+    client.send(serverAddr, message);
+  }
+
+  // 回环上也可能因接收缓冲区满而丢包，长时间没有进展就结束并报告丢失数
+  std::atomic<bool> done{false};
+  std::thread watchdog([&]() {
+    long last = -1;
+    while (!done.load()) {
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+      long now = received.load(std::memory_order_relaxed);
+      if (now == last) {
+        loop.quit();
+        return;
+      }
+      last = now;
+    }
+  });
+
+  Clock::time_point start = Clock::now();
+  loop.loop();
+  double secs = std::chrono::duration<double>(Clock::now() - start).count();
+  done = true;
+  watchdog.join();
+
+  uint64_t recvCalls = 0, recvDatagrams = 0, sendCalls = 0, sendDatagrams = 0;
+  for (const auto &sock : server.load()->sockets()) {
+    recvCalls += sock->recvCalls();
+    recvDatagrams += sock->recvDatagrams();
+    sendCalls += sock->sendCalls();
+    sendDatagrams += sock->sendDatagrams();
+  }
+  server.load()->stop();
+  serverThread.join();
+
+  long got = received.load();
+  printf("batch=%d window=%d size=%zu: %ld echoes in %.3fs, %.0f pps, "
+         "lost=%ld\n",
+         batch, window, msgSize, got, secs, got / secs, total - got);
+  printf("server: %lu datagrams / %lu recvmmsg (%.1f per call), "
+         "%lu datagrams / %lu sendmmsg (%.1f per call)\n",
+         recvDatagrams, recvCalls,
+         recvCalls ? double(recvDatagrams) / recvCalls : 0.0, sendDatagrams,
+         sendCalls, sendCalls ? double(sendDatagrams) / sendCalls : 0.0);
+  return 0;
+}
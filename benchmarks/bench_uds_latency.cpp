@@ -0,0 +1,95 @@
+// 比较本机回环 TCP 与 Unix 域套接字的往返延迟。
+//
+// 同一个 TcpServer 同时监听 127.0.0.1:port 和抽象命名空间的 Unix 域地址，
+// 客户端用 TcpClient 分别连上去做 ping-pong，统计每次往返的 p50/p99/平均值。
+//
+// 用法: bench_uds_latency [iterations] [message-size]
+
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr uint16_t kPort = 19528;
+static const char *kUnixPath = "@reactor-bench-uds";
+
+using Clock = std::chrono::steady_clock;
+
+static void runClient(const char *label, const InetAddress &addr,
+                      int iterations, size_t msgSize) {
+  EventLoop loop;
+  TcpClient client(&loop, addr, label);
+  std::string message(msgSize, 'x');
+  std::vector<double> samples;
+  samples.reserve(iterations);
+  Clock::time_point sentAt;
+
+  client.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      sentAt = Clock::now();
+      conn->send(message);
+    }
+  });
+  client.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer &buf) {
+    if (buf.readableBytes() < msgSize) {
+      return;
+    }
+    buf.retrieve(msgSize);
+    samples.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - sentAt)
+            .count());
+    if (static_cast<int>(samples.size()) >= iterations) {
+      loop.quit();
+      return;
+    }
+    sentAt = Clock::now();
+    conn->send(message);
+  });
+  client.connect();
+  loop.loop();
+
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double v : samples) {
+    sum += v;
+  }
+  printf("%-4s rtt_us: avg=%.2f p50=%.2f p99=%.2f (n=%zu, %zu bytes)\n",
+         label, sum / samples.size(), samples[samples.size() / 2],
+         samples[samples.size() * 99 / 100], samples.size(), msgSize);
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+  size_t msgSize = argc > 2 ? atol(argv[2]) : 64;
+  setLogEnabled(false);
+
+  std::atomic<TcpServer *> server{nullptr};
+  std::thread serverThread([&server]() {
+    TcpServer tcpServer("127.0.0.1", kPort);
+    tcpServer.addListener(InetAddress::fromUnixPath(kUnixPath));
+    tcpServer.setThreadNum(1);
+    tcpServer.setConnectionCallback([](const TcpConnectionPtr &) {});
+    tcpServer.setMessageCallback([](const TcpConnectionPtr &conn,
+                                    Buffer &buf) {
+      conn->send(buf.retrieveAllAsString());
+    });
+    server = &tcpServer;
+    tcpServer.start();
+  });
+  while (server.load() == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  runClient("tcp", InetAddress("127.0.0.1", kPort), iterations, msgSize);
+  runClient("uds", InetAddress::fromUnixPath(kUnixPath), iterations, msgSize);
+
+  server.load()->stop();
+  serverThread.join();
+  return 0;
+}
@@ -0,0 +1,412 @@
+// 核心组件的微基准：Buffer 的 append / retrieve / makeSpace / readFd、
+// findCRLF、跨线程 queueInLoop、Channel 分发、经 epoll 的 socketpair 往返。
+//
+// 每项跑 repetitions 次，报告最快一次的 ns/op（以及中位数），同时用
+// perf_event_open 采集这一次的 cycles、instructions、cache misses、
+// branch misses（每 op 平均，只统计用户态、只统计调用线程）。拿不到硬件
+// 计数器时（虚拟机、perf_event_paranoid 限制）这些字段输出 null。
+// 结果以 JSON 输出到 stdout，便于评审时直接 diff：
+//
+//   reactor_microbench > before.json
+//   ... 修改 ...
+//   reactor_microbench > after.json && diff before.json after.json
+//
+// 比较数字时用 Release 构建（输出里的 "optimized" 字段）。
+//
+// 用法: reactor_microbench [filter] [repetitions]
+//   filter  只跑名字包含该子串的基准，"all" 或省略表示全部
+
+#include "Buffer.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <linux/perf_event.h>
+#include <memory>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// 阻止编译器把结果没人用的计算优化掉
+static inline void keep(const void *p) {
+  asm volatile("" : : "r"(p) : "memory");
+}
+
+// ---------------------------------------------------------------------------
+// 硬件计数器
+// ---------------------------------------------------------------------------
+
+static constexpr int kCounters = 4;
+static const char *const kCounterNames[kCounters] = {
+    "cycles", "instructions", "cache_misses", "branch_misses"};
+static const uint64_t kCounterConfigs[kCounters] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+// 本线程的一组计数器，打不开的单个计数器跳过，全部打不开时 available() 为 false
+class PerfCounters {
+public:
+  PerfCounters() {
+    for (int i = 0; i < kCounters; ++i) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = kCounterConfigs[i];
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      fds_[i] = static_cast<int>(
+          ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+      if (fds_[i] < 0 && error_.empty()) {
+        error_ = strerror(errno);
+      }
+    }
+  }
+  ~PerfCounters() {
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  bool available() const {
+    return std::any_of(fds_, fds_ + kCounters, [](int fd) { return fd >= 0; });
+  }
+  bool available(int i) const { return fds_[i] >= 0; }
+  // 第一个打开失败的原因
+  const std::string &error() const { return error_; }
+
+  void start() {
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+  }
+  void stop(uint64_t values[kCounters]) {
+    for (int i = 0; i < kCounters; ++i) {
+      values[i] = 0;
+      if (fds_[i] >= 0) {
+        ::ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (::read(fds_[i], &values[i], sizeof(values[i])) !=
+            sizeof(values[i])) {
+          values[i] = 0;
+        }
+      }
+    }
+  }
+
+private:
+  int fds_[kCounters];
+  std::string error_;
+};
+
+// ---------------------------------------------------------------------------
+// 计时框架
+// ---------------------------------------------------------------------------
+
+// 基准函数自己做准备工作，只把要测的循环包在 start() / stop() 之间
+class Probe {
+public:
+  explicit Probe(PerfCounters &counters) : counters_(counters) {}
+
+  void start() {
+    counters_.start();
+    start_ = Clock::now();
+  }
+  void stop() {
+    elapsed_ = Clock::now() - start_;
+    counters_.stop(values_);
+  }
+
+  Clock::duration elapsed() const { return elapsed_; }
+  uint64_t value(int i) const { return values_[i]; }
+
+private:
+  PerfCounters &counters_;
+  Clock::time_point start_;
+  Clock::duration elapsed_{};
+  uint64_t values_[kCounters] = {};
+};
+
+struct Benchmark {
+  const char *name;
+  uint64_t ops;
+  std::function<void(Probe &, uint64_t)> run;
+};
+
+// ---------------------------------------------------------------------------
+// 基准
+// ---------------------------------------------------------------------------
+
+static void benchBufferAppend(Probe &probe, uint64_t ops) {
+  Buffer buf;
+  char data[64] = {'a'};
+  probe.start();
+  for (uint64_t i = 0; i < ops; ++i) {
+    buf.append(data, sizeof(data));
+    // 攒到 64KB 清空一次，之后不再扩容
+    if ((i & 1023) == 1023) {
+      buf.retrieveAll();
+    }
+  }
+  probe.stop();
+  keep(buf.peek());
+}
+
+static void benchBufferAppendRetrieve(Probe &probe, uint64_t ops) {
+  Buffer buf;
+  char data[64] = {'a'};
+  probe.start();
+  for (uint64_t i = 0; i < ops; ++i) {
+    buf.append(data, sizeof(data));
+    keep(buf.peek());
+    buf.retrieve(sizeof(data));
+  }
+  probe.stop();
+}
+
+static void benchBufferRetrieveAsString(Probe &probe, uint64_t ops) {
+  Buffer buf;
+  char data[64] = {'a'};
+  probe.start();
+  for (uint64_t i = 0; i < ops; ++i) {
+    buf.append(data, sizeof(data));
+    std::string s = buf.retrieveAsString(sizeof(data));
+    keep(s.data());
+  }
+  probe.stop();
+}
+
+// 前面已读走大半、剩余可写空间不够：makeSpace 把未读数据挪回开头而不扩容
+static void benchBufferMakeSpace(Probe &probe, uint64_t ops) {
+  Buffer buf(4096);
+  std::string chunk(3000, 'm');
+  probe.start();
+  for (uint64_t i = 0; i < ops; ++i) {
+    buf.append(chunk.data(), chunk.size());
+    buf.retrieve(chunk.size() - 100);
+    buf.append(chunk.data(), chunk.size());
+    buf.retrieveAll();
+  }
+  probe.stop();
+}
+
+// 每个 op：往 socketpair 写 4KB，再用 readFd 读出来
+static void benchBufferReadFd(Probe &probe, uint64_t ops) {
+  int sv[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) < 0) {
+    perror("socketpair");
+    exit(EXIT_FAILURE);
+  }
+  Buffer buf;
+  std::string chunk(4096, 'r');
+  probe.start();
+  for (uint64_t i = 0; i < ops; ++i) {
+    if (::write(sv[0], chunk.data(), chunk.size()) < 0) {
+      perror("write");
+      exit(EXIT_FAILURE);
+    }
+    buf.readFd(sv[1]);
+    buf.retrieveAll();
+  }
+  probe.stop();
+  ::close(sv[0]);
+  ::close(sv[1]);
+}
+
+// 1KB 的请求头，CRLF 在最后
+static void benchFindCRLF(Probe &probe, uint64_t ops) {
+  Buffer buf;
+  std::string line(1022, 'h');
+  line += "\r\n";
+  buf.append(line.data(), line.size());
+  probe.start();
+  for (uint64_t i = 0; i < ops; ++i) {
+    keep(buf.findCRLF());
+  }
+  probe.stop();
+}
+
+// 每个 op：从本线程向另一个 loop 投递一个任务，最后等全部执行完
+static void benchQueueInLoop(Probe &probe, uint64_t ops) {
+  EventLoopThread thread("microbench");
+  EventLoop *loop = thread.startLoop();
+  std::atomic<uint64_t> done{0};
+  probe.start();
+  for (uint64_t i = 0; i < ops; ++i) {
+    loop->queueInLoop(
+        [&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+  }
+  while (done.load(std::memory_order_relaxed) < ops) {
+    std::this_thread::yield();
+  }
+  probe.stop();
+}
+
+// 每个 op：一次 Channel::handleEvent 到读回调
+static void benchChannelDispatch(Probe &probe, uint64_t ops) {
+  EventLoop loop;
+  Channel channel(-1, loop.getPoller());
+  uint64_t calls = 0;
+  channel.setReadCallback([&calls]() { ++calls; });
+  channel.setReadEvent(EPOLLIN);
+  probe.start();
+  for (uint64_t i = 0; i < ops; ++i) {
+    channel.handleEvent();
+  }
+  probe.stop();
+  keep(&calls);
+}
+
+// 每个 op：一个事件经过 epoll_wait、Channel 分发、read、write 回对端
+static void benchEpollRoundTrip(Probe &probe, uint64_t ops) {
+  int sv[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) < 0) {
+    perror("socketpair");
+    exit(EXIT_FAILURE);
+  }
+  EventLoop loop;
+  uint64_t events = 0;
+  std::vector<std::unique_ptr<Channel>> channels;
+  for (int fd : sv) {
+    auto channel = std::make_unique<Channel>(fd, loop.getPoller());
+    channel->setReadCallback([fd, ops, &events, &loop]() {
+      char c;
+      if (::read(fd, &c, 1) == 1 && ::write(fd, &c, 1) != 1) {
+        perror("write");
+      }
+      if (++events >= ops) {
+        loop.quit();
+      }
+    });
+    channel->enableReading();
+    channels.push_back(std::move(channel));
+  }
+  if (::write(sv[0], "x", 1) != 1) {
+    perror("write");
+    exit(EXIT_FAILURE);
+  }
+  probe.start();
+  loop.loop();
+  probe.stop();
+  for (auto &channel : channels) {
+    loop.getPoller()->removeChannel(channel.get());
+  }
+  ::close(sv[0]);
+  ::close(sv[1]);
+}
+
+// ---------------------------------------------------------------------------
+
+struct Result {
+  double bestNs = 0;
+  double medianNs = 0;
+  uint64_t counters[kCounters] = {};
+};
+
+static Result measure(const Benchmark &bench, PerfCounters &counters,
+                      int repetitions) {
+  // 预热一次，规模小一些
+  {
+    Probe probe(counters);
+    bench.run(probe, std::max<uint64_t>(bench.ops / 10, 1));
+  }
+  std::vector<double> ns;
+  Result result;
+  for (int r = 0; r < repetitions; ++r) {
+    Probe probe(counters);
+    bench.run(probe, bench.ops);
+    double perOp = std::chrono::duration<double, std::nano>(probe.elapsed())
+                       .count() /
+                   bench.ops;
+    if (ns.empty() || perOp < result.bestNs) {
+      result.bestNs = perOp;
+      for (int i = 0; i < kCounters; ++i) {
+        result.counters[i] = probe.value(i);
+      }
+    }
+    ns.push_back(perOp);
+  }
+  std::sort(ns.begin(), ns.end());
+  result.medianNs = ns[ns.size() / 2];
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  std::string filter = argc > 1 ? argv[1] : "all";
+  int repetitions = argc > 2 ? std::max(atoi(argv[2]), 1) : 5;
+  setLogEnabled(false);
+
+  const std::vector<Benchmark> benchmarks = {
+      {"buffer_append_64", 2000000, benchBufferAppend},
+      {"buffer_append_retrieve_64", 2000000, benchBufferAppendRetrieve},
+      {"buffer_retrieve_as_string_64", 1000000, benchBufferRetrieveAsString},
+      {"buffer_make_space_3k", 200000, benchBufferMakeSpace},
+      {"buffer_read_fd_4k", 100000, benchBufferReadFd},
+      {"find_crlf_1k", 500000, benchFindCRLF},
+      {"queue_in_loop_cross_thread", 200000, benchQueueInLoop},
+      {"channel_dispatch", 2000000, benchChannelDispatch},
+      {"epoll_round_trip", 100000, benchEpollRoundTrip},
+  };
+
+  PerfCounters counters;
+#ifdef __OPTIMIZE__
+  const bool optimized = true;
+#else
+  const bool optimized = false;
+#endif
+  printf("{\n  \"optimized\": %s,\n  \"repetitions\": %d,\n",
+         optimized ? "true" : "false", repetitions);
+  if (counters.available()) {
+    printf("  \"counters_available\": true,\n");
+  } else {
+    printf("  \"counters_available\": false,\n  \"counters_error\": \"%s\",\n",
+           counters.error().c_str());
+  }
+  printf("  \"benchmarks\": [");
+  bool first = true;
+  for (const Benchmark &bench : benchmarks) {
+    if (filter != "all" && std::string(bench.name).find(filter) ==
+                               std::string::npos) {
+      continue;
+    }
+    Result result = measure(bench, counters, repetitions);
+    printf("%s\n    {\"name\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.2f, "
+           "\"ns_per_op_median\": %.2f",
+           first ? "" : ",", bench.name,
+           static_cast<unsigned long long>(bench.ops), result.bestNs,
+           result.medianNs);
+    for (int i = 0; i < kCounters; ++i) {
+      if (counters.available(i)) {
+        printf(", \"%s_per_op\": %.2f", kCounterNames[i],
+               static_cast<double>(result.counters[i]) / bench.ops);
+      } else {
+        printf(", \"%s_per_op\": null", kCounterNames[i]);
+      }
+    }
+    printf("}");
+    fflush(stdout);
+    first = false;
+  }
+  printf("\n  ]\n}\n");
+  return 0;
+}
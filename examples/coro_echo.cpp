@@ -0,0 +1,54 @@
+// 用协程写的按行协议服务器：
+//   ECHO <text>    回显 text
+//   SLEEP <ms>     等待 ms 毫秒后回复 OK（只挂起这个连接的协程，不阻塞 loop）
+//   QUIT           关闭连接
+//
+// 用法: coro_echo <ip> <port>，然后 nc <ip> <port> 逐行输入
+
+#include "TcpServer.h"
+#include "Task.h"
+#include <chrono>
+#include <string>
+
+static Task<> serve(TcpConnectionPtr conn) {
+  while (true) {
+    std::string line = co_await conn->readUntil("\n");
+    if (line.empty() || line.back() != '\n') {
+      break; // 连接已关闭
+    }
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+      line.pop_back();
+    }
+
+    if (line.starts_with("ECHO ")) {
+      co_await conn->write(line.substr(5) + "\n");
+    } else if (line.starts_with("SLEEP ")) {
+      co_await conn->getLoop()->sleep(
+          std::chrono::milliseconds(std::stol(line.substr(6))));
+      co_await conn->write("OK\n");
+    } else if (line == "QUIT") {
+      co_await conn->write("BYE\n");
+      conn->shutdown();
+      break;
+    } else {
+      co_await conn->write("ERR unknown command\n");
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    logError("Usage: " + std::string(argv[0]) + " <ip> <port>", "main");
+    return 1;
+  }
+  TcpServer server(argv[1], static_cast<uint16_t>(atoi(argv[2])));
+  server.setThreadNum(2);
+  // 不设置 messageCallback，连接上的数据都交给协程
+  server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      serve(conn).detach();
+    }
+  });
+  server.start();
+  return 0;
+}
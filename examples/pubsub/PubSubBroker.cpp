@@ -0,0 +1,225 @@
+#include "PubSubBroker.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
+
+static constexpr size_t kLengthSize = 4;
+static constexpr size_t kHeaderSize = 1 + 2; // 操作 + 主题长度
+
+std::string encodePubSubFrame(uint8_t op, std::string_view topic,
+                              std::string_view payload) {
+  uint32_t length = htonl(
+      static_cast<uint32_t>(kHeaderSize + topic.size() + payload.size()));
+  uint16_t topicLength = htons(static_cast<uint16_t>(topic.size()));
+  std::string frame;
+  frame.reserve(kLengthSize + kHeaderSize + topic.size() + payload.size());
+  frame.append(reinterpret_cast<const char *>(&length), sizeof(length));
+  frame.push_back(static_cast<char>(op));
+  frame.append(reinterpret_cast<const char *>(&topicLength),
+               sizeof(topicLength));
+  frame.append(topic);
+  frame.append(payload);
+  return frame;
+}
+
+int decodePubSubFrame(Buffer &buf, PubSubFrame &frame, size_t maxFrameSize) {
+  if (buf.readableBytes() < kLengthSize) {
+    return 0;
+  }
+  uint32_t length = 0;
+  memcpy(&length, buf.peek(), sizeof(length));
+  length = ntohl(length);
+  if (length < kHeaderSize || length > maxFrameSize) {
+    return -1;
+  }
+  if (buf.readableBytes() < kLengthSize + length) {
+    return 0;
+  }
+  const char *p = buf.peek() + kLengthSize;
+  uint16_t topicLength = 0;
+  memcpy(&topicLength, p + 1, sizeof(topicLength));
+  topicLength = ntohs(topicLength);
+  if (kHeaderSize + topicLength > length) {
+    return -1;
+  }
+  frame.op = static_cast<uint8_t>(p[0]);
+  frame.topic.assign(p + kHeaderSize, topicLength);
+  frame.payload.assign(p + kHeaderSize + topicLength,
+                       length - kHeaderSize - topicLength);
+  buf.retrieve(kLengthSize + length);
+  return 1;
+}
+
+PubSubBroker::PubSubBroker(const InetAddress &listenAddr,
+                           const Options &options)
+    : server_(listenAddr), options_(options), published_(0), delivered_(0),
+      dropped_(0), disconnected_(0) {
+  server_.setConnectionCallback(
+      [this](const TcpConnectionPtr &conn) { onConnection(conn); });
+  server_.setMessageCallback([this](const TcpConnectionPtr &conn,
+                                    Buffer &buf) { onMessage(conn, buf); });
+}
+
+/**
+ * @brief 取 loop 的订阅表，第一次访问时登记
+ *
+ * 每个 loop 固定在一个线程上，缓存本线程上次查到的表项，避免每条消息都加锁
+ */
+PubSubBroker::LoopState &PubSubBroker::stateFor(EventLoop *loop) {
+  thread_local PubSubBroker *cachedBroker = nullptr;
+  thread_local LoopState *cachedState = nullptr;
+  if (cachedBroker == this && cachedState->loop == loop) {
+    return *cachedState;
+  }
+  std::lock_guard<std::mutex> lock(loopsMutex_);
+  std::unique_ptr<LoopState> &slot = loops_[loop];
+  if (!slot) {
+    slot = std::make_unique<LoopState>();
+    slot->loop = loop;
+    loopList_.push_back(slot.get());
+  }
+  cachedBroker = this;
+  cachedState = slot.get();
+  return *slot;
+}
+
+void PubSubBroker::onConnection(const TcpConnectionPtr &conn) {
+  LoopState &state = stateFor(conn->getLoop());
+  if (conn->connected()) {
+    conn->setCorked(true);
+    return;
+  }
+  auto it = state.topicsOf.find(conn.get());
+  if (it == state.topicsOf.end()) {
+    return;
+  }
+  std::unordered_set<std::string> topics = std::move(it->second);
+  state.topicsOf.erase(it);
+  for (const std::string &topic : topics) {
+    unsubscribe(state, conn.get(), topic);
+  }
+}
+
+void PubSubBroker::onMessage(const TcpConnectionPtr &conn, Buffer &buf) {
+  LoopState &state = stateFor(conn->getLoop());
+  PubSubFrame frame;
+  while (true) {
+    int result = decodePubSubFrame(buf, frame, options_.maxFrameSize);
+    if (result == 0) {
+      break;
+    }
+    if (result < 0) {
+      logError("bad frame from " + conn->peerAddress().toString(),
+               "PubSubBroker");
+      conn->forceClose();
+      return;
+    }
+    switch (frame.op) {
+    case kSubscribe:
+      subscribe(state, conn, frame.topic);
+      break;
+    case kUnsubscribe:
+      if (auto it = state.topicsOf.find(conn.get());
+          it != state.topicsOf.end() && it->second.erase(frame.topic) > 0) {
+        unsubscribe(state, conn.get(), frame.topic);
+      }
+      break;
+    case kPublish:
+      publish(state, frame);
+      break;
+    default:
+      logError("unknown op " + std::to_string(frame.op), "PubSubBroker");
+      conn->forceClose();
+      return;
+    }
+  }
+}
+
+void PubSubBroker::subscribe(LoopState &state, const TcpConnectionPtr &conn,
+                             const std::string &topic) {
+  if (state.topicsOf[conn.get()].insert(topic).second) {
+    state.subscribers[topic].push_back(conn);
+  }
+}
+
+// 只从订阅者列表里摘除，topicsOf 由调用方维护
+void PubSubBroker::unsubscribe(LoopState &state, TcpConnection *conn,
+                               const std::string &topic) {
+  auto it = state.subscribers.find(topic);
+  if (it == state.subscribers.end()) {
+    return;
+  }
+  std::vector<TcpConnectionPtr> &subs = it->second;
+  auto pos = std::find_if(subs.begin(), subs.end(),
+                          [conn](const TcpConnectionPtr &c) {
+                            return c.get() == conn;
+                          });
+  if (pos != subs.end()) {
+    *pos = std::move(subs.back());
+    subs.pop_back();
+  }
+  if (subs.empty()) {
+    state.subscribers.erase(it);
+  }
+}
+
+// MESSAGE 帧在这里编码一次，之后所有 loop、所有订阅者共用
+void PubSubBroker::publish(LoopState &state, PubSubFrame &frame) {
+  SharedPayload message = std::make_shared<const std::string>(
+      encodePubSubFrame(kMessage, frame.topic, frame.payload));
+  if (state.outbox.empty()) {
+    state.loop->queueBeforePoll([this, &state]() { flushOutbox(state); });
+  }
+  state.outbox.push_back(Delivery{std::move(frame.topic), std::move(message)});
+  published_.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief 把本轮攒下的发布打成一批分发到所有 loop
+ *
+ * 本 loop 直接分发，其他 loop 每个只投递一个任务（一次唤醒），批次共享不拷贝
+ */
+void PubSubBroker::flushOutbox(LoopState &state) {
+  auto batch = std::make_shared<const Batch>(std::move(state.outbox));
+  state.outbox.clear();
+  std::vector<LoopState *> targets;
+  {
+    std::lock_guard<std::mutex> lock(loopsMutex_);
+    targets = loopList_;
+  }
+  for (LoopState *target : targets) {
+    if (target == &state) {
+      deliver(state, *batch);
+    } else {
+      target->loop->queueInLoop(
+          [this, target, batch]() { deliver(*target, *batch); });
+    }
+  }
+}
+
+void PubSubBroker::deliver(LoopState &state, const Batch &batch) {
+  uint64_t delivered = 0;
+  for (const Delivery &d : batch) {
+    auto it = state.subscribers.find(d.topic);
+    if (it == state.subscribers.end()) {
+      continue;
+    }
+    for (const TcpConnectionPtr &conn : it->second) {
+      if (!conn->connected()) {
+        continue;
+      }
+      if (conn->outputBuffer()->readableBytes() > options_.maxPendingBytes) {
+        if (options_.slowPolicy == kDisconnect) {
+          disconnected_.fetch_add(1, std::memory_order_relaxed);
+          conn->forceClose();
+        } else {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        continue;
+      }
+      conn->send(d.frame);
+      ++delivered;
+    }
+  }
+  delivered_.fetch_add(delivered, std::memory_order_relaxed);
+}
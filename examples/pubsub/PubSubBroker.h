@@ -0,0 +1,105 @@
+#pragma once
+
+#include "TcpServer.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// 帧格式：| 长度 u32 | 操作 u8 | 主题长度 u16 | 主题 | 负载 |
+// 整数为网络字节序，长度不含自身。客户端发 SUBSCRIBE / UNSUBSCRIBE（负载为空）
+// 和 PUBLISH，服务端把 PUBLISH 以 MESSAGE 帧转给该主题的所有订阅者
+enum PubSubOp : uint8_t {
+  kSubscribe = 1,
+  kUnsubscribe = 2,
+  kPublish = 3,
+  kMessage = 4,
+};
+
+struct PubSubFrame {
+  uint8_t op = 0;
+  std::string topic;
+  std::string payload;
+};
+
+std::string encodePubSubFrame(uint8_t op, std::string_view topic,
+                              std::string_view payload);
+// 从 buf 里取出一帧：1 表示成功，0 表示数据还不完整，
+// -1 表示格式错误或帧长超过 maxFrameSize
+int decodePubSubFrame(Buffer &buf, PubSubFrame &frame, size_t maxFrameSize);
+
+// 按主题发布/订阅的消息服务器。
+//
+// 订阅表按 EventLoop 分区：每个 loop 只记录自己的连接订阅了什么，
+// 读写都在本 loop 线程里，不加锁。一个 loop 在一轮里收到的所有发布
+// 先攒在本 loop 的 outbox 里，回到 epoll_wait 之前打成一批，
+// 给其他每个 loop 只投递一个任务，由它们查各自的订阅表分发。
+// MESSAGE 帧只编码一次，所有订阅者共用（SharedPayload）。
+//
+// 订阅者开启写合并，同一轮分发给它的多条消息一次写出。输出缓冲区积压超过
+// maxPendingBytes 的慢订阅者按 slowPolicy 处理：丢弃新消息，或者断开连接。
+class PubSubBroker {
+public:
+  enum SlowPolicy { kDropMessages, kDisconnect };
+
+  struct Options {
+    size_t maxPendingBytes = 4 * 1024 * 1024;
+    SlowPolicy slowPolicy = kDropMessages;
+    size_t maxFrameSize = 16 * 1024 * 1024;
+  };
+
+  PubSubBroker(const InetAddress &listenAddr, const Options &options);
+
+  void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+  // 运行到 stop() 为止
+  void start() { server_.start(); }
+  void stop() { server_.stop(); }
+
+  uint64_t published() const { return published_.load(); }
+  uint64_t delivered() const { return delivered_.load(); }
+  uint64_t dropped() const { return dropped_.load(); }
+  uint64_t disconnected() const { return disconnected_.load(); }
+
+private:
+  struct Delivery {
+    std::string topic;
+    SharedPayload frame;
+  };
+  using Batch = std::vector<Delivery>;
+
+  // 一个 EventLoop 上的订阅表，只在该 loop 线程访问
+  struct LoopState {
+    EventLoop *loop = nullptr;
+    std::unordered_map<std::string, std::vector<TcpConnectionPtr>> subscribers;
+    std::unordered_map<TcpConnection *, std::unordered_set<std::string>>
+        topicsOf;
+    Batch outbox;
+  };
+
+  LoopState &stateFor(EventLoop *loop);
+  void onConnection(const TcpConnectionPtr &conn);
+  void onMessage(const TcpConnectionPtr &conn, Buffer &buf);
+  void subscribe(LoopState &state, const TcpConnectionPtr &conn,
+                 const std::string &topic);
+  void unsubscribe(LoopState &state, TcpConnection *conn,
+                   const std::string &topic);
+  void publish(LoopState &state, PubSubFrame &frame);
+  void flushOutbox(LoopState &state);
+  void deliver(LoopState &state, const Batch &batch);
+
+  TcpServer server_;
+  Options options_;
+  // loop 第一次有连接时登记，发布时向所有已登记的 loop 分发
+  std::mutex loopsMutex_;
+  std::unordered_map<EventLoop *, std::unique_ptr<LoopState>> loops_;
+  std::vector<LoopState *> loopList_;
+  std::atomic<uint64_t> published_;
+  std::atomic<uint64_t> delivered_;
+  std::atomic<uint64_t> dropped_;
+  std::atomic<uint64_t> disconnected_;
+};
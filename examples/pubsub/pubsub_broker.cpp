@@ -0,0 +1,27 @@
+// 发布/订阅服务器，协议见 PubSubBroker.h。
+//
+// 用法: pubsub_broker <ip> <port> [threads] [drop|disconnect]
+//   drop        慢订阅者积压过多时丢弃发给它的新消息（默认）
+//   disconnect  慢订阅者积压过多时断开它
+
+#include "PubSubBroker.h"
+#include <cstdlib>
+#include <string>
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    logError("Usage: " + std::string(argv[0]) +
+                 " <ip> <port> [threads] [drop|disconnect]",
+             "main");
+    return 1;
+  }
+  PubSubBroker::Options options;
+  if (argc > 4 && std::string(argv[4]) == "disconnect") {
+    options.slowPolicy = PubSubBroker::kDisconnect;
+  }
+  uint16_t port = static_cast<uint16_t>(atoi(argv[2]));
+  PubSubBroker broker(InetAddress(argv[1], port), options);
+  broker.setThreadNum(argc > 3 ? atoi(argv[3]) : 4);
+  broker.start();
+  return 0;
+}
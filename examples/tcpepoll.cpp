@@ -39,14 +39,20 @@ void onClose(const TcpConnectionPtr &conn) {
 }
 
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    logError("Usage: " + std::string(argv[0]) + " <ip> <port>", "main");
+  if (argc != 3 && argc != 4) {
+    logError("Usage: " + std::string(argv[0]) + " <ip> <port> [upgrade-path]",
+             "main");
     return 1;
   }
   const char *ip = argv[1];
   int port = atoi(argv[2]);
+  // 传入 upgrade-path 时支持热重启：用同一路径再启动一个新进程即可无缝替换
+  std::string upgradePath = argc == 4 ? argv[3] : "";
 
-  TcpServer tcpServer(ip, port);
+  TcpServer tcpServer(ip, port, upgradePath);
+  if (!upgradePath.empty()) {
+    tcpServer.enableHotRestart(upgradePath);
+  }
 
   // 设置线程数
   tcpServer.setThreadNum(4);
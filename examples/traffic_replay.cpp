@@ -0,0 +1,233 @@
+// 重放 TrafficCapture 录下的流量：按录制时的相对时间为每个连接建立新连接、
+// 发送它当时收到的字节、在它关闭的时间点半关闭，服务端的响应读出后丢弃。
+//
+// 用法: traffic_replay <capture-file> <ip> <port> [speed]
+//   speed  时间缩放，1 为原速（默认），2 为两倍速，0 为不等待、尽快发完
+//
+// 录制端：服务端调用 TcpServer::setCapture(TrafficCapture::open(path))。
+// 录制时因积压丢过数据的连接（kGap）只重放缺口之前的部分，在缺口处半关闭。
+// 结束时打印发送量、接收量、被截断的连接数，
+// 以及实际发送时间比计划晚了多少（调度延迟）。
+
+#include "TcpClient.h"
+#include "TrafficCapture.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+using Clock = std::chrono::steady_clock;
+
+// 录制里的一个连接
+struct ReplayConnection {
+  std::unique_ptr<TcpClient> client;
+  TcpConnectionPtr conn;
+  std::string pending;       // 连上之前就到期的数据
+  bool closeRequested = false;
+  bool finished = false;
+};
+
+class Replayer {
+public:
+  Replayer(EventLoop *loop, const InetAddress &serverAddr, double speed)
+      : loop_(loop), serverAddr_(serverAddr), speed_(speed) {}
+
+  bool open(const std::string &path) { return reader_.open(path); }
+
+  void start() {
+    start_ = Clock::now();
+    haveNext_ = reader_.next(next_);
+    pump();
+  }
+
+  void printSummary() const {
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - start_).count();
+    printf("replayed %llu records, %llu connections in %.2f s "
+           "(captured span %.2f s, speed %g)%s\n",
+           static_cast<unsigned long long>(records_),
+           static_cast<unsigned long long>(connections_.size()), seconds,
+           lastRecordTime_.count() / 1e6, speed_,
+           reader_.corrupted() ? ", capture file truncated" : "");
+    printf("sent %llu bytes, received %llu bytes, "
+           "%llu connections still open\n",
+           static_cast<unsigned long long>(bytesSent_),
+           static_cast<unsigned long long>(bytesReceived_),
+           static_cast<unsigned long long>(open_));
+    if (truncated_ > 0) {
+      printf("%llu connections lost data while capturing, "
+             "replayed only up to the gap\n",
+             static_cast<unsigned long long>(truncated_));
+    }
+    // speed 为 0 时所有记录都在开始时到期，调度延迟没有意义
+    if (speed_ > 0) {
+      printf("schedule lag: avg %.1f us, max %.1f us\n",
+             records_ > 0 ? lagTotalUs_ / records_ : 0.0, lagMaxUs_);
+    }
+  }
+
+private:
+  // 每次最多处理这么多条记录，之后让出 loop 处理连接上的事件
+  static constexpr int kMaxRecordsPerPump = 1024;
+  // 全部记录发完后，最多等这么久让服务端关闭连接
+  static constexpr auto kDrainTimeout = std::chrono::seconds(5);
+
+  Clock::time_point dueTime(std::chrono::microseconds t) const {
+    if (speed_ <= 0) {
+      return start_;
+    }
+    return start_ + std::chrono::duration_cast<Clock::duration>(t / speed_);
+  }
+
+  /**
+   * @brief 处理所有已经到期的记录，然后为下一条记录定时
+   */
+  void pump() {
+    for (int i = 0; haveNext_ && i < kMaxRecordsPerPump; ++i) {
+      Clock::time_point due = dueTime(next_.time);
+      Clock::time_point now = Clock::now();
+      if (due > now) {
+        loop_->runAfter(due - now, [this]() { pump(); });
+        return;
+      }
+      double lagUs = std::chrono::duration<double, std::micro>(now - due)
+                         .count();
+      lagTotalUs_ += lagUs;
+      lagMaxUs_ = std::max(lagMaxUs_, lagUs);
+      ++records_;
+      lastRecordTime_ = next_.time;
+      apply(next_);
+      haveNext_ = reader_.next(next_);
+    }
+    if (haveNext_) {
+      loop_->runAfter(Clock::duration::zero(), [this]() { pump(); });
+      return;
+    }
+    finishedReading_ = true;
+    loop_->runAfter(kDrainTimeout, [this]() { loop_->quit(); });
+    quitIfDone();
+  }
+
+  void apply(CaptureRecord &record) {
+    switch (record.type) {
+    case TrafficCapture::kOpen:
+      openConnection(record.connId);
+      break;
+    case TrafficCapture::kData: {
+      auto it = connections_.find(record.connId);
+      if (it == connections_.end()) {
+        break;
+      }
+      ReplayConnection &rc = *it->second;
+      bytesSent_ += record.data.size();
+      if (rc.conn) {
+        rc.conn->send(record.data);
+      } else {
+        rc.pending += record.data;
+      }
+      break;
+    }
+    case TrafficCapture::kGap:
+      ++truncated_;
+      [[fallthrough]];
+    case TrafficCapture::kClose: {
+      // 缺口之后录制里没有这个连接的数据了，按关闭处理
+      auto it = connections_.find(record.connId);
+      if (it == connections_.end() || it->second->closeRequested) {
+        break;
+      }
+      ReplayConnection &rc = *it->second;
+      rc.closeRequested = true;
+      if (rc.conn) {
+        rc.conn->shutdown();
+      }
+      break;
+    }
+    }
+  }
+
+  void openConnection(uint64_t connId) {
+    auto rc = std::make_unique<ReplayConnection>();
+    ReplayConnection *raw = rc.get();
+    rc->client = std::make_unique<TcpClient>(
+        loop_, serverAddr_, "replay" + std::to_string(connId));
+    rc->client->setConnectionCallback(
+        [this, raw](const TcpConnectionPtr &conn) {
+          if (conn->connected()) {
+            raw->conn = conn;
+            if (!raw->pending.empty()) {
+              conn->send(raw->pending);
+              raw->pending.clear();
+            }
+            if (raw->closeRequested) {
+              conn->shutdown();
+            }
+            return;
+          }
+          raw->conn.reset();
+          if (!raw->finished) {
+            raw->finished = true;
+            --open_;
+            quitIfDone();
+          }
+        });
+    rc->client->setMessageCallback([this](const TcpConnectionPtr &,
+                                          Buffer &buf) {
+      bytesReceived_ += buf.readableBytes();
+      buf.retrieveAll();
+    });
+    rc->client->connect();
+    ++open_;
+    connections_[connId] = std::move(rc);
+  }
+
+  void quitIfDone() {
+    if (finishedReading_ && open_ == 0) {
+      loop_->quit();
+    }
+  }
+
+  EventLoop *loop_;
+  const InetAddress serverAddr_;
+  const double speed_;
+  CaptureReader reader_;
+  CaptureRecord next_;
+  bool haveNext_ = false;
+  bool finishedReading_ = false;
+  Clock::time_point start_;
+  std::unordered_map<uint64_t, std::unique_ptr<ReplayConnection>>
+      connections_;
+  uint64_t open_ = 0;
+  uint64_t records_ = 0;
+  uint64_t bytesSent_ = 0;
+  uint64_t bytesReceived_ = 0;
+  uint64_t truncated_ = 0;
+  double lagTotalUs_ = 0;
+  double lagMaxUs_ = 0;
+  std::chrono::microseconds lastRecordTime_{0};
+};
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    logError("Usage: " + std::string(argv[0]) +
+                 " <capture-file> <ip> <port> [speed]",
+             "main");
+    return 1;
+  }
+  setLogEnabled(false);
+  double speed = argc > 4 ? atof(argv[4]) : 1.0;
+  EventLoop loop;
+  Replayer replayer(&loop,
+                    InetAddress(argv[2], static_cast<uint16_t>(atoi(argv[3]))),
+                    speed);
+  if (!replayer.open(argv[1])) {
+    return 1;
+  }
+  replayer.start();
+  loop.loop();
+  replayer.printSummary();
+  return 0;
+}
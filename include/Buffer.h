@@ -11,6 +11,7 @@ public:
   static const size_t kCheapPrepend = 8;
   static const size_t kInitialSize = 1024;
 
+  // 存储在第一次写入时才分配（空闲连接不占缓冲区内存）
   explicit Buffer(size_t initialSize = kInitialSize);
   ~Buffer();
 
@@ -34,6 +35,13 @@ public:
 
   ssize_t readFd(int fd);
 
+  // 没有可读数据时归还存储：默认大小的块放回当前线程的池，变大过的直接释放
+  void release();
+  // 把存储收缩到 可读数据 + reserve 字节，用于突发流量过后还剩少量数据的缓冲区
+  void shrink(size_t reserve);
+  size_t capacity() const { return buffer_.capacity(); }
+  bool allocated() const { return !buffer_.empty(); }
+
 private:
   char *begin();
   const char *begin() const;
@@ -43,4 +51,5 @@ private:
   std::vector<char> buffer_;
   size_t readerIndex_;
   size_t writerIndex_;
+  size_t initialSize_;
 };
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 
 #include "Buffer.h"
 
@@ -9,6 +10,8 @@ class TcpConnection;
 
 // 连接指针
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+// 不可变的共享消息，广播时只拷贝一次，各连接共用
+using SharedPayload = std::shared_ptr<const std::string>;
 
 // 连接回调
 using TcpConnectionCallback = std::function<void(const TcpConnectionPtr &)>;
@@ -18,3 +21,6 @@ using MessageCallback = std::function<void(const TcpConnectionPtr &, Buffer &)>;
 using CloseCallback = std::function<void(const TcpConnectionPtr &)>;
 // 写完成回调
 using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
+// 输出缓冲区超过高水位回调，第二个参数为当前待发送字节数
+using HighWaterMarkCallback =
+    std::function<void(const TcpConnectionPtr &, size_t)>;
@@ -15,6 +15,8 @@ void log(const std::string &message, const std::string &func,
 void logError(const std::string &message, const std::string &func,
               const std::experimental::source_location &location =
                   std::experimental::source_location::current());
+// 关闭后 log() 不再输出（logError 不受影响），压测和基准测试时使用
+void setLogEnabled(bool on);
 
 class Poller;
 
@@ -26,6 +28,8 @@ public:
   int getFd() const;
   void useEdgeTrigger(bool on);
   void enableReading();
+  void disableReading();
+  bool isReading() const;
   void enableWriting();
   void disableWriting();
   bool isWriting() const;
@@ -39,17 +43,29 @@ public:
   void setWriteCallback(std::function<void()> callback);
 
   void disableAll();
+  // 换到另一个 Poller（连接迁移到别的 loop），调用前须已从原 Poller
+  // removeChannel，之后在新 loop 线程里重新打开读写
+  void setPoller(Poller *poller);
 
   static const int kNoneEvent = 0;
   static const int kReadEvent = EPOLLIN | EPOLLPRI;
   static const int kWriteEvent = EPOLLOUT;
 
 private:
+  // Epoll 的批量更新记账：兴趣集的修改先只记在 events_ 上，
+  // 下一次 epoll_wait 之前统一提交
+  friend class Epoll;
+
   int fd_;
   Poller *epoll_;
-  bool inEpoll_;
+  bool inEpoll_; // 已经 EPOLL_CTL_ADD 到内核
   uint32_t events_;
   uint32_t revents_;
+  uint32_t registeredEvents_; // 内核里当前的兴趣集
+  int dirtyIndex_;            // 在 Epoll 待提交列表里的下标，-1 表示不在
+  // 本轮重新打开过读或写：边缘触发下即使最终兴趣集没变也要 MOD 一次，
+  // 让内核为已经就绪的数据再报一次事件
+  bool rearm_;
   std::function<void()> readCallback_;
   std::function<void()> closeCallback_;
   std::function<void()> writeCallback_;
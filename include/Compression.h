@@ -0,0 +1,127 @@
+#pragma once
+
+#include "Buffer.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <zlib.h>
+
+// 连接级压缩的参数，见 TcpServer::setCompression / TcpClient::enableCompression
+struct CompressionOptions {
+  // zlib 压缩级别 1-9，1 最快
+  int level = 1;
+  // 小于这么多字节的 send 不压缩，原样成帧发送
+  size_t minSize = 256;
+  // deflate 窗口 2^windowBits 字节（9-15），越小每个连接占的内存越少、
+  // 能引用的历史数据越短
+  int windowBits = 15;
+  // 解码出来、还没被取走的数据超过这么多视为协议错误（解压炸弹），
+  // 需大于最大的消息
+  size_t maxDecodedBacklog = 64 * 1024 * 1024;
+  // 连接可用后这么久还没协商完：服务端退回明文（对端没有发 hello，
+  // 可能是在等服务端先说话），客户端报错断开（对端不回应 hello）
+  std::chrono::milliseconds negotiationTimeout{500};
+};
+
+// 一个连接上的压缩统计，只在连接所属 loop 线程读
+struct CompressionStats {
+  uint64_t plainBytesOut = 0; // 交给 send 的字节
+  uint64_t wireBytesOut = 0;  // 编码后写到 socket 的字节（含帧头）
+  uint64_t plainBytesIn = 0;  // 解码后交给消息回调的字节
+  uint64_t wireBytesIn = 0;   // 从 socket 读到的帧字节（含帧头）
+  uint64_t framesCompressed = 0;
+  uint64_t framesRaw = 0; // 低于 minSize 原样发送的帧
+  std::chrono::nanoseconds compressTime{0};
+  std::chrono::nanoseconds decompressTime{0};
+
+  // 压缩比（明文 / 线上字节），没有数据时为 1
+  double ratioOut() const {
+    return wireBytesOut > 0 ? static_cast<double>(plainBytesOut) / wireBytesOut
+                            : 1.0;
+  }
+  double ratioIn() const {
+    return wireBytesIn > 0 ? static_cast<double>(plainBytesIn) / wireBytesIn
+                           : 1.0;
+  }
+};
+
+// TcpConnection 的压缩层：位于 socket 字节流和用户的 send / 消息回调之间，
+// 每次 send 编成一帧，收到的帧解码后交给消息回调，对用户透明。
+//
+// 协商由客户端发起：连接建立后客户端先发 hello（"RZC" 版本 支持的算法），
+// 服务端回 ack（"RZC" 版本 选中的算法），之后两个方向都按帧传输；
+// 选中的算法为 kNone 时双方退回明文。服务端收到的头几个字节不是 hello 时
+// 认为对端不支持，这个连接保持明文。协商完成之前的 send 先缓存在这里；
+// 服务端在 negotiationTimeout 内没收到任何字节时同样退回明文，把缓存的数据
+// 发出去，服务端先说话的协议只多等这一段时间。
+//
+// 帧格式：类型(1 字节) 长度(4 字节大端) 内容。kDeflate 帧的内容是同一个
+// deflate 流用 Z_SYNC_FLUSH 切出的一段，压缩上下文在整个连接上复用，
+// 后面的消息可以引用前面消息里的重复内容；kRaw 帧不进入 deflate 流。
+// 一帧在线上和解压后都不超过 kMaxFrameSize，大的 send 拆成多帧，
+// 解压后超出的帧（解压炸弹）视为协议错误。
+class CompressionCodec {
+public:
+  enum Algorithm : uint8_t { kNone = 0, kDeflate = 1 };
+  enum FrameType : uint8_t { kRawFrame = 0, kDeflateFrame = 1 };
+
+  static constexpr uint8_t kVersion = 1;
+  static constexpr size_t kHandshakeSize = 5;
+  static constexpr size_t kFrameHeaderSize = 5;
+  // 一帧线上长度和解压后长度的上限，超过视为协议错误
+  static constexpr uint32_t kMaxFrameSize = 1024 * 1024;
+
+  CompressionCodec(const CompressionOptions &options, bool isServer);
+  ~CompressionCodec();
+  CompressionCodec(const CompressionCodec &) = delete;
+  CompressionCodec &operator=(const CompressionCodec &) = delete;
+
+  // 还在协商或已经启用压缩；为 false 时连接是普通明文，不再经过这里
+  bool active() const { return state_ != kPlain; }
+  bool negotiating() const { return state_ == kNegotiating; }
+  bool compressing() const { return state_ == kCompressed; }
+  const CompressionOptions &options() const { return options_; }
+  // 协商超时：服务端退回明文并返回 true；客户端的 hello 已经发出，
+  // 无法退回，返回 false
+  bool abandonNegotiation();
+
+  // 编码一次 send 的数据。返回要写到 socket 的帧，引用内部缓冲区，
+  // 下一次 encode 之前有效；协商完成之前返回空，数据先缓存
+  const std::string &encode(const char *data, size_t len);
+  // 从 wire 里取出完整的帧（或握手消息）解码到 input()，返回 false 表示
+  // 协议错误。退回明文时 wire 里剩下的字节原样留给调用方
+  bool decode(Buffer &wire);
+  // 解码后的数据，交给消息回调
+  Buffer &input() { return input_; }
+
+  // 要原样写到 socket 的握手消息（客户端构造时生成 hello，服务端收到 hello
+  // 后生成 ack），必须先于任何帧写出
+  bool takeControl(std::string &out);
+  // 协商完成后取出之前缓存的 send 数据，调用方再走一遍 encode（或明文发送）
+  bool takePending(std::string &out);
+  bool hasPending() const { return !pending_.empty(); }
+
+  const CompressionStats &stats() const { return stats_; }
+
+private:
+  enum State { kNegotiating, kPlain, kCompressed };
+
+  bool decodeHandshake(Buffer &wire);
+  bool decodeFrame(Buffer &wire);
+  void appendFrame(FrameType type, const char *data, size_t len);
+  bool initStreams();
+
+  const CompressionOptions options_;
+  const bool isServer_;
+  State state_;
+  std::string control_;
+  std::string pending_;
+  std::string frame_;
+  Buffer input_;
+  // 协商出 kDeflate 之后才创建，明文连接不占 zlib 的内存
+  std::unique_ptr<z_stream> deflate_;
+  std::unique_ptr<z_stream> inflate_;
+  CompressionStats stats_;
+};
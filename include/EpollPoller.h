@@ -7,6 +7,10 @@
 
 class Channel;
 
+// 兴趣集的修改是批量提交的：updateChannel 只把 Channel 记为待提交，
+// 下一次 poll 在 epoll_wait 之前逐个对比内核里的兴趣集，合并一轮内的多次修改，
+// 没变的不 MOD，加入后又在同一轮移除的 ADD/DEL 互相抵消。
+// 因此 Channel 析构前必须 removeChannel（它会撤销待提交的修改）
 class Epoll : public Poller {
 public:
   Epoll();
@@ -18,7 +22,11 @@ public:
   void removeChannel(Channel *channel) override;
 
 private:
+  void applyUpdates();
+
   static constexpr int kMaxEvents_ = 1024;
   int epollfd_;
   std::vector<epoll_event> events_;
+  // 待提交的 Channel，被 removeChannel 撤销的位置置空
+  std::vector<Channel *> dirty_;
 };
\ No newline at end of file
@@ -1,14 +1,39 @@
 #pragma once
 
 #include "EpollPoller.h"
+#include "ObjectPool.h"
 #include "Poller.h"
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <time.h>
+#include <unordered_map>
 #include <vector>
 
 class Channel;
+class EventLoop;
+
+using TimerId = uint64_t;
+
+// co_await loop->sleep(d)：d 之后在 loop 线程里恢复协程
+class SleepAwaiter {
+public:
+  SleepAwaiter(EventLoop *loop, std::chrono::steady_clock::duration delay)
+      : loop_(loop), delay_(delay) {}
+  bool await_ready() const { return delay_.count() <= 0; }
+  void await_suspend(std::coroutine_handle<> handle);
+  void await_resume() const {}
+
+private:
+  EventLoop *loop_;
+  std::chrono::steady_clock::duration delay_;
+};
 
 class EventLoop {
 public:
@@ -21,17 +46,71 @@ public:
   Poller *getPoller() const;
   bool isInLoopThread() const;
   void queueInLoop(std::function<void()> func);
+  // 只能在 loop 线程调用：func 在下一轮 poll 之后、和新就绪的 Channel 一起处理，
+  // 有就绪任务时 poll 不阻塞。用于读预算用完的连接让出 loop
+  void queueReady(std::function<void()> func);
+  // 只能在 loop 线程调用：func 在本轮事件和任务都处理完、回到 poll 之前执行。
+  // 用于把一轮里攒下的写合并成一次系统调用
+  void queueBeforePoll(std::function<void()> func);
   void wakeup();
 
+  // 定时器，线程安全。回调在 loop 线程里执行，返回的 id 可用于取消
+  TimerId runAfter(std::chrono::steady_clock::duration delay,
+                   std::function<void()> func);
+  // 取消尚未触发的定时器，线程安全，已触发或不存在的 id 忽略
+  void cancelTimer(TimerId id);
+  SleepAwaiter sleep(std::chrono::steady_clock::duration delay) {
+    return SleepAwaiter(this, delay);
+  }
+
+  // 当前线程上的 EventLoop（同一线程有多个时为最先创建的那个），没有时为 nullptr
+  static EventLoop *current();
+
+  // 所在线程绑定的 CPU 和 NUMA 节点，未绑定时为 -1
+  void setPlacement(int cpu, int numaNode);
+  int cpu() const { return cpu_; }
+  int numaNode() const { return numaNode_; }
+
+  // 本 loop 上 TcpConnection 的内存池，连接关闭后内存留给下一个连接复用
+  const std::shared_ptr<FixedBlockPool> &connectionPool() const {
+    return connectionPool_;
+  }
+  // 本 loop 上协程帧的内存池，见 Task.h
+  FrameAllocator &frameAllocator() { return frameAllocator_; }
+
+  // 创建本 loop 的线程累计占用的 CPU 时间（纳秒），线程安全。
+  // 阻塞在 epoll_wait 里不占 CPU，TcpServer 的负载均衡用它比较各 loop 的负载
+  uint64_t cpuTimeNanos() const;
+
 private:
+  using TimePoint = std::chrono::steady_clock::time_point;
+
   void handleWakeup(); // for wakeup
   void doPendingFunctions();
+  void doBeforePollFunctions();
+  void addTimerInLoop(TimerId id, TimePoint when, std::function<void()> func);
+  void handleTimer();
+  void resetTimerFd();
 
   std::unique_ptr<Poller> poller_;
-  bool quit_;
+  std::atomic<bool> quit_;
   std::vector<std::function<void()>> pendingFuncs_;
+  std::vector<std::function<void()>> readyFuncs_; // 只在 loop 线程访问
+  std::vector<std::function<void()>> beforePollFuncs_; // 只在 loop 线程访问
   std::mutex mutex_;
   const std::thread::id threadId_;
   int wakeupFd_;
   std::unique_ptr<Channel> wakeupChannel_;
+  bool callingPendingFunctors_; // 只在 loop 线程读写
+  int cpu_;
+  int numaNode_;
+  std::shared_ptr<FixedBlockPool> connectionPool_;
+  FrameAllocator frameAllocator_;
+  // 定时器：按到期时间排序，取消时只删回调，到期时跳过已取消的
+  int timerFd_;
+  std::unique_ptr<Channel> timerChannel_;
+  std::multimap<TimePoint, TimerId> timerQueue_;
+  std::unordered_map<TimerId, std::function<void()>> timers_;
+  std::atomic<TimerId> nextTimerId_;
+  clockid_t cpuClock_;
 };
\ No newline at end of file
@@ -3,11 +3,14 @@
 #include "EventLoop.h"
 #include <condition_variable>
 #include <mutex>
+#include <string>
 #include <thread>
 
 class EventLoopThread {
 public:
-  EventLoopThread();
+  // cpu 为 -1 表示不绑核
+  explicit EventLoopThread(const std::string &name = std::string(),
+                           int cpu = -1);
   ~EventLoopThread();
 
   EventLoop *startLoop();
@@ -19,4 +22,6 @@ private:
   EventLoop *loop_;
   std::mutex mutex_;
   std::condition_variable cond_;
-};
\ No newline at end of file
+  const std::string name_;
+  const int cpu_;
+};
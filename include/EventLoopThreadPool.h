@@ -2,21 +2,37 @@
 
 #include "EventLoop.h"
 #include "EventLoopThread.h"
+#include "ThreadAffinity.h"
 #include <memory>
 #include <vector>
 
 class EventLoopThreadPool {
 public:
-  EventLoopThreadPool(EventLoop *baseLoop, int numThreads);
+  EventLoopThreadPool(EventLoop *baseLoop, int numThreads,
+                      const ThreadAffinity &affinity = ThreadAffinity());
   ~EventLoopThreadPool();
 
   void start();
   EventLoop *getNextLoop();
+  // 按收包 CPU（SO_INCOMING_CPU）选 loop：优先绑在 cpu 上的 loop，其次依次是
+  // 绑在它的 SMT 兄弟、同一 NUMA 节点、同一物理封装上的 loop，同一级有多个时
+  // 轮流分配。cpu 未知或找不到绑核的 loop 时退回 getNextLoop。
+  // 与 getNextLoop 一样只在主 loop 线程调用
+  EventLoop *getLoopForCpu(int cpu);
+  // 所有 I/O 线程的 loop，没有 I/O 线程时只有主 loop
+  std::vector<EventLoop *> getAllLoops() const;
 
 private:
+  int cpuForThread(int index) const;
+  void buildCpuMap();
+
   EventLoop *baseLoop_; // 主 EventLoop
   int numThreads_;
   int next_;
+  ThreadAffinity affinity_;
   std::vector<std::unique_ptr<EventLoopThread>> threads_;
   std::vector<EventLoop *> loops_;
-};
\ No newline at end of file
+  // 每个 CPU 的候选 loop 和下一个要用的下标，第一次 getLoopForCpu 时建好
+  std::vector<std::vector<EventLoop *>> cpuLoops_;
+  std::vector<size_t> cpuNext_;
+};
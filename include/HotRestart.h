@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// 旧进程交给新进程的一条连接：fd 以及尚未处理的输入/尚未发出的输出
+struct InheritedConnection {
+  int fd = -1;
+  std::string input;
+  std::string output;
+};
+
+// 旧进程交给新进程的全部状态
+struct InheritedState {
+  int listenFd = -1;
+  std::vector<InheritedConnection> connections;
+};
+
+// 热重启：通过 Unix 域套接字 + SCM_RIGHTS 在新旧进程之间传递 fd
+//
+// 协议（SOCK_STREAM）：每条消息为 9 字节头 {type, inputLen, outputLen}，
+// fd 作为辅助数据附在头上，随后是 inputLen + outputLen 字节的数据。
+//   'L'：监听 fd    'C'：一条连接    'E'：结束
+class HotRestart {
+public:
+  // 旧进程：在 path 上监听升级请求，返回非阻塞的监听 fd，失败返回 -1
+  static int listenForUpgrade(const std::string &path);
+  // 新进程：连接旧进程并接收状态，失败（例如旧进程不存在）返回 false。
+  // 交接中途失败时已收到的 fd 都已关闭
+  static bool takeOver(const std::string &path, InheritedState &state,
+                       int timeoutMs = 1000);
+
+  static bool sendState(int sock, const InheritedState &state);
+  // 失败时关闭已收到的 fd 并清空 state
+  static bool recvState(int sock, InheritedState &state);
+
+private:
+  static bool sendMessage(int sock, char type, int fd,
+                          const std::string &input, const std::string &output);
+};
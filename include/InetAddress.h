@@ -5,19 +5,38 @@
 #include <netinet/in.h>
 #include <string>
 #include <sys/socket.h>
+#include <sys/un.h>
 
+// 套接字地址，支持 IPv4 和 Unix 域（AF_UNIX）两种
 class InetAddress {
 public:
   explicit InetAddress(uint16_t port = 0, bool loopbackOnly = false);
   InetAddress(const std::string &ip, uint16_t port);
-  explicit InetAddress(const struct sockaddr_in &addr) : addr_(addr) {}
+  explicit InetAddress(const struct sockaddr_in &addr)
+      : addr_(addr), len_(sizeof(addr)) {}
   ~InetAddress();
 
+  // Unix 域地址，'@' 开头表示 Linux 抽象命名空间（不在文件系统中创建文件）
+  static InetAddress fromUnixPath(const std::string &path);
+
+  sa_family_t family() const { return addr_.sin_family; }
+  bool isUnix() const { return family() == AF_UNIX; }
+  // Unix 域地址返回路径（抽象命名空间以 '@' 开头）
   std::string getIp() const;
   uint16_t getPort() const;
+  std::string toString() const;
   const struct sockaddr *getAddr() const;
-  void setAddr(const struct sockaddr_in &addr) { addr_ = addr; }
+  socklen_t getAddrLen() const { return len_; }
+  void setAddr(const struct sockaddr_in &addr) {
+    addr_ = addr;
+    len_ = sizeof(addr);
+  }
+  void setAddr(const struct sockaddr *addr, socklen_t len);
 
 private:
-  struct sockaddr_in addr_;
+  union {
+    struct sockaddr_in addr_;
+    struct sockaddr_un unix_;
+  };
+  socklen_t len_;
 };
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// 定长内存块池：第一次分配确定块大小，释放的块缓存起来供下次复用。
+// 每个 EventLoop 一个，用于 TcpConnection（连同 shared_ptr 控制块）的内存。
+// 连接可能在别的线程析构，所以空闲链表加锁；锁基本无竞争。
+class FixedBlockPool {
+public:
+  explicit FixedBlockPool(size_t maxCached = 4096);
+  ~FixedBlockPool();
+
+  FixedBlockPool(const FixedBlockPool &) = delete;
+  FixedBlockPool &operator=(const FixedBlockPool &) = delete;
+
+  // size 与块大小不一致时直接走 ::operator new
+  void *allocate(size_t size);
+  void deallocate(void *p, size_t size);
+
+  size_t cachedBlocks();
+
+private:
+  std::mutex mutex_;
+  std::vector<void *> free_;
+  size_t blockSize_;
+  const size_t maxCached_;
+};
+
+// 给 std::allocate_shared 用的分配器，持有池的 shared_ptr，
+// 保证池活得比最后一个从它分配出去的对象久
+template <typename T> class PoolAllocator {
+public:
+  using value_type = T;
+
+  explicit PoolAllocator(std::shared_ptr<FixedBlockPool> pool)
+      : pool_(std::move(pool)) {}
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U> &other) : pool_(other.pool()) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(pool_->allocate(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t n) { pool_->deallocate(p, n * sizeof(T)); }
+
+  const std::shared_ptr<FixedBlockPool> &pool() const { return pool_; }
+
+  template <typename U> bool operator==(const PoolAllocator<U> &other) const {
+    return pool_ == other.pool();
+  }
+
+private:
+  std::shared_ptr<FixedBlockPool> pool_;
+};
+
+// 协程帧分配器：按 2 的幂分成几个尺寸档，每档一个 FixedBlockPool，
+// 超过最大档的帧直接走 ::operator new。块都来自 ::operator new，
+// 而且不论从哪里分配都按所在档的大小分配，所以帧在哪个线程、
+// 哪个 loop 释放都可以（没有 loop 的线程上创建、在 loop 上结束的帧
+// 会进那个 loop 的池）
+class FrameAllocator {
+public:
+  void *allocate(size_t size);
+  void deallocate(void *p, size_t size);
+
+  // 从当前线程的 EventLoop 分配，线程上没有 loop 时直接走 ::operator new
+  static void *allocateFrame(size_t size);
+  static void deallocateFrame(void *p, size_t size);
+
+private:
+  static constexpr size_t kMinBlock = 64;
+  static constexpr size_t kNumClasses = 7; // 64B ~ 4KB
+  static int classIndex(size_t size);
+  // 实际分配的大小：所在档的块大小，超过最大档时就是 size
+  static size_t blockSize(size_t size);
+
+  std::array<FixedBlockPool, kNumClasses> pools_;
+};
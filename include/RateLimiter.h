@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+// 令牌桶限速参数，速率为 0 表示该维度不限速
+struct RateLimit {
+  double bytesPerSec = 0;
+  double bytesBurst = 0; // 桶容量，0 表示等于 1 秒的量
+  // 应用层消息数，由消息回调（或协议解析层）调用
+  // TcpConnection::countMessages 报告，不报告的连接这一维不起作用
+  double messagesPerSec = 0;
+  double messagesBurst = 0;
+
+  bool enabled() const { return bytesPerSec > 0 || messagesPerSec > 0; }
+};
+
+// 令牌桶：不用定时器补充，每次访问时按距上次访问的时间惰性补充，
+// 空闲的桶没有任何开销。允许透支：先读后记账，令牌为负时需要等它补回来
+class TokenBucket {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  TokenBucket(double ratePerSec, double burst);
+
+  bool unlimited() const { return rate_ <= 0; }
+  void consume(double n, Clock::time_point now);
+  // 令牌回到正数还需要多久，已经为正时返回 0
+  Clock::duration deficitDelay(Clock::time_point now);
+
+private:
+  void refill(Clock::time_point now);
+
+  double rate_;
+  double burst_;
+  double tokens_;
+  Clock::time_point last_;
+};
+
+// 字节数和消息数两个令牌桶。一个连接一个，或者整个服务器所有连接共享一个，
+// 后者会被多个 I/O 线程同时访问，所以加锁
+class RateLimiter {
+public:
+  explicit RateLimiter(const RateLimit &limit);
+
+  // 记账，返回需要暂停读多久，0 表示可以继续读
+  TokenBucket::Clock::duration consume(size_t bytes, size_t messages);
+
+private:
+  std::mutex mutex_;
+  TokenBucket bytes_;
+  TokenBucket messages_;
+};
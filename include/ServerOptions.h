@@ -0,0 +1,51 @@
+#pragma once
+
+#include <sys/socket.h>
+
+// TcpServer 的监听 socket 调优参数，构造时传入。数值为 0 表示不设置（用系统默认）。
+// 除 quickAck 外的每连接选项都设在监听 socket 上，由 accept 得到的连接继承；
+// TCP_* 选项对 Unix 域监听地址不生效
+struct ServerOptions {
+  // I/O 线程数，之后仍可用 setThreadNum 修改
+  int numThreads = 4;
+  // listen 的全连接队列长度，实际还受 net.core.somaxconn 限制
+  int backlog = SOMAXCONN;
+
+  // bind 之前设置
+  bool reuseAddr = true;
+  // 多个进程/监听 socket 共享同一端口时打开，由内核在它们之间分配新连接
+  bool reusePort = false;
+  // SO_RCVBUF / SO_SNDBUF，listen 之前设置才会影响握手时通告的窗口扩大因子
+  int recvBufferSize = 0;
+  int sendBufferSize = 0;
+
+  // 连接继承的选项
+  bool tcpNoDelay = true;
+  bool keepAlive = true;
+  // TCP_USER_TIMEOUT：已发送的数据多久没有被确认就断开连接，毫秒
+  int userTimeoutMs = 0;
+  // TCP_NOTSENT_LOWAT：内核里未发送的数据低于该值才报告可写，减少发送缓冲区里的积压
+  int notSentLowat = 0;
+  // TCP_QUICKACK：不会被继承，也不是持久的（内核会自己切回延迟确认），
+  // 在每个新连接上设置一次，让第一个请求尽快被确认
+  bool quickAck = false;
+
+  // TCP_FASTOPEN 的队列长度（未完成 TFO 握手的请求数）。客户端在 SYN 里
+  // 带上请求数据，省掉一个往返；还需要 net.ipv4.tcp_fastopen 打开服务端位（2）
+  int fastOpenQueue = 0;
+  // TCP_DEFER_ACCEPT：等到客户端发来数据（最多这么多秒）才让连接可以被 accept，
+  // 避免 accept 之后第一次读拿到 EAGAIN 的空唤醒
+  int deferAcceptSeconds = 0;
+
+  // 新连接的分配，默认在 I/O loop 之间轮询。
+  // 按 SO_INCOMING_CPU 把连接交给绑在处理它收包的 CPU（或最近的兄弟 CPU）上
+  // 的 loop，收包的软中断和处理连接的 loop 在同一个核上，缓存不用来回搬。
+  // 需要 I/O 线程绑核（见 TcpServer::setThreadAffinity），否则仍是轮询
+  bool steerByIncomingCpu = false;
+  // 每个 I/O loop 各开一个 SO_REUSEPORT 监听 socket，在自己的线程里 accept，
+  // 连接留在本 loop 上（会自动打开 reusePort）。和 steerByIncomingCpu 一起
+  // 打开时给每个监听 socket 设置 SO_INCOMING_CPU 为所在 loop 的 CPU，由内核
+  // 直接把连接交给对应 CPU 的监听 socket。主监听 socket 保留在主 loop 上，
+  // 内核找不到匹配的监听 socket 时按哈希分给它，再由它按上面的规则分配
+  bool listenerPerLoop = false;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Buffer.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+class ShmTransport;
+using ShmTransportPtr = std::shared_ptr<ShmTransport>;
+// 与 MessageCallback 语义相同：收到的字节追加在 Buffer 里，由回调自己 retrieve
+using ShmMessageCallback =
+    std::function<void(const ShmTransportPtr &, Buffer &)>;
+using ShmCloseCallback = std::function<void(const ShmTransportPtr &)>;
+
+// 一端需要的 fd：共享内存（memfd）、自己等待的 eventfd、对端等待的 eventfd。
+// 跨进程使用时，把另一端的三个 fd 用 SCM_RIGHTS 发给对方即可。
+struct ShmEndpoint {
+  int memfd = -1;
+  int notifyFd = -1;     // 本端在 epoll 里等待的 eventfd
+  int peerNotifyFd = -1; // 写它来唤醒对端
+  int side = 0;          // 0 或 1，决定哪个环用于发送
+  size_t ringSize = 0;
+};
+
+// 同机进程/线程间的共享内存传输：一对单生产者单消费者字节环，
+// 读端在处理和自旋期间写端不发 eventfd，只有读端登记要回到 epoll 之后的
+// 第一次写入才通知（批量通知），读端可以先自旋再回到 epoll。
+class ShmTransport : public std::enable_shared_from_this<ShmTransport> {
+public:
+  // 创建一对端点，ringSize 向上取整到 2 的幂
+  static bool createPair(size_t ringSize, ShmEndpoint &a, ShmEndpoint &b);
+
+  // 接管 endpoint 里的 fd，析构时关闭
+  ShmTransport(EventLoop *loop, const ShmEndpoint &endpoint);
+  ~ShmTransport();
+
+  // 在 loop 线程里注册 eventfd 的 Channel
+  void start();
+  // 通知对端关闭并注销 Channel，需在 loop 线程调用
+  void close();
+
+  // 线程安全，不在 loop 线程时转发到 loop 线程
+  void send(const std::string &data);
+  void send(const char *data, size_t len);
+
+  // 读空环之后，回到 epoll 之前最多再自旋检查多少次，0 表示不自旋
+  void setSpinIterations(int n) { spinIterations_ = n; }
+  void setMessageCallback(const ShmMessageCallback &cb) {
+    messageCallback_ = cb;
+  }
+  void setCloseCallback(const ShmCloseCallback &cb) { closeCallback_ = cb; }
+
+  EventLoop *getLoop() const { return loop_; }
+  // 累计发出的 eventfd 通知次数，用来观察批量通知的效果
+  uint64_t notifications() const { return notifications_; }
+
+private:
+  struct RingHeader;
+
+  void sendInLoop(const char *data, size_t len);
+  size_t writeRing(const char *data, size_t len);
+  size_t readRing();
+  void handleRead();
+  void flushPending();
+  void notifyPeer();
+
+  EventLoop *loop_;
+  ShmEndpoint endpoint_;
+  void *mapping_;
+  size_t mappingSize_;
+  RingHeader *tx_;
+  char *txData_;
+  RingHeader *rx_;
+  char *rxData_;
+  size_t mask_;
+  std::unique_ptr<Channel> channel_;
+  Buffer inputBuffer_;
+  Buffer pending_; // 发送环满时暂存，等对端腾出空间后再写
+  int spinIterations_;
+  bool closed_;
+  uint64_t notifications_;
+  ShmMessageCallback messageCallback_;
+  ShmCloseCallback closeCallback_;
+};
@@ -9,7 +9,9 @@
 
 #include "InetAddress.h"
 
-int createNonblockingSocket();
+// family 为 AF_INET 时创建 TCP 套接字，AF_UNIX 时创建 Unix 域流式套接字；
+// type 为 SOCK_DGRAM 时创建 UDP（或 Unix 域数据报）套接字
+int createNonblockingSocket(int family = AF_INET, int type = SOCK_STREAM);
 
 class Socket {
 public:
@@ -17,16 +19,34 @@ public:
   Socket();
   ~Socket();
   int getFd() const;
+  // 失败时打印错误并退出进程
   void bind(const InetAddress &addr);
-  void listen();
+  void listen(int backlog = SOMAXCONN);
+  // 失败时打印错误并返回 false，由调用方决定如何处理
+  bool tryBind(const InetAddress &addr);
+  bool tryListen(int backlog = SOMAXCONN);
   int accept(InetAddress &addr);
   void setReuseAddr(bool on);
   void setReusePort(bool on);
   void setTcpNoDelay(bool on);
   void setKeepAlive(bool on);
+  // 以下选项设置失败时打印错误并返回 false
+  bool setRecvBufferSize(int bytes);
+  bool setSendBufferSize(int bytes);
+  bool setUserTimeout(int ms);
+  bool setNotSentLowat(int bytes);
+  bool setQuickAck(bool on);
+  // 监听 socket 专用，listen 之前设置
+  bool setFastOpen(int queueLen);
+  bool setDeferAccept(int seconds);
+  // SO_INCOMING_CPU：设在 SO_REUSEPORT 监听 socket 上时，内核优先把在该 CPU
+  // 上收到的连接交给它（Linux 6.2 起）
+  bool setIncomingCpu(int cpu);
 
-  static struct sockaddr_in getLocalAddr(int sockfd);
-  static struct sockaddr_in getPeerAddr(int sockfd);
+  static InetAddress getLocalAddr(int sockfd);
+  static InetAddress getPeerAddr(int sockfd);
+  // 最近处理这个连接收包的 CPU（SO_INCOMING_CPU），未知时返回 -1
+  static int getIncomingCpu(int sockfd);
 
 private:
   const int fd_;
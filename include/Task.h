@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Channel.h"
+#include "ObjectPool.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+// 协程任务。惰性启动：被 co_await 时才开始执行，结束后回到等待它的协程；
+// 顶层任务用 detach() 启动，结束时自己释放协程帧。
+// 协程帧从当前线程 EventLoop 的 FrameAllocator 分配，连接上的协程
+// 一般在连接回调里启动，帧就落在连接所属 loop 的内存池里。
+//
+//   Task<> serve(TcpConnectionPtr conn) {
+//     std::string line = co_await conn->readUntil("\r\n");
+//     co_await conn->write(line);
+//   }
+//   serve(conn).detach();
+template <typename T = void> class Task;
+
+class TaskPromiseBase {
+public:
+  // 结束时：有等待者就直接切回等待者，detach 的任务释放自己
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename P>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<P> handle) noexcept {
+      TaskPromiseBase &promise = handle.promise();
+      if (promise.continuation_) {
+        return promise.continuation_;
+      }
+      if (promise.detached_) {
+        handle.destroy();
+      }
+      return std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+
+  void unhandled_exception() {
+    if (detached_) {
+      // 没有人能接住这个异常
+      logError("unhandled exception in detached coroutine", "Task");
+      return;
+    }
+    exception_ = std::current_exception();
+  }
+
+  static void *operator new(size_t size) {
+    return FrameAllocator::allocateFrame(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    FrameAllocator::deallocateFrame(p, size);
+  }
+
+  void setContinuation(std::coroutine_handle<> h) { continuation_ = h; }
+  void setDetached() { detached_ = true; }
+  void rethrowIfFailed() {
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+  }
+
+private:
+  std::coroutine_handle<> continuation_;
+  std::exception_ptr exception_;
+  bool detached_ = false;
+};
+
+template <typename T> class TaskPromise : public TaskPromiseBase {
+public:
+  Task<T> get_return_object();
+  template <typename U> void return_value(U &&value) {
+    value_.emplace(std::forward<U>(value));
+  }
+  T take() {
+    rethrowIfFailed();
+    return std::move(*value_);
+  }
+
+private:
+  std::optional<T> value_;
+};
+
+template <> class TaskPromise<void> : public TaskPromiseBase {
+public:
+  Task<void> get_return_object();
+  void return_void() {}
+  void take() { rethrowIfFailed(); }
+};
+
+template <typename T> class [[nodiscard]] Task {
+public:
+  using promise_type = TaskPromise<T>;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  explicit Task(Handle handle) : handle_(handle) {}
+  Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  // 作为顶层任务启动：立即在当前线程执行到第一个挂起点，之后由事件恢复，
+  // 结束时协程帧自己释放
+  void detach() {
+    Handle handle = std::exchange(handle_, {});
+    handle.promise().setDetached();
+    handle.resume();
+  }
+
+  // co_await task：启动子任务，子任务结束后对称转移回来，不经过 loop
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+    handle_.promise().setContinuation(awaiting);
+    return handle_;
+  }
+  T await_resume() { return handle_.promise().take(); }
+
+private:
+  Handle handle_;
+};
+
+template <typename T> Task<T> TaskPromise<T>::get_return_object() {
+  return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+  return Task<void>(
+      std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Callbacks.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "TcpConnection.h"
+#include "TlsContext.h"
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+// 客户端：非阻塞 connect 到 TCP 或 Unix 域地址，连上后交给 TcpConnection，
+// 回调接口与 TcpServer 一致。不自动重连。
+class TcpClient {
+public:
+  TcpClient(EventLoop *loop, const InetAddress &serverAddr,
+            const std::string &name);
+  ~TcpClient();
+
+  void connect();
+  void disconnect();
+  // 连上后先做 TLS 握手，serverName 用于 SNI 和证书主机名校验，需在 connect() 之前调用
+  void enableTls(const std::shared_ptr<TlsContext> &ctx,
+                 const std::string &serverName = std::string()) {
+    tlsContext_ = ctx;
+    tlsServerName_ = serverName;
+  }
+
+  // 连上后发起压缩协商（见 Compression.h），服务端没有开启时退回明文，
+  // 需在 connect() 之前调用
+  void enableCompression(const CompressionOptions &options = {}) {
+    compression_ = options;
+  }
+
+  EventLoop *getLoop() const { return loop_; }
+  TcpConnectionPtr connection();
+
+  void setConnectionCallback(const TcpConnectionCallback &cb) {
+    connectionCallback_ = cb;
+  }
+  void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+  void setWriteCompleteCallback(const WriteCompleteCallback &cb) {
+    writeCompleteCallback_ = cb;
+  }
+
+private:
+  void connectInLoop();
+  void handleConnected();
+  void removeConnection(const TcpConnectionPtr &conn);
+
+  EventLoop *loop_;
+  const InetAddress serverAddr_;
+  const std::string name_;
+  int connectingFd_;
+  std::unique_ptr<Channel> connectChannel_;
+  TcpConnectionCallback connectionCallback_;
+  MessageCallback messageCallback_;
+  WriteCompleteCallback writeCompleteCallback_;
+  std::mutex mutex_;
+  TcpConnectionPtr connection_;
+  std::shared_ptr<TlsContext> tlsContext_;
+  std::string tlsServerName_;
+  std::optional<CompressionOptions> compression_;
+};
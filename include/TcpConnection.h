@@ -3,11 +3,70 @@
 #include "Buffer.h"
 #include "Callbacks.h"
 #include "Channel.h"
+#include "Compression.h"
 #include "EventLoop.h"
+#include "HotRestart.h"
 #include "InetAddress.h"
+#include "RateLimiter.h"
 #include "Socket.h"
+#include "TlsContext.h"
+#include "TrafficCapture.h"
+#include <atomic>
+#include <coroutine>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class TcpConnection;
+
+// co_await conn->read(n) / conn->readUntil(delim)：缓冲区里的数据满足条件后
+// 在连接所属 loop 上恢复，返回取出的数据。连接关闭时返回剩下的全部数据
+// （可能不足 n 字节、不含分隔符，也可能为空）
+class ReadAwaiter {
+public:
+  ReadAwaiter(TcpConnection *conn, size_t n) : conn_(conn), n_(n) {}
+  ReadAwaiter(TcpConnection *conn, std::string_view delim)
+      : conn_(conn), n_(0), delim_(delim) {}
+  bool await_ready();
+  void await_suspend(std::coroutine_handle<> handle);
+  std::string await_resume();
+
+private:
+  friend class TcpConnection;
+  // 只在 loop 线程调用：条件满足时把要取出的字节数写到 len
+  bool satisfied(size_t &len);
+
+  TcpConnection *conn_;
+  size_t n_;
+  std::string delim_;
+  size_t scanned_ = 0; // readUntil 已经找过的字节数，新数据到来时接着找
+  size_t len_ = 0;
+  std::coroutine_handle<> handle_;
+};
+
+// co_await conn->write(data)：数据全部交给内核后恢复，连接已断开时返回 false。
+// data 只需在 co_await 表达式期间有效
+class WriteAwaiter {
+public:
+  WriteAwaiter(TcpConnection *conn, std::string_view data)
+      : conn_(conn), data_(data) {}
+  bool await_ready() const { return false; }
+  bool await_suspend(std::coroutine_handle<> handle);
+  bool await_resume() const { return ok_; }
+
+private:
+  friend class TcpConnection;
+  // 只在 loop 线程调用：返回 true 表示还要等输出缓冲区写完
+  bool startInLoop();
+
+  TcpConnection *conn_;
+  std::string_view data_;
+  bool ok_ = false;
+  std::coroutine_handle<> handle_;
+};
 
 class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 public:
@@ -15,14 +74,94 @@ public:
                 const InetAddress &localAddr, const InetAddress &peerAddr);
   ~TcpConnection();
 
-  EventLoop *getLoop() const { return loop_; }
+  // 连接迁移后会变成新的 loop
+  EventLoop *getLoop() const { return loop_.load(std::memory_order_acquire); }
   const std::string &name() const { return name_; }
+  int fd() const { return socket_.getFd(); }
   const InetAddress &localAddress() const { return localAddr_; }
   const InetAddress &peerAddress() const { return peerAddr_; }
   bool connected() const { return state_ == kConnected; }
 
   void send(const std::string &buf);
+  // 发送共享消息：在其他线程调用时只增加引用计数，不拷贝内容
+  void send(const SharedPayload &payload);
   void shutdown();
+  // 不等输出缓冲区写完，丢弃未发送的数据立即关闭（例如踢掉跟不上的慢消费者）
+  void forceClose();
+
+  // 协程接口，见 Task.h。用协程读的连接不要再设置 messageCallback，
+  // 同一时刻最多一个协程在等读、一个在等写；协程需自己持有 TcpConnectionPtr
+  ReadAwaiter read(size_t n) { return ReadAwaiter(this, n); }
+  ReadAwaiter readUntil(std::string_view delim) {
+    return ReadAwaiter(this, delim);
+  }
+  WriteAwaiter write(std::string_view data) {
+    return WriteAwaiter(this, data);
+  }
+  void setTcpNoDelay(bool on) { socket_.setTcpNoDelay(on); }
+  void setQuickAck(bool on) { socket_.setQuickAck(on); }
+
+  // 在这个连接上做 TLS，需在 connectEstablished 之前调用。握手在 I/O 线程里
+  // 非阻塞进行，完成后才回调 connectionCallback，之后 send/消息回调都是明文
+  void startTls(const std::shared_ptr<TlsContext> &ctx, bool isServer,
+                const std::string &serverName = std::string());
+  bool isTls() const { return tls_ != nullptr; }
+  // 可查询协商的套件和 kTLS 状态，明文连接返回 nullptr
+  const TlsSession *tlsSession() const { return tls_.get(); }
+
+  // 读端流控：暂停/恢复对 EPOLLIN 的关注，数据留在内核里由 TCP 窗口反压对端
+  void stopRead();
+  void startRead();
+  bool isReading() const { return reading_; }
+  // 输入缓冲区超过 high 时自动暂停读，降到 low 以下时自动恢复，high 为 0 表示关闭
+  void setInputWaterMarks(size_t high, size_t low) {
+    inputHighWaterMark_ = high;
+    inputLowWaterMark_ = low;
+  }
+  // 在 messageCallback 之外消费输入时使用，消费后会检查是否需要恢复读
+  void retrieveInput(size_t len);
+
+  // 每次读事件最多读 maxBytes 字节 / maxReads 次（0 表示不限制），
+  // 用完后连接排到 loop 的就绪队列，下一轮再继续读，避免大流量连接独占 loop
+  void setReadBudget(size_t maxBytes, int maxReads) {
+    readBudgetBytes_ = maxBytes;
+    readBudgetReads_ = maxReads;
+  }
+  // 令牌桶限速：limit 为本连接自己的限额，shared 为多个连接共享的限额（可为空）。
+  // 令牌透支后暂停 EPOLLIN，补回来之后再恢复，数据留在内核里由 TCP 窗口反压对端。
+  // 字节数在读的时候自动记账，消息数由 countMessages 报告。需在 loop 线程或
+  // connectEstablished 之前调用
+  void setRateLimit(const RateLimit &limit,
+                    const std::shared_ptr<RateLimiter> &shared = nullptr);
+  // 报告刚解析出的 n 条应用层消息，记入 RateLimit::messagesPerSec 的令牌桶，
+  // 透支时暂停读。一般在消息回调里调用，需在 loop 线程调用
+  void countMessages(size_t n);
+  // 写合并：send 只追加到输出缓冲区，本轮 loop 回到 epoll_wait 之前一次写出，
+  // 一个请求里的多次 send 合成一次系统调用、尽量一个报文段，又不像 Nagle
+  // 那样等 ACK。攒够 flushThreshold 字节时提前写出。需在 loop 线程或
+  // connectEstablished 之前调用
+  void setCorked(bool on, size_t flushThreshold = kDefaultCorkThreshold) {
+    corked_ = on;
+    corkThreshold_ = flushThreshold;
+  }
+  // 压缩层，见 Compression.h，需在 connectEstablished 之前调用。客户端在
+  // 连接可用时发起协商，服务端根据对端的第一批字节决定是否压缩。
+  // 消息回调和协程读拿到的都是解码后的数据，输入水位按压缩后的字节计算
+  void enableCompression(const CompressionOptions &options, bool isServer) {
+    codec_ = std::make_unique<CompressionCodec>(options, isServer);
+  }
+  bool isCompressed() const { return codec_ && codec_->compressing(); }
+  // 没有启用压缩时返回 nullptr，需在 loop 线程调用
+  const CompressionStats *compressionStats() const {
+    return codec_ ? &codec_->stats() : nullptr;
+  }
+  // 把这个连接收到的字节流录进 capture（见 TrafficCapture.h），
+  // 需在 connectEstablished 之前调用
+  void setCapture(const std::shared_ptr<TrafficCapture> &capture) {
+    capture_ = capture;
+  }
+  Buffer *inputBuffer() { return &inputBuffer_; }
+  Buffer *outputBuffer() { return &outputBuffer_; }
 
   void setConnectionCallback(const TcpConnectionCallback &cb) {
     connectionCallback_ = cb;
@@ -32,11 +171,39 @@ public:
     writeCompleteCallback_ = cb;
   }
   void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
+  // 输出缓冲区超过 highWaterMark 时回调，代理场景里可以借此 stopRead() 上游，
+  // 再在 writeCompleteCallback 里 startRead()
+  void setHighWaterMarkCallback(const HighWaterMarkCallback &cb,
+                                size_t highWaterMark) {
+    highWaterMarkCallback_ = cb;
+    highWaterMark_ = highWaterMark;
+  }
 
   void connectEstablished();
   void connectDestroyed();
 
+  // 把连接迁移到另一个 loop 上继续收发，线程安全。迁移开始之前投递给
+  // 连接的任务在原 loop 上执行完，迁移期间其他线程的 send 等调用按顺序
+  // 积压下来，在新 loop 上接管之后再依次执行，字节流不乱序、不丢失。
+  // detached 在原 loop 线程、连接摘下之后回调，attached 在新 loop 线程、
+  // 重新注册之后回调。连接已关闭、正在迁移或有协程在等待时放弃迁移，
+  // 不回调
+  using MigrateCallback = std::function<void(const TcpConnectionPtr &)>;
+  void migrateTo(EventLoop *newLoop, MigrateCallback detached = nullptr,
+                 MigrateCallback attached = nullptr);
+  bool migrating() const { return migrating_.load(std::memory_order_acquire); }
+  // 上次调用以来读写的字节数，负载均衡用来挑选迁移的连接，需在 loop 线程调用
+  uint64_t takeActivity() { return std::exchange(activity_, 0); }
+
+  // 热重启：从 epoll 摘下连接并交出 dup 后的 fd 和缓冲区内容，需在 I/O 线程调用
+  bool detachForHandoff(InheritedConnection &out);
+  // 热重启：新进程接管连接时恢复旧进程留下的缓冲区，需在 connectEstablished 之前调用
+  void restoreBuffers(const std::string &input, const std::string &output);
+
 private:
+  friend class ReadAwaiter;
+  friend class WriteAwaiter;
+
   enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
   void setState(StateE s) { state_ = s; }
 
@@ -44,21 +211,100 @@ private:
   void handleWrite();
   void handleClose();
   void handleError();
+  void handleHandshake();
+  void deliverInput(const TcpConnectionPtr &guardThis);
+  void resumeWaiters();
+  ssize_t readInput();
+  ssize_t writeOutput(const char *data, size_t len);
 
   void sendInLoop(const std::string &buf);
+  void sendInLoop(const char *data, size_t len);
+  // 把已经编码好的字节写出（或放进输出缓冲区），不检查连接状态
+  void writeInLoop(const char *data, size_t len);
+  void startCompression();
+  bool decodeInput();
+  void sendNegotiated();
+  void negotiationTimedOut();
+  // 交给用户的输入：压缩连接是解码后的数据
+  Buffer &userInput() {
+    return codec_ && codec_->active() ? codec_->input() : inputBuffer_;
+  }
   void shutdownInLoop();
+  void stopReadInLoop();
+  void startReadInLoop();
+  void checkInputWaterMarks();
+  void scheduleRead();
+  bool throttleRead(size_t bytes, size_t messages);
+  void resumeAfterThrottle();
+  void reclaimBuffer(Buffer &buf);
+  bool drainOutput();
+  bool checkWriteError(const char *where);
+  void outputDrained();
+  void flushCorked();
+  // 当前线程是否就是连接所属的 loop 线程，迁移途中对所有线程都为 false
+  bool inOwnerLoop() const {
+    return !migrating() && getLoop()->isInLoopThread();
+  }
+  // 把任务交给连接所属的 loop，迁移途中先积压，接管之后按顺序执行
+  void queueInOwnerLoop(std::function<void()> task);
+  void startMigration(EventLoop *newLoop, const MigrateCallback &detached,
+                      const MigrateCallback &attached);
+  void detachForMigration(EventLoop *newLoop, const MigrateCallback &detached,
+                          const MigrateCallback &attached);
+  void attachAfterMigration(const MigrateCallback &attached, bool readPending);
+  void finishMigration();
+
+  // 超过这个容量、且大部分空着的缓冲区会被收缩
+  static constexpr size_t kShrinkThreshold = 64 * 1024;
+  // TLS 连接每次读最多解密这么多字节再交给消息回调
+  static constexpr size_t kTlsReadChunk = 64 * 1024;
+  // 写合并模式下攒到这么多字节就不等本轮结束，直接写出
+  static constexpr size_t kDefaultCorkThreshold = 64 * 1024;
 
-  EventLoop *loop_;
+  std::atomic<EventLoop *> loop_;
   const std::string name_;
   StateE state_;
-  std::unique_ptr<Socket> socket_;
-  std::unique_ptr<Channel> channel_;
+  // 直接内嵌，连接从 loop 的内存池里一次分配完成
+  Socket socket_;
+  Channel channel_;
   const InetAddress localAddr_;
   const InetAddress peerAddr_;
   TcpConnectionCallback connectionCallback_;
   MessageCallback messageCallback_;
   WriteCompleteCallback writeCompleteCallback_;
   CloseCallback closeCallback_;
+  HighWaterMarkCallback highWaterMarkCallback_;
   Buffer inputBuffer_;
   Buffer outputBuffer_;
+  size_t highWaterMark_;
+  bool reading_;
+  // 是否因为输入高水位被自动暂停（与用户手动 stopRead 区分）
+  bool readPausedByWaterMark_;
+  size_t inputHighWaterMark_;
+  size_t inputLowWaterMark_;
+  size_t readBudgetBytes_;
+  int readBudgetReads_;
+  bool readScheduled_; // 已经在 loop 的就绪队列里
+  bool closed_;        // 已经走过 handleClose
+  bool writeFailed_;   // 写出错，连接正在关闭，不再写
+  std::unique_ptr<TlsSession> tls_;
+  std::unique_ptr<RateLimiter> rateLimiter_;
+  std::shared_ptr<RateLimiter> sharedRateLimiter_;
+  bool readPausedByRateLimit_;
+  TimerId rateLimitTimer_; // 0 表示没有等待中的恢复定时器
+  bool corked_;
+  size_t corkThreshold_;
+  bool flushScheduled_; // 已经在 loop 的 beforePoll 队列里
+  std::shared_ptr<TrafficCapture> capture_;
+  uint64_t captureId_; // 0 表示还没有录制打开记录
+  std::unique_ptr<CompressionCodec> codec_;
+  // 正在等待的协程，只在 loop 线程访问
+  ReadAwaiter *readWaiter_;
+  WriteAwaiter *writeWaiter_;
+  // 迁移：migrating_ 置位期间投递给连接的任务进 migrationBacklog_，
+  // 两者都在 migrationMutex_ 下修改
+  std::atomic<bool> migrating_;
+  std::mutex migrationMutex_;
+  std::vector<std::function<void()>> migrationBacklog_;
+  uint64_t activity_; // 只在 loop 线程访问
 };
\ No newline at end of file
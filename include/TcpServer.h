@@ -4,24 +4,90 @@
 #include "EventLoop.h"
 #include "EventLoopThread.h"
 #include "EventLoopThreadPool.h"
+#include "HotRestart.h"
 #include "InetAddress.h"
+#include "ServerOptions.h"
 #include "Socket.h"
 #include "TcpConnection.h"
+#include "TlsContext.h"
+#include <atomic>
+#include <chrono>
 #include <map>
 #include <memory>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 class TcpConnection;
 
+// I/O loop 之间的自动负载均衡：每个周期比较各 loop 线程占用 CPU 的比例（见
+// EventLoop::cpuTimeNanos），最忙和最闲的相差超过 minImbalance 时，
+// 从最忙的 loop 上挑读写量最接近差值一半的连接迁移到最闲的 loop
+struct RebalanceOptions {
+  std::chrono::milliseconds period{1000};
+  // CPU 占用比例之差，0.25 表示相差一个周期的 25%
+  double minImbalance = 0.25;
+  // 每个周期最多迁移的连接数
+  int maxMigrationsPerPeriod = 1;
+};
+
 class TcpServer {
 public:
-  TcpServer(const std::string &ip, const uint16_t port);
+  // upgradePath 非空时，先尝试从该路径上的旧进程接管监听 socket 和连接
+  TcpServer(const std::string &ip, const uint16_t port,
+            const std::string &upgradePath = std::string());
+  // listenAddr 可以是 TCP 地址，也可以是 InetAddress::fromUnixPath 得到的 Unix 域地址
+  explicit TcpServer(const InetAddress &listenAddr,
+                     const std::string &upgradePath = std::string());
+  // options 决定线程数和监听 socket 的调优参数，见 ServerOptions.h；
+  // 热重启接管来的监听 socket 沿用旧进程的设置
+  TcpServer(const InetAddress &listenAddr, const ServerOptions &options,
+            const std::string &upgradePath = std::string());
   ~TcpServer();
 
   void start();
   void stop();
+  // 构造时没能监听（例如热重启交接失败、旧进程仍占着端口）时返回 false，
+  // 此时 start() 打印错误后直接返回
+  bool listening() const { return listensock_ != nullptr; }
 
   void setThreadNum(int numThreads);
+  // 同时在另一个地址上监听（例如 TCP 服务再开一个 Unix 域套接字），start() 之前调用，
+  // 使用与主监听 socket 相同的 ServerOptions
+  void addListener(const InetAddress &addr);
+  // 设置 EventLoop 线程的绑核/命名策略，需在 start() 之前调用
+  void setThreadAffinity(const ThreadAffinity &affinity);
+
+  // 广播：消息只包装一次成不可变的共享缓冲区，每个 I/O loop 只投递一个任务
+  // （一次唤醒），由它写给本 loop 上的目标连接。线程安全，start() 之后调用
+  void broadcast(const SharedPayload &payload);
+  void broadcast(std::string message) {
+    broadcast(std::make_shared<const std::string>(std::move(message)));
+  }
+  // 只发给 group 里的连接，按所属 loop 分组后同样每个 loop 一个任务
+  void broadcast(const std::vector<TcpConnectionPtr> &group,
+                 const SharedPayload &payload);
+  void broadcast(const std::vector<TcpConnectionPtr> &group,
+                 std::string message) {
+    broadcast(group, std::make_shared<const std::string>(std::move(message)));
+  }
+
+  // 把连接迁移到本服务器的另一个 I/O loop 上，见 TcpConnection::migrateTo。
+  // 线程安全，start() 之后调用。迁移途中的连接不在任何 loop 的连接表里，
+  // 这段时间里发起的全量 broadcast 会漏掉它
+  void migrateConnection(const TcpConnectionPtr &conn, EventLoop *target);
+  // 打开自动负载均衡，需在 start() 之前调用
+  void enableRebalancer(const RebalanceOptions &options = RebalanceOptions());
+  // 所有 I/O loop，start() 之后有效
+  std::vector<EventLoop *> ioLoops() const {
+    return threadPool_->getAllLoops();
+  }
+  // 已完成的迁移次数
+  uint64_t migrations() const {
+    return migrations_.load(std::memory_order_relaxed);
+  }
 
   // 获取连接
   std::shared_ptr<TcpConnection> getConnection(const std::string &name) {
@@ -38,19 +104,106 @@ public:
   }
   void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
 
+  // 新连接默认的每次读事件预算，见 TcpConnection::setReadBudget
+  void setReadBudget(size_t maxBytes, int maxReads) {
+    readBudgetBytes_ = maxBytes;
+    readBudgetReads_ = maxReads;
+  }
+
+  // 限速，需在 start() 之前调用。perConnection 每个连接各自一份令牌桶，
+  // total 是所有连接（跨 I/O 线程）共享的一份，两者同时生效
+  void setRateLimit(const RateLimit &perConnection,
+                    const RateLimit &total = {});
+
+  // 录制之后接受的连接收到的数据，见 TrafficCapture.h，需在 start() 之前调用
+  void setCapture(const std::shared_ptr<TrafficCapture> &capture) {
+    capture_ = capture;
+  }
+
+  // 之后接受的连接接受客户端发起的压缩协商（见 Compression.h），
+  // 不发起协商的客户端仍按明文处理，需在 start() 之前调用
+  void setCompression(const CompressionOptions &options) {
+    compression_ = options;
+  }
+
+  // 之后接受的连接都做 TLS（服务端），需在 start() 之前调用
+  void setTlsContext(const std::shared_ptr<TlsContext> &ctx) {
+    tlsContext_ = ctx;
+  }
+
+  // 热重启：在 path 上等待新进程，新进程连上后交出监听 fd，
+  // passConnections 为 true 时连同所有连接一起交出，之后排空并退出 loop。
+  // addListener 的监听 socket 和各 loop 自己的监听 socket 不交接，
+  // 收到升级请求时取完排队的连接就关闭；交接失败时全部恢复
+  void enableHotRestart(const std::string &path, bool passConnections = true);
+
   // 处理新连接
 private:
-  void handleNewConnection();
+  struct Listener {
+    std::unique_ptr<Socket> sock;
+    std::unique_ptr<Channel> channel;
+    EventLoop *loop = nullptr; // 每个 I/O loop 自己的监听 socket 所在的 loop
+    InetAddress addr;          // addListener 的监听地址
+  };
+
+  // 一次热重启交接中收集的状态
+  struct Handoff {
+    int peer = -1;
+    std::vector<std::shared_ptr<TcpConnection>> conns;
+    std::mutex mutex;
+    size_t pending = 0;
+    InheritedState state;
+  };
+
+  // 一次 accept 排空中取到、还没交给 I/O loop 的连接
+  struct AcceptedFd {
+    int fd;
+    InetAddress peerAddr;
+  };
+
+  // 每次监听 socket 可读时最多 accept 的连接数，剩下的（水平触发）下一轮再取
+  static constexpr int kMaxAcceptsPerEvent = 256;
+
+  static std::unique_ptr<Socket>
+  createListenSocket(const InetAddress &addr, const ServerOptions &options);
+  // owner 非空时是 owner 自己的监听 socket，连接都留在 owner 上
+  void handleNewConnection(Socket &listener, EventLoop *owner = nullptr);
+  // ServerOptions::listenerPerLoop：给每个 I/O loop 建监听 socket
+  void startLoopListeners();
+  // 把发往 ioLoop 的一批新连接作为一个任务投递过去，在那里构造并建立
+  void establishBatch(EventLoop *ioLoop, std::vector<AcceptedFd> batch);
+  // 在 ioLoop 上创建连接并设置回调，还没有登记到 connections_。
+  // inherited 为 true 表示摘下后重新接管的连接（热重启交来的或交接失败
+  // 收回的），字节流已经在中途，不做 TLS 握手也不协商压缩
+  std::shared_ptr<TcpConnection> newConnection(EventLoop *ioLoop, int connfd,
+                                               const InetAddress &peerAddr,
+                                               bool inherited = false);
+  // 为摘下的连接（旧进程交来的，或交接失败后收回的）建立新的 TcpConnection
+  void adoptConnection(const InheritedConnection &ic);
+  void handleUpgradeRequest();
+  void finishUpgrade(const std::shared_ptr<Handoff> &handoff);
+  void resumeAfterFailedUpgrade(const std::shared_ptr<Handoff> &handoff);
   void handleWrite();
   void removeConnection(const std::shared_ptr<TcpConnection> &conn);
+  void establishConnection(const std::shared_ptr<TcpConnection> &conn);
+  // 负载均衡：在主 loop 上定期比较各 loop 线程的 CPU 时间
+  void rebalance();
+  // 在 heavy 的线程上按各连接本周期的读写量挑选要迁移的连接
+  void migrateFrom(EventLoop *heavy, EventLoop *light, double heavyBusy,
+                   double lightBusy);
 
 private:
   std::unique_ptr<EventLoop> eventLoop_;
   std::unique_ptr<EventLoopThreadPool> threadPool_;
+  ServerOptions options_;
+  int numThreads_;
+  ThreadAffinity affinity_;
   const std::string ip_;
   const uint16_t port_;
   std::unique_ptr<Socket> listensock_;
   std::unique_ptr<Channel> listen_channel_;
+  std::vector<Listener> extraListeners_;
+  std::vector<Listener> loopListeners_;
   TcpConnectionCallback connectionCallback_;
   MessageCallback messageCallback_;
   WriteCompleteCallback writeCompleteCallback_;
@@ -58,4 +211,26 @@ private:
   std::map<std::string, std::shared_ptr<TcpConnection>> connections_;
   InetAddress server_addr_;
   std::mutex connections_mutex_;
+  int upgradeFd_;
+  std::unique_ptr<Channel> upgradeChannel_;
+  bool passConnections_;
+  bool draining_;
+  std::vector<InheritedConnection> inherited_;
+  size_t readBudgetBytes_;
+  int readBudgetReads_;
+  std::shared_ptr<TlsContext> tlsContext_;
+  RateLimit connectionRateLimit_;
+  std::shared_ptr<RateLimiter> totalRateLimiter_;
+  std::shared_ptr<TrafficCapture> capture_;
+  std::optional<CompressionOptions> compression_;
+  // 每个 I/O loop 上已建立的连接，start() 时建好各 loop 的表项，之后 map
+  // 本身不再变化；每个集合只在对应 loop 线程里访问，广播时不用加锁
+  std::unordered_map<EventLoop *, std::unordered_set<TcpConnection *>>
+      loopConnections_;
+  bool rebalancing_;
+  RebalanceOptions rebalanceOptions_;
+  // 上一次均衡时各 loop 线程的累计 CPU 时间，只在主 loop 线程访问
+  std::unordered_map<EventLoop *, uint64_t> lastCpuNanos_;
+  std::chrono::steady_clock::time_point lastRebalance_;
+  std::atomic<uint64_t> migrations_;
 };
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// EventLoop 线程的放置策略：绑核、命名、NUMA 本地内存
+struct ThreadAffinity {
+  // I/O 线程依次绑定到这些 CPU（第 i 个线程用 ioCpus[i % size]）
+  std::vector<int> ioCpus;
+  // 主 EventLoop（accept 线程）绑定的 CPU，-1 表示不绑核
+  int baseCpu = -1;
+  // ioCpus 为空时，是否自动把 I/O 线程轮流绑到进程允许的 CPU 上（跳过 baseCpu）
+  bool autoPin = false;
+  // 线程名前缀，最终名字为 "<prefix><index>"，供 top -H / perf 区分
+  std::string namePrefix = "io-loop";
+};
+
+// 把当前线程绑定到指定 CPU，成功返回 true
+bool pinCurrentThread(int cpu);
+// 设置当前线程名字（内核限制 15 个字符，超出部分截断）
+void setCurrentThreadName(const std::string &name);
+// 让当前线程之后分配的内存优先落在 cpu 所在的 NUMA 节点，返回节点号，失败返回 -1
+int bindMemoryToCpuNode(int cpu);
+// 返回调用线程允许运行的 CPU 列表（调用线程已经绑核时只有那一个）
+std::vector<int> allowedCpus();
+// 系统配置的 CPU 个数（含离线的），CPU 编号小于它
+int configuredCpuCount();
+// 与 cpu 共享同一物理核的逻辑 CPU（SMT 兄弟，含 cpu 自己），读取失败时只含 cpu
+std::vector<int> cpuThreadSiblings(int cpu);
+// cpu 所在的 NUMA 节点和物理封装，未知时返回 -1
+int cpuNumaNode(int cpu);
+int cpuPackage(int cpu);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Buffer.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// 不在头文件里引入 OpenSSL
+struct ssl_st;
+struct ssl_ctx_st;
+
+// OpenSSL SSL_CTX 的封装，同一个上下文可以被多个连接、多个 I/O 线程共享
+class TlsContext {
+public:
+  // 从 PEM 文件加载证书链和私钥，失败返回 nullptr
+  static std::shared_ptr<TlsContext> newServer(const std::string &certFile,
+                                               const std::string &keyFile);
+  // 现场生成 P-256 自签名证书，用于测试和基准测试
+  static std::shared_ptr<TlsContext>
+  newSelfSignedServer(const std::string &commonName = "localhost");
+  // 客户端上下文，用系统默认 CA 校验服务端证书；连接时给出 serverName
+  // 才会同时校验主机名
+  static std::shared_ptr<TlsContext> newClient();
+  // 不校验服务端证书的客户端上下文，只用于测试和基准测试（例如连接
+  // newSelfSignedServer 的服务端）
+  static std::shared_ptr<TlsContext> newClientInsecure();
+
+  explicit TlsContext(ssl_ctx_st *ctx);
+  ~TlsContext();
+  TlsContext(const TlsContext &) = delete;
+  TlsContext &operator=(const TlsContext &) = delete;
+
+  // 校验对端证书，caFile 为空时使用系统默认 CA
+  bool setVerifyPeer(bool on, const std::string &caFile = std::string());
+  // 握手后尝试把对称加解密交给内核（kTLS），默认开启；内核或套件不支持时自动回退
+  void setKtlsEnabled(bool on);
+
+  ssl_ctx_st *native() const { return ctx_; }
+
+private:
+  ssl_ctx_st *ctx_;
+};
+
+// 一个连接上的 TLS 状态，SSL 直接绑定在非阻塞 socket 上，只在连接所属的 loop
+// 线程使用。握手完成后如果内核接管了发送方向，明文直接 write 到 socket 即可
+class TlsSession {
+public:
+  enum Result { kOk, kWantRead, kWantWrite, kClosed, kError };
+
+  TlsSession(const std::shared_ptr<TlsContext> &ctx, int fd, bool isServer,
+             const std::string &serverName = std::string());
+  ~TlsSession();
+
+  // 推进握手，kOk 表示握手完成
+  Result handshake();
+  bool handshakeDone() const { return handshakeDone_; }
+
+  // 解密后的数据追加到 buf，一次最多读 maxBytes 字节；n 为读到的字节数
+  Result read(Buffer &buf, size_t maxBytes, size_t &n);
+  // 加密发送，n 为已被接受的明文字节数。返回 kWantWrite 时需要等可写后
+  // 用同样的数据（可以在不同地址）重试
+  Result write(const char *data, size_t len, size_t &n);
+  // 发送 close_notify，不等待对端回应
+  void shutdown();
+
+  // 内核是否接管了发送 / 接收方向的加解密
+  bool ktlsSend() const { return ktlsSend_; }
+  bool ktlsRecv() const { return ktlsRecv_; }
+  std::string cipher() const;
+
+private:
+  Result translate(int ret, const char *func);
+
+  std::shared_ptr<TlsContext> ctx_;
+  ssl_st *ssl_;
+  bool handshakeDone_;
+  bool ktlsSend_;
+  bool ktlsRecv_;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// 事件追踪：在 poll、Channel::handleEvent、loop 任务、sendInLoop、accept、
+// close 等处记录带时间戳的区间事件，写进每个线程自己的环形缓冲区（无锁，
+// 写满后覆盖最旧的），需要时导出为 Chrome / Perfetto 可以打开的 JSON。
+//
+// 编译期开关：CMake 选项 REACTOR_TRACING（默认开），关掉后 TRACE_SCOPE
+// 展开为空。运行期开关：Tracer::setEnabled，默认关，关闭时每个埋点只是
+// 一次 relaxed load 加一个分支。
+//
+//   Tracer::setEnabled(true);
+//   Tracer::installDumpSignal(SIGUSR2, "/tmp/reactor.trace.json");
+//   // kill -USR2 <pid>，或者直接调用 Tracer::dump(path)
+
+// 一个区间事件。name 必须是字符串字面量，arg 为附带的数值（fd、字节数等），
+// 时间为 Tracer::now() 的计数，导出时才换算成纳秒
+struct TraceEvent {
+  const char *name;
+  uint64_t start;
+  uint64_t duration;
+  uint64_t arg;
+};
+
+class Tracer {
+public:
+  // 每个线程的环形缓冲区能保留的事件数，线程第一次记录时分配
+  static constexpr size_t kRingCapacity = 64 * 1024;
+
+  static void setEnabled(bool on) {
+    enabled_.store(on, std::memory_order_relaxed);
+  }
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  // 事件时间戳。x86 上直接读 TSC，比 clock_gettime 便宜，导出时按
+  // steady_clock 校准换算；其他平台就是 steady_clock 的纳秒数
+  static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  // 只写本线程的缓冲区，不加锁；线程名在第一次记录时取
+  static void record(const char *name, uint64_t start, uint64_t duration,
+                     uint64_t arg);
+
+  // 把所有线程缓冲区里的事件写成 Chrome trace JSON，不停止记录
+  static bool dump(const std::string &path);
+  // 收到 sig 时由后台线程调用 dump(path)，信号处理函数里只写一个管道
+  static bool installDumpSignal(int sig, const std::string &path);
+
+private:
+  static inline std::atomic<bool> enabled_{false};
+};
+
+// 作用域内的区间事件：构造时取开始时间，析构时记录
+class TraceScope {
+public:
+  explicit TraceScope(const char *name, uint64_t arg = 0)
+      : name_(name), arg_(arg),
+        start_(Tracer::enabled() ? Tracer::now() : 0) {}
+  ~TraceScope() {
+    if (start_ != 0) {
+      Tracer::record(name_, start_, Tracer::now() - start_, arg_);
+    }
+  }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  const char *name_;
+  uint64_t arg_;
+  uint64_t start_;
+};
+
+// 跨线程的区间事件（例如任务在队列里的排队时间）：起点在一个线程里用
+// traceNow 取，终点在另一个线程里用 traceSince 记录。编译期或运行期关闭时
+// traceNow 返回 0，traceSince 什么也不做
+inline uint64_t traceNow() {
+#ifdef REACTOR_TRACING
+  return Tracer::enabled() ? Tracer::now() : 0;
+#else
+  return 0;
+#endif
+}
+
+inline void traceSince(const char *name, uint64_t start, uint64_t arg) {
+  if (start != 0) {
+    Tracer::record(name, start, Tracer::now() - start, arg);
+  }
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifdef REACTOR_TRACING
+#define TRACE_SCOPE(...)                                                       \
+  TraceScope TRACE_CONCAT(traceScope_, __LINE__)(__VA_ARGS__)
+#else
+#define TRACE_SCOPE(...) static_cast<void>(0)
+#endif
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+// 流量录制：把服务端各连接收到的字节流连同时间戳写进一个紧凑的二进制文件，
+// 用 traffic_replay 按原来的节奏（或加速）重新打到服务器上，
+// 复现线上的流量形态。
+//
+// I/O 线程只把记录追加到内存里的待写缓冲区（一次加锁、一次 memcpy），
+// 由一个后台线程成批写文件。写文件跟不上、积压超过上限时丢弃数据记录并计数，
+// 不阻塞 I/O 线程；连接的打开和关闭记录总是保留。字节流中间缺一段就没法
+// 重放，所以一个连接第一次丢数据时写一条 kGap，之后它的数据都不再录制。
+// TLS 连接记录的是解密后的明文。
+//
+// 文件格式（整数均为 LEB128 变长编码）：
+//   文件头：  "RCAP" 版本号(1 字节)
+//   每条记录：类型(1 字节) 连接号 距上一条记录的微秒数 长度 内容
+//   kOpen 的内容为对端地址，kData 为收到的字节，kClose 和 kGap 没有内容。
+//   kGap 表示这个连接从这里起的数据因积压被丢弃（版本 2 起）
+class TrafficCapture {
+public:
+  enum RecordType : uint8_t { kOpen = 1, kData = 2, kClose = 3, kGap = 4 };
+
+  static constexpr uint8_t kVersion = 2;
+  // 待写数据的默认上限
+  static constexpr size_t kDefaultMaxPending = 64 * 1024 * 1024;
+
+  // 创建（截断）文件并启动写线程，失败返回 nullptr
+  static std::shared_ptr<TrafficCapture>
+  open(const std::string &path, size_t maxPending = kDefaultMaxPending);
+
+  TrafficCapture(int fd, size_t maxPending);
+  // 写完剩余记录再返回
+  ~TrafficCapture();
+  TrafficCapture(const TrafficCapture &) = delete;
+  TrafficCapture &operator=(const TrafficCapture &) = delete;
+
+  // 以下函数线程安全。openConnection 返回之后记录要用的连接号
+  uint64_t openConnection(const std::string &peer);
+  void data(uint64_t connId, const char *data, size_t len);
+  void closeConnection(uint64_t connId);
+
+  // 因积压被丢弃的数据字节数
+  uint64_t droppedBytes() const {
+    return droppedBytes_.load(std::memory_order_relaxed);
+  }
+  // 因积压丢过数据（写了 kGap）的连接数
+  uint64_t truncatedConnections() const {
+    return truncatedConnections_.load(std::memory_order_relaxed);
+  }
+
+private:
+  void append(RecordType type, uint64_t connId, const char *data, size_t len);
+  void writerLoop();
+
+  // 待写数据攒到这么多就叫醒写线程，否则写线程定期醒来
+  static constexpr size_t kWakeThreshold = 256 * 1024;
+
+  const int fd_;
+  const size_t maxPending_;
+  const std::chrono::steady_clock::time_point start_;
+  std::atomic<uint64_t> nextConnId_{1};
+  std::atomic<uint64_t> droppedBytes_{0};
+  std::atomic<uint64_t> truncatedConnections_{0};
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::string pending_;
+  // 已经写过 kGap、数据不再录制的连接，关闭时移除，只在持锁时访问
+  std::unordered_set<uint64_t> truncated_;
+  // 上一条记录的时间（相对 start_ 的微秒数），只在持锁时访问
+  uint64_t lastUs_ = 0;
+  bool stopping_ = false;
+  std::thread writer_;
+};
+
+// 一条解码后的记录，time 为相对录制开始的时间
+struct CaptureRecord {
+  TrafficCapture::RecordType type;
+  uint64_t connId;
+  std::chrono::microseconds time;
+  std::string data;
+};
+
+// 顺序读取录制文件
+class CaptureReader {
+public:
+  CaptureReader() = default;
+  ~CaptureReader();
+  CaptureReader(const CaptureReader &) = delete;
+  CaptureReader &operator=(const CaptureReader &) = delete;
+
+  // 打开文件并检查文件头
+  bool open(const std::string &path);
+  // 读出下一条记录，文件结束或内容损坏时返回 false，
+  // 损坏时 corrupted() 为 true
+  bool next(CaptureRecord &record);
+  bool corrupted() const { return corrupted_; }
+
+private:
+  bool readVarint(uint64_t &value);
+
+  FILE *fp_ = nullptr;
+  uint64_t timeUs_ = 0;
+  bool corrupted_ = false;
+};
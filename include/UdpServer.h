@@ -0,0 +1,154 @@
+#pragma once
+
+#include "Channel.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+#include "Socket.h"
+#include "ThreadAffinity.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+class UdpSocket;
+
+// 收到一个报文：socket 为收到它的那个套接字，回复用 socket.send(peer, ...)。
+// data 只在回调期间有效
+using UdpMessageCallback = std::function<void(
+    UdpSocket &socket, const InetAddress &peer, const char *data, size_t len)>;
+
+struct UdpOptions {
+  int batchSize = 32;            // 每次 recvmmsg/sendmmsg 最多处理的报文数
+  size_t maxDatagramSize = 2048; // 每个接收缓冲区的大小，开启 GRO 时应为 64KB
+  bool gro = false;              // 接收端 UDP_GRO：内核把同流小包合并后一次交付
+  bool gso = false;              // 发送端 UDP_SEGMENT：sendSegmented 由内核切包
+  int recvBufSize = 0;           // SO_RCVBUF，0 表示用系统默认值
+  int sendBufSize = 0;           // SO_SNDBUF，0 表示用系统默认值
+};
+
+// 绑定在某个 EventLoop 上的 UDP 套接字。接收用 recvmmsg 一次读一批到预分配的
+// 缓冲区，回复先攒在发送队列里，本批处理完后用 sendmmsg 一次发出。
+// 除 send 外的接口只能在所属 loop 线程调用，析构也要在所属 loop 线程、
+// loop 销毁之前。也可以单独用作客户端套接字
+class UdpSocket {
+public:
+  // 创建并绑定到 bindAddr（IPv4），总是开启 SO_REUSEADDR/SO_REUSEPORT
+  UdpSocket(EventLoop *loop, const InetAddress &bindAddr,
+            const UdpOptions &options = UdpOptions());
+  ~UdpSocket();
+
+  // 在 loop 线程里注册 Channel，开始接收
+  void start();
+
+  // 线程安全，不在 loop 线程时拷贝数据转发到 loop 线程
+  void send(const InetAddress &peer, const char *data, size_t len);
+  void send(const InetAddress &peer, const std::string &data) {
+    send(peer, data.data(), data.size());
+  }
+  // 把 data 按 segmentSize 切成多个报文发给 peer。开启 GSO 时整段交给内核切，
+  // 否则在用户态切成多条放进同一次 sendmmsg
+  void sendSegmented(const InetAddress &peer, const char *data, size_t len,
+                     size_t segmentSize);
+
+  void setMessageCallback(const UdpMessageCallback &cb) {
+    messageCallback_ = cb;
+  }
+
+  EventLoop *getLoop() const { return loop_; }
+  int getFd() const { return socket_.getFd(); }
+  InetAddress localAddress() const { return Socket::getLocalAddr(getFd()); }
+  // 内核不支持时 GRO/GSO 会在构造时被关掉
+  const UdpOptions &options() const { return options_; }
+
+  // 累计的系统调用次数和报文数，用来观察批处理的效果
+  uint64_t recvCalls() const { return recvCalls_; }
+  uint64_t recvDatagrams() const { return recvDatagrams_; }
+  uint64_t sendCalls() const { return sendCalls_; }
+  uint64_t sendDatagrams() const { return sendDatagrams_; }
+
+private:
+  // 待发送的报文，数据放在 outData_ 里
+  struct OutMessage {
+    InetAddress peer;
+    size_t offset;
+    size_t len;
+    uint16_t segmentSize; // 非 0 时附带 UDP_SEGMENT
+  };
+
+  void handleRead();
+  void handleWrite();
+  void deliver(const InetAddress &peer, const char *data, size_t len,
+               int groSize);
+  void enqueue(const InetAddress &peer, const char *data, size_t len,
+               uint16_t segmentSize);
+  void scheduleFlush();
+  void flush();
+
+  EventLoop *loop_;
+  Socket socket_;
+  Channel channel_;
+  UdpOptions options_;
+  // 接收批：每个报文一块 maxDatagramSize 的缓冲区，启动时一次分配
+  std::vector<char> recvData_;
+  std::vector<struct mmsghdr> recvMsgs_;
+  std::vector<struct iovec> recvIovecs_;
+  std::vector<struct sockaddr_in> recvAddrs_;
+  std::vector<char> recvControl_;
+  // 发送队列
+  std::vector<char> outData_;
+  std::vector<OutMessage> outQueue_;
+  size_t outHead_; // outQueue_ 中第一个未发送的报文
+  std::vector<struct mmsghdr> sendMsgs_;
+  std::vector<struct iovec> sendIovecs_;
+  std::vector<char> sendControl_;
+  bool handlingRead_;
+  bool flushScheduled_;
+  UdpMessageCallback messageCallback_;
+  uint64_t recvCalls_;
+  uint64_t recvDatagrams_;
+  uint64_t sendCalls_;
+  uint64_t sendDatagrams_;
+};
+
+// UDP 服务器：每个 I/O 线程一个绑定同一端口的 SO_REUSEPORT 套接字，
+// 由内核按四元组把报文分到各个 loop；线程数为 0 时只在主 loop 上开一个套接字
+class UdpServer {
+public:
+  // listenAddr 为 IPv4 地址，端口为 0 时由内核分配，各 loop 共用同一端口
+  explicit UdpServer(const InetAddress &listenAddr,
+                     const UdpOptions &options = UdpOptions());
+  ~UdpServer();
+
+  // 以下设置需在 start() 之前调用
+  void setThreadNum(int numThreads);
+  void setThreadAffinity(const ThreadAffinity &affinity);
+  void setMessageCallback(const UdpMessageCallback &cb) {
+    messageCallback_ = cb;
+  }
+
+  // 启动 I/O 线程并在当前线程运行主 loop，stop() 之后返回
+  void start();
+  void stop();
+
+  EventLoop *getLoop() const { return eventLoop_.get(); }
+  // 实际绑定的地址（端口传 0 时由内核分配），start() 之后有效
+  const InetAddress &listenAddress() const { return listenAddr_; }
+  // 每个 loop 上的套接字，start() 之后有效
+  const std::vector<std::unique_ptr<UdpSocket>> &sockets() const {
+    return sockets_;
+  }
+
+private:
+  // 析构时先在各 loop 线程里关套接字，再停 I/O 线程
+  std::unique_ptr<EventLoop> eventLoop_;
+  std::vector<std::unique_ptr<UdpSocket>> sockets_;
+  std::unique_ptr<EventLoopThreadPool> threadPool_;
+  int numThreads_;
+  ThreadAffinity affinity_;
+  InetAddress listenAddr_;
+  UdpOptions options_;
+  UdpMessageCallback messageCallback_;
+};
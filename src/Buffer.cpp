@@ -1,12 +1,20 @@
 #include "../include/Buffer.h"
 
+// 每个线程（即每个 EventLoop）缓存的默认大小存储块
+static constexpr size_t kPooledStorageSize =
+    Buffer::kCheapPrepend + Buffer::kInitialSize;
+static constexpr size_t kMaxPooledStorage = 4096;
+static thread_local std::vector<std::vector<char>> tStoragePool;
+// 未分配存储时 begin() 指向这里，peek()/beginWrite() 仍然是合法指针
+static char kEmptyStorage[Buffer::kCheapPrepend];
+
 /**
  * @brief 构造函数
- * @param initialSize 初始大小
+ * @param initialSize 初始大小，第一次写入时才分配
  */
 Buffer::Buffer(size_t initialSize)
-    : buffer_(kCheapPrepend + initialSize), readerIndex_(kCheapPrepend),
-      writerIndex_(kCheapPrepend) {}
+    : readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend),
+      initialSize_(initialSize) {}
 
 Buffer::~Buffer() { buffer_.clear(); }
 
@@ -20,7 +28,9 @@ size_t Buffer::readableBytes() const { return writerIndex_ - readerIndex_; }
  * @brief 可写字节数
  * @return
  */
-size_t Buffer::writableBytes() const { return buffer_.size() - writerIndex_; }
+size_t Buffer::writableBytes() const {
+  return buffer_.size() > writerIndex_ ? buffer_.size() - writerIndex_ : 0;
+}
 
 /**
  * @brief 预留字节数
@@ -141,29 +151,78 @@ ssize_t Buffer::readFd(int fd) {
   } else if (static_cast<size_t>(n) <= writable) {
     writerIndex_ += n;
   } else {
-    writerIndex_ = buffer_.size();
+    writerIndex_ += writable;
     append(extrabuf, n - writable);
   }
   return n;
 }
 
+/**
+ * @brief 归还存储
+ */
+void Buffer::release() {
+  if (buffer_.empty() || readableBytes() > 0) {
+    return;
+  }
+  if (buffer_.size() == kPooledStorageSize &&
+      tStoragePool.size() < kMaxPooledStorage) {
+    tStoragePool.push_back(std::move(buffer_));
+  }
+  std::vector<char>().swap(buffer_);
+  readerIndex_ = kCheapPrepend;
+  writerIndex_ = kCheapPrepend;
+}
+
+/**
+ * @brief 收缩存储
+ * @param reserve 收缩后保留的可写空间
+ */
+void Buffer::shrink(size_t reserve) {
+  size_t readable = readableBytes();
+  if (buffer_.capacity() <= kCheapPrepend + readable + reserve) {
+    return;
+  }
+  std::vector<char> buf(kCheapPrepend + readable + reserve);
+  std::copy(peek(), peek() + readable, buf.begin() + kCheapPrepend);
+  buffer_.swap(buf);
+  readerIndex_ = kCheapPrepend;
+  writerIndex_ = kCheapPrepend + readable;
+}
+
 /**
  * @brief 返回缓冲区的起始地址
  * @return
  */
-char *Buffer::begin() { return &*buffer_.begin(); }
+char *Buffer::begin() {
+  return buffer_.empty() ? kEmptyStorage : buffer_.data();
+}
 
 /**
  * @brief 返回缓冲区的起始地址
  * @return
  */
-const char *Buffer::begin() const { return &*buffer_.begin(); }
+const char *Buffer::begin() const {
+  return buffer_.empty() ? kEmptyStorage : buffer_.data();
+}
 
 /**
  * @brief 腾出空间
  * @param len
  */
 void Buffer::makeSpace(size_t len) {
+  // 第一次写入：优先从线程的池里取默认大小的存储
+  if (buffer_.empty()) {
+    size_t need = kCheapPrepend + std::max(initialSize_, len);
+    if (need <= kPooledStorageSize && !tStoragePool.empty()) {
+      buffer_ = std::move(tStoragePool.back());
+      tStoragePool.pop_back();
+    } else {
+      buffer_.resize(std::max(need, kPooledStorageSize));
+    }
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend;
+    return;
+  }
   if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
     buffer_.resize(writerIndex_ + len);
   } else {
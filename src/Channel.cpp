@@ -1,4 +1,6 @@
 #include "../include/Channel.h"
+#include "../include/Trace.h"
+#include <atomic>
 #include <cstring>
 #include <experimental/source_location>
 #include <iostream>
@@ -6,8 +8,12 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
-void log(const std::string &message, const std::string &func,
-         const std::experimental::source_location &location) {
+static std::atomic<bool> gLogEnabled{true};
+
+void setLogEnabled(bool on) { gLogEnabled = on; }
+
+static void writeLog(const std::string &message, const std::string &func,
+                     const std::experimental::source_location &location) {
   std::string filename = location.file_name();
   auto pos = filename.find_last_of("/\\");
   if (pos != std::string::npos)
@@ -17,13 +23,21 @@ void log(const std::string &message, const std::string &func,
             << message << std::endl;
 }
 
+void log(const std::string &message, const std::string &func,
+         const std::experimental::source_location &location) {
+  if (gLogEnabled.load(std::memory_order_relaxed)) {
+    writeLog(message, func, location);
+  }
+}
+
 void logError(const std::string &message, const std::string &func,
               const std::experimental::source_location &location) {
-  log("Error: " + message, func, location);
+  writeLog("Error: " + message, func, location);
 }
 
 Channel::Channel(int fd, Poller *epoll)
-    : fd_(fd), epoll_(epoll), inEpoll_(false), events_(0), revents_(0) {
+    : fd_(fd), epoll_(epoll), inEpoll_(false), events_(0), revents_(0),
+      registeredEvents_(0), dirtyIndex_(-1), rearm_(false) {
 }
 
 Channel::~Channel() {}
@@ -40,15 +54,29 @@ void Channel::useEdgeTrigger(bool on) {
 }
 
 void Channel::enableReading() {
+  rearm_ = rearm_ || !(events_ & EPOLLIN);
   events_ |= EPOLLIN;
   epoll_->updateChannel(this);
 }
 
+void Channel::disableReading() {
+  events_ &= ~EPOLLIN;
+  epoll_->updateChannel(this);
+}
+
+bool Channel::isReading() const { return events_ & EPOLLIN; }
+
 void Channel::enableWriting() {
+  rearm_ = rearm_ || !(events_ & EPOLLOUT);
   events_ |= EPOLLOUT;
   epoll_->updateChannel(this);
 }
 
+void Channel::disableWriting() {
+  events_ &= ~EPOLLOUT;
+  epoll_->updateChannel(this);
+}
+
 bool Channel::isWriting() const { return events_ & EPOLLOUT; }
 
 void Channel::setInEpoll(bool on) { inEpoll_ = on; }
@@ -60,22 +88,27 @@ bool Channel::isInEpoll() const { return inEpoll_; }
 uint32_t Channel::getEvents() const { return events_; }
 
 void Channel::handleEvent() {
+  TRACE_SCOPE("handleEvent", fd_);
   if (revents_ & EPOLLRDHUP) { // 客户端关闭连接
     log("Client disconnected", __func__);
     closeCallback_();
     return; // 客户端关闭连接，不需要处理其他事件
   }
 
+  if (!(revents_ & (EPOLLIN | EPOLLPRI | EPOLLOUT))) { // 其他事件，忽略
+    log("Unknown event", __func__);
+    return;
+  }
   if (revents_ & (EPOLLIN | EPOLLPRI)) { // 读事件
     if (readCallback_) {
       readCallback_(); // 调用设置的回调函数，能处理第一次连接和后续数据通信
     }
-  } else if (revents_ & EPOLLOUT) { // 写事件
+  }
+  // 边缘触发下读写可能同时就绪，都要处理；读回调里连接可能已经关闭
+  if ((revents_ & EPOLLOUT) && isWriting()) { // 写事件
     if (writeCallback_) {
-      writeCallback_(); // 调用设置的回调函数，能处理第一次连接和后续数据通信
+      writeCallback_();
     }
-  } else { // 其他事件，忽略
-    log("Unknown event", __func__);
   }
 }
 
@@ -85,6 +118,8 @@ void Channel::disableAll() {
   epoll_->updateChannel(this);
 }
 
+void Channel::setPoller(Poller *poller) { epoll_ = poller; }
+
 void Channel::setReadCallback(std::function<void()> callback) { // 设置读回调
   readCallback_ = callback;
 }
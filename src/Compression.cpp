@@ -0,0 +1,254 @@
+#include "../include/Compression.h"
+#include <algorithm>
+#include <cstring>
+
+static const char kMagic[] = {'R', 'Z', 'C'};
+static constexpr size_t kMagicSize = sizeof(kMagic);
+// 编码时输出缓冲区每次至少扩这么多
+static constexpr size_t kMinChunk = 4096;
+// 一帧最多压缩这么多明文，deflate 的最坏膨胀加上之后仍在 kMaxFrameSize 以内
+static constexpr size_t kMaxFramePlain = CompressionCodec::kMaxFrameSize / 2;
+
+using Clock = std::chrono::steady_clock;
+
+// 帧头里大端存放的内容长度
+static uint32_t frameLength(const char *header) {
+  const auto *p = reinterpret_cast<const uint8_t *>(header);
+  return static_cast<uint32_t>(p[1]) << 24 | static_cast<uint32_t>(p[2]) << 16 |
+         static_cast<uint32_t>(p[3]) << 8 | p[4];
+}
+
+CompressionCodec::CompressionCodec(const CompressionOptions &options,
+                                   bool isServer)
+    : options_(options), isServer_(isServer), state_(kNegotiating) {
+  if (!isServer_) {
+    control_.assign(kMagic, kMagicSize);
+    control_.push_back(static_cast<char>(kVersion));
+    control_.push_back(static_cast<char>(1u << kDeflate));
+  }
+}
+
+CompressionCodec::~CompressionCodec() {
+  if (deflate_) {
+    ::deflateEnd(deflate_.get());
+  }
+  if (inflate_) {
+    ::inflateEnd(inflate_.get());
+  }
+}
+
+/**
+ * @brief 协商出 kDeflate 后创建两个方向的流，整个连接只创建一次。
+ * 用不带 zlib 头的原始 deflate 流，每帧省掉头尾校验
+ */
+bool CompressionCodec::initStreams() {
+  int windowBits = std::clamp(options_.windowBits, 9, 15);
+  deflate_ = std::make_unique<z_stream>();
+  if (::deflateInit2(deflate_.get(), options_.level, Z_DEFLATED, -windowBits,
+                     8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    deflate_.reset();
+    return false;
+  }
+  inflate_ = std::make_unique<z_stream>();
+  if (::inflateInit2(inflate_.get(), -windowBits) != Z_OK) {
+    inflate_.reset();
+    return false;
+  }
+  return true;
+}
+
+const std::string &CompressionCodec::encode(const char *data, size_t len) {
+  frame_.clear();
+  if (state_ == kNegotiating) {
+    pending_.append(data, len);
+    return frame_;
+  }
+  if (state_ == kPlain) {
+    frame_.assign(data, len);
+    return frame_;
+  }
+  stats_.plainBytesOut += len;
+  if (len < options_.minSize) {
+    appendFrame(kRawFrame, data, len);
+    return frame_;
+  }
+  // 大的 send 拆成多帧，每帧解压后都不超过 kMaxFrameSize
+  for (size_t off = 0; off < len; off += kMaxFramePlain) {
+    appendFrame(kDeflateFrame, data + off, std::min(kMaxFramePlain, len - off));
+  }
+  return frame_;
+}
+
+// 在 frame_ 末尾追加一帧
+void CompressionCodec::appendFrame(FrameType type, const char *data,
+                                   size_t len) {
+  // 帧头先占位，内容长度编码完才知道
+  const size_t header = frame_.size();
+  frame_.resize(header + kFrameHeaderSize);
+  if (type == kRawFrame) {
+    frame_.append(data, len);
+    ++stats_.framesRaw;
+  } else {
+    Clock::time_point start = Clock::now();
+    z_stream *z = deflate_.get();
+    z->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    z->avail_in = static_cast<uInt>(len);
+    // Z_SYNC_FLUSH 把这次的数据全部输出并对齐到字节边界，流本身不结束
+    do {
+      size_t used = frame_.size();
+      size_t chunk = std::max(kMinChunk, len / 2);
+      frame_.resize(used + chunk);
+      z->next_out = reinterpret_cast<Bytef *>(&frame_[used]);
+      z->avail_out = static_cast<uInt>(chunk);
+      ::deflate(z, Z_SYNC_FLUSH);
+      frame_.resize(used + chunk - z->avail_out);
+    } while (z->avail_out == 0);
+    stats_.compressTime += Clock::now() - start;
+    ++stats_.framesCompressed;
+  }
+  size_t bodyLen = frame_.size() - header - kFrameHeaderSize;
+  char *p = &frame_[header];
+  p[0] = static_cast<char>(type);
+  p[1] = static_cast<char>(bodyLen >> 24);
+  p[2] = static_cast<char>(bodyLen >> 16);
+  p[3] = static_cast<char>(bodyLen >> 8);
+  p[4] = static_cast<char>(bodyLen);
+  stats_.wireBytesOut += kFrameHeaderSize + bodyLen;
+}
+
+bool CompressionCodec::decode(Buffer &wire) {
+  if (state_ == kNegotiating && !decodeHandshake(wire)) {
+    return false;
+  }
+  while (state_ == kCompressed &&
+         wire.readableBytes() >= kFrameHeaderSize) {
+    uint32_t len = frameLength(wire.peek());
+    if (len > kMaxFrameSize) {
+      return false;
+    }
+    if (wire.readableBytes() < kFrameHeaderSize + len) {
+      break;
+    }
+    // 每帧最多解出 kMaxFrameSize，积压最多超出上限这么多
+    if (!decodeFrame(wire) ||
+        input_.readableBytes() > options_.maxDecodedBacklog) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief 处理握手消息。服务端看到的头几个字节和 hello 对不上时退回明文，
+ * 这些字节留在 wire 里交给用户；客户端收到的应答不对视为协议错误
+ */
+bool CompressionCodec::decodeHandshake(Buffer &wire) {
+  size_t n = std::min(wire.readableBytes(), kHandshakeSize);
+  const char *p = wire.peek();
+  if (std::memcmp(p, kMagic, std::min(n, kMagicSize)) != 0) {
+    if (isServer_) {
+      state_ = kPlain;
+      return true;
+    }
+    return false;
+  }
+  if (n < kHandshakeSize) {
+    return true;
+  }
+  uint8_t version = static_cast<uint8_t>(p[3]);
+  uint8_t algorithm = static_cast<uint8_t>(p[4]);
+  wire.retrieve(kHandshakeSize);
+  if (isServer_) {
+    // hello 里是支持的算法位图，版本不同时不压缩
+    Algorithm chosen = version == kVersion && (algorithm & (1u << kDeflate))
+                           ? kDeflate
+                           : kNone;
+    control_.assign(kMagic, kMagicSize);
+    control_.push_back(static_cast<char>(kVersion));
+    control_.push_back(static_cast<char>(chosen));
+    algorithm = chosen;
+  } else if (algorithm != kNone && algorithm != kDeflate) {
+    return false;
+  }
+  if (algorithm == kDeflate) {
+    if (!initStreams()) {
+      return false;
+    }
+    state_ = kCompressed;
+  } else {
+    state_ = kPlain;
+  }
+  return true;
+}
+
+// 调用方保证 wire 里已经有一个完整的帧
+bool CompressionCodec::decodeFrame(Buffer &wire) {
+  const char *p = wire.peek();
+  auto type = static_cast<FrameType>(p[0]);
+  size_t len = frameLength(p);
+  const char *body = p + kFrameHeaderSize;
+  size_t before = input_.readableBytes();
+  if (type == kRawFrame) {
+    input_.append(body, len);
+  } else if (type == kDeflateFrame) {
+    Clock::time_point start = Clock::now();
+    z_stream *z = inflate_.get();
+    z->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(body));
+    z->avail_in = static_cast<uInt>(len);
+    // 解压出来的数据不超过 kMaxFrameSize，剩余额度用完还没解完就是解压炸弹
+    size_t budget = kMaxFrameSize;
+    do {
+      if (budget == 0) {
+        return false;
+      }
+      input_.ensureWritableBytes(
+          std::min(budget, std::max(kMinChunk, len * 2)));
+      size_t room = std::min(budget, input_.writableBytes());
+      z->next_out = reinterpret_cast<Bytef *>(input_.beginWrite());
+      z->avail_out = static_cast<uInt>(room);
+      int ret = ::inflate(z, Z_SYNC_FLUSH);
+      input_.hasWritten(room - z->avail_out);
+      budget -= room - z->avail_out;
+      if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        return false;
+      }
+    } while (z->avail_out == 0);
+    stats_.decompressTime += Clock::now() - start;
+    // 输出没填满说明这一帧已经全部解开，还剩输入就是数据有问题
+    if (z->avail_in != 0) {
+      return false;
+    }
+  } else {
+    return false;
+  }
+  stats_.wireBytesIn += kFrameHeaderSize + len;
+  stats_.plainBytesIn += input_.readableBytes() - before;
+  wire.retrieve(kFrameHeaderSize + len);
+  return true;
+}
+
+bool CompressionCodec::abandonNegotiation() {
+  if (!isServer_) {
+    return false;
+  }
+  state_ = kPlain;
+  return true;
+}
+
+bool CompressionCodec::takeControl(std::string &out) {
+  if (control_.empty()) {
+    return false;
+  }
+  out.swap(control_);
+  control_.clear();
+  return true;
+}
+
+bool CompressionCodec::takePending(std::string &out) {
+  if (state_ == kNegotiating || pending_.empty()) {
+    return false;
+  }
+  out.swap(pending_);
+  pending_.clear();
+  return true;
+}
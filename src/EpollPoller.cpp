@@ -8,6 +8,7 @@
 #include <strings.h>
 #include <sys/epoll.h>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 
 Epoll::Epoll() : epollfd_(epoll_create(1)), events_(1024) {
@@ -20,27 +21,53 @@ Epoll::Epoll() : epollfd_(epoll_create(1)), events_(1024) {
 Epoll::~Epoll() { close(epollfd_); }
 
 void Epoll::updateChannel(Channel *channel) {
-  struct epoll_event ev;
-  bzero(&ev, sizeof(ev));
-  ev.data.ptr = channel;
-  ev.events = channel->getEvents();
+  if (channel->dirtyIndex_ < 0) {
+    channel->dirtyIndex_ = static_cast<int>(dirty_.size());
+    dirty_.push_back(channel);
+  }
+}
 
-  // 注册事件
-  if (channel->isInEpoll()) {
-    if (epoll_ctl(epollfd_, EPOLL_CTL_MOD, channel->getFd(), &ev) == -1) {
-      logError(strerror(errno), __func__);
+/**
+ * @brief 把本轮积累的兴趣集修改提交给内核，每个 Channel 至多一次 epoll_ctl
+ */
+void Epoll::applyUpdates() {
+  for (Channel *channel : dirty_) {
+    if (channel == nullptr) {
+      continue;
     }
-  } else {
-    if (epoll_ctl(epollfd_, EPOLL_CTL_ADD, channel->getFd(), &ev) == -1) {
-      logError(strerror(errno), __func__);
+    channel->dirtyIndex_ = -1;
+    bool rearm = std::exchange(channel->rearm_, false);
+    uint32_t events = channel->getEvents();
+
+    struct epoll_event ev;
+    bzero(&ev, sizeof(ev));
+    ev.data.ptr = channel;
+    ev.events = events;
+    if (!channel->isInEpoll()) {
+      // 还没有读写兴趣（例如只设置了边缘触发）就先不加入
+      if (!(events & (Channel::kReadEvent | Channel::kWriteEvent))) {
+        continue;
+      }
+      if (epoll_ctl(epollfd_, EPOLL_CTL_ADD, channel->getFd(), &ev) == -1) {
+        logError(strerror(errno), __func__);
+        continue;
+      }
+      channel->setInEpoll(true);
+    } else if (events != channel->registeredEvents_ || rearm) {
+      if (epoll_ctl(epollfd_, EPOLL_CTL_MOD, channel->getFd(), &ev) == -1) {
+        logError(strerror(errno), __func__);
+      }
     }
-    channel->setInEpoll(true);
+    channel->registeredEvents_ = events;
   }
+  dirty_.clear();
 }
 
 void Epoll::poll(std::vector<Channel *> &activeChannels, int timeoutMs) {
+  applyUpdates();
   while (true) {
-    int nfds = epoll_wait(epollfd_, events_.data(), events_.size(), -1);
+    int nfds =
+        epoll_wait(epollfd_, events_.data(), events_.size(), timeoutMs);
     if (nfds < 0) {
       if (errno == EINTR)
         continue;
@@ -49,8 +76,8 @@ void Epoll::poll(std::vector<Channel *> &activeChannels, int timeoutMs) {
       assert(false);
     }
     if (nfds == 0) {
-      // timeout 为 -1 时，这里理论上不会执行
-      assert(false);
+      // 超时，没有就绪事件
+      break;
     }
     for (int i = 0; i < nfds; ++i) {
       Channel *ch = (Channel *)events_[i].data.ptr;
@@ -65,10 +92,17 @@ void Epoll::poll(std::vector<Channel *> &activeChannels, int timeoutMs) {
 }
 
 void Epoll::removeChannel(Channel *channel) {
+  // 撤销还没提交的修改；从未加入内核的 Channel 到这里就结束了
+  if (channel->dirtyIndex_ >= 0) {
+    dirty_[channel->dirtyIndex_] = nullptr;
+    channel->dirtyIndex_ = -1;
+    channel->rearm_ = false;
+  }
   if (channel->isInEpoll()) {
     if (epoll_ctl(epollfd_, EPOLL_CTL_DEL, channel->getFd(), nullptr) == -1) {
       logError(strerror(errno), __func__);
     }
     channel->setInEpoll(false);
+    channel->registeredEvents_ = 0;
   }
 }
@@ -1,53 +1,127 @@
 #include "../include/Channel.h"
 #include "../include/EventLoop.h"
+#include "../include/Trace.h"
+#include <cerrno>
+#include <cstring>
 #include <memory>
+#include <pthread.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <vector>
 
+// 每个线程上最先创建的 EventLoop，协程帧分配用它的内存池
+static thread_local EventLoop *tCurrentLoop = nullptr;
+
 EventLoop::EventLoop()
     : poller_(std::make_unique<Epoll>()), quit_(false),
       threadId_(std::this_thread::get_id()),
       wakeupFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
-      wakeupChannel_(std::make_unique<Channel>(wakeupFd_, poller_.get())) {
+      wakeupChannel_(std::make_unique<Channel>(wakeupFd_, poller_.get())),
+      callingPendingFunctors_(false), cpu_(-1), numaNode_(-1),
+      connectionPool_(std::make_shared<FixedBlockPool>()),
+      timerFd_(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      timerChannel_(std::make_unique<Channel>(timerFd_, poller_.get())),
+      nextTimerId_(1) {
   if (wakeupFd_ < 0) {
     logError("Failed to create wakeupFd", __func__);
   }
+  if (timerFd_ < 0) {
+    logError("Failed to create timerFd", __func__);
+  }
+  if (pthread_getcpuclockid(pthread_self(), &cpuClock_) != 0) {
+    cpuClock_ = CLOCK_THREAD_CPUTIME_ID;
+  }
   wakeupChannel_->setReadCallback([this]() { handleWakeup(); });
   wakeupChannel_->enableReading();
+  timerChannel_->setReadCallback([this]() { handleTimer(); });
+  timerChannel_->enableReading();
+  if (tCurrentLoop == nullptr) {
+    tCurrentLoop = this;
+  }
+}
+
+EventLoop::~EventLoop() {
+  if (tCurrentLoop == this) {
+    tCurrentLoop = nullptr;
+  }
+  ::close(timerFd_);
 }
 
-EventLoop::~EventLoop() {}
+EventLoop *EventLoop::current() { return tCurrentLoop; }
 
 Poller *EventLoop::getPoller() const { return poller_.get(); }
 
+void EventLoop::setPlacement(int cpu, int numaNode) {
+  cpu_ = cpu;
+  numaNode_ = numaNode;
+}
+
 void EventLoop::loop() {
+  // loop() 之前在本线程 queueInLoop 的任务没有唤醒过 epoll，先执行掉
+  doPendingFunctions();
   while (!quit_) {
     std::vector<Channel *> channels;
+    std::vector<std::function<void()>> ready;
+    ready.swap(readyFuncs_);
+    bool pending;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending = !pendingFuncs_.empty();
+    }
 
-    poller_->poll(channels);
+    // 有上一轮留下的就绪任务，或者 beforePoll 任务里 queueInLoop 的任务
+    // （没有唤醒 eventfd）时不能阻塞在 epoll_wait
+    {
+      TRACE_SCOPE("poll");
+      poller_->poll(channels, ready.empty() && !pending ? -1 : 0);
+    }
 
     for (auto &channel : channels) {
       channel->handleEvent();
     }
 
+    for (const auto &func : ready) {
+      TRACE_SCOPE("readyFunctor");
+      func();
+    }
+
     // 处理pendingFuncs_ - 每次循环都会执行
     doPendingFunctions();
+    doBeforePollFunctions();
   }
 }
 
 void EventLoop::doPendingFunctions() {
   std::vector<std::function<void()>> functions;
+  callingPendingFunctors_ = true;
   {
     std::lock_guard<std::mutex> lock(mutex_);
     functions.swap(pendingFuncs_);
   }
 
   for (const auto &func : functions) {
+    TRACE_SCOPE("pendingFunctor");
     func();
   }
+  callingPendingFunctors_ = false;
 }
 
-void EventLoop::quit() { quit_ = true; }
+void EventLoop::quit() {
+  quit_ = true;
+  // 其他线程调用时 loop 可能阻塞在 epoll_wait 里，需要唤醒
+  if (!isInLoopThread()) {
+    wakeup();
+  }
+}
+
+// 线程 CPU 时钟可以从其他线程读取，loop 本身不需要为此做任何记账
+uint64_t EventLoop::cpuTimeNanos() const {
+  timespec ts{};
+  if (::clock_gettime(cpuClock_, &ts) != 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
 
 bool EventLoop::isInLoopThread() const {
   return threadId_ == std::this_thread::get_id();
@@ -58,11 +132,32 @@ void EventLoop::queueInLoop(std::function<void()> func) {
     std::lock_guard<std::mutex> lock(mutex_);
     pendingFuncs_.push_back(func);
   }
-  if (!isInLoopThread()) {
+  // 在 pending 任务里再 queueInLoop 的任务要等下一轮，也需要唤醒 epoll
+  if (!isInLoopThread() || callingPendingFunctors_) {
     wakeup();
   }
 }
 
+void EventLoop::queueReady(std::function<void()> func) {
+  readyFuncs_.push_back(std::move(func));
+}
+
+void EventLoop::queueBeforePoll(std::function<void()> func) {
+  beforePollFuncs_.push_back(std::move(func));
+}
+
+// 按下标执行，执行中追加的任务本轮一起执行；不交换 vector，容量留着下轮复用
+// 这里 queueInLoop 的任务赶不上本轮的 doPendingFunctions，由 loop 检查
+// pendingFuncs_ 不阻塞地 poll 一次，不用写 eventfd
+void EventLoop::doBeforePollFunctions() {
+  for (size_t i = 0; i < beforePollFuncs_.size(); ++i) {
+    std::function<void()> func = std::move(beforePollFuncs_[i]);
+    TRACE_SCOPE("beforePollFunctor");
+    func();
+  }
+  beforePollFuncs_.clear();
+}
+
 // 当 wakeupChannel_ 发生读事件时被调用
 void EventLoop::handleWakeup() {
   uint64_t one = 1;
@@ -84,3 +179,90 @@ void EventLoop::wakeup() {
              "EventLoop");
   }
 }
+
+TimerId EventLoop::runAfter(std::chrono::steady_clock::duration delay,
+                            std::function<void()> func) {
+  TimerId id = nextTimerId_.fetch_add(1, std::memory_order_relaxed);
+  TimePoint when = std::chrono::steady_clock::now() + delay;
+  if (isInLoopThread()) {
+    addTimerInLoop(id, when, std::move(func));
+  } else {
+    queueInLoop([this, id, when, func = std::move(func)]() mutable {
+      addTimerInLoop(id, when, std::move(func));
+    });
+  }
+  return id;
+}
+
+void EventLoop::cancelTimer(TimerId id) {
+  if (isInLoopThread()) {
+    timers_.erase(id);
+  } else {
+    queueInLoop([this, id]() { timers_.erase(id); });
+  }
+}
+
+void EventLoop::addTimerInLoop(TimerId id, TimePoint when,
+                               std::function<void()> func) {
+  bool earliest = timerQueue_.empty() || when < timerQueue_.begin()->first;
+  timerQueue_.emplace(when, id);
+  timers_.emplace(id, std::move(func));
+  if (earliest) {
+    resetTimerFd();
+  }
+}
+
+/**
+ * @brief timerfd 到期：执行所有到期且未取消的定时器，再按最早的剩余定时器重新设置
+ */
+void EventLoop::handleTimer() {
+  // 读掉到期次数，否则 epoll 会一直触发；提前被唤醒时返回 EAGAIN，忽略即可
+  uint64_t expirations = 0;
+  if (::read(timerFd_, &expirations, sizeof(expirations)) < 0 &&
+      errno != EAGAIN) {
+    logError(strerror(errno), __func__);
+  }
+  TimePoint now = std::chrono::steady_clock::now();
+  std::vector<TimerId> expired;
+  while (!timerQueue_.empty() && timerQueue_.begin()->first <= now) {
+    expired.push_back(timerQueue_.begin()->second);
+    timerQueue_.erase(timerQueue_.begin());
+  }
+  // 先把队列整理好再执行回调，回调里可以再添加或取消定时器；
+  // 执行前再查一次，前面的回调可能已经取消了后面的定时器
+  resetTimerFd();
+  for (TimerId id : expired) {
+    auto it = timers_.find(id);
+    if (it == timers_.end()) {
+      continue;
+    }
+    std::function<void()> func = std::move(it->second);
+    timers_.erase(it);
+    TRACE_SCOPE("timer", id);
+    func();
+  }
+}
+
+void EventLoop::resetTimerFd() {
+  // 已取消的定时器留在队首会导致无意义的唤醒，顺手清掉
+  while (!timerQueue_.empty() &&
+         timers_.find(timerQueue_.begin()->second) == timers_.end()) {
+    timerQueue_.erase(timerQueue_.begin());
+  }
+  struct itimerspec spec;
+  std::memset(&spec, 0, sizeof(spec));
+  if (!timerQueue_.empty()) {
+    auto delay = timerQueue_.begin()->first - std::chrono::steady_clock::now();
+    auto ns = std::max<int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count(),
+        1000);
+    spec.it_value.tv_sec = ns / 1000000000;
+    spec.it_value.tv_nsec = ns % 1000000000;
+  }
+  // it_value 全为 0 表示停止定时器
+  ::timerfd_settime(timerFd_, 0, &spec, nullptr);
+}
+
+void SleepAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  loop_->runAfter(delay_, [handle]() { handle.resume(); });
+}
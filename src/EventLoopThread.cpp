@@ -1,7 +1,9 @@
 #include "../include/EventLoopThread.h"
 #include "../include/EventLoop.h"
+#include "../include/ThreadAffinity.h"
 
-EventLoopThread::EventLoopThread() : loop_(nullptr) {}
+EventLoopThread::EventLoopThread(const std::string &name, int cpu)
+    : loop_(nullptr), name_(name), cpu_(cpu) {}
 
 EventLoopThread::~EventLoopThread() {
   if (loop_ != nullptr) {
@@ -27,7 +29,17 @@ EventLoop *EventLoopThread::startLoop() {
 }
 
 void EventLoopThread::threadFunc() {
+  if (!name_.empty()) {
+    setCurrentThreadName(name_);
+  }
+  // 先绑核、设置内存策略，再构造 EventLoop，保证 loop 及其之后分配的内存都在本地节点
+  int node = -1;
+  if (cpu_ >= 0 && pinCurrentThread(cpu_)) {
+    node = bindMemoryToCpuNode(cpu_);
+  }
+
   EventLoop loop;
+  loop.setPlacement(cpu_, node);
 
   {
     std::unique_lock<std::mutex> lock(mutex_);
@@ -1,18 +1,48 @@
 #include "../include/EventLoop.h"
 #include "../include/EventLoopThread.h"
 #include "../include/EventLoopThreadPool.h"
+#include "../include/ThreadAffinity.h"
+#include <algorithm>
 
-EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, int numThreads)
-    : baseLoop_(baseLoop), numThreads_(numThreads), next_(0) {}
+EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, int numThreads,
+                                         const ThreadAffinity &affinity)
+    : baseLoop_(baseLoop), numThreads_(numThreads), next_(0),
+      affinity_(affinity) {}
 
 EventLoopThreadPool::~EventLoopThreadPool() {}
 
 void EventLoopThreadPool::start() {
+  // 先建 I/O 线程再放置主 loop：新线程继承创建者的 CPU 掩码和内存策略，
+  // 主线程先绑核的话，不绑核的 I/O 线程也会挤在 baseCpu 上，
+  // 自动绑核看到的允许 CPU 也只剩 baseCpu 一个
   for (int i = 0; i < numThreads_; ++i) {
-    auto t = std::make_unique<EventLoopThread>();
+    auto t = std::make_unique<EventLoopThread>(
+        affinity_.namePrefix + std::to_string(i), cpuForThread(i));
     loops_.push_back(t->startLoop());
     threads_.push_back(std::move(t));
   }
+
+  // start() 在主 EventLoop 所在线程调用，主 loop 单独放置
+  if (affinity_.baseCpu >= 0 && pinCurrentThread(affinity_.baseCpu)) {
+    int node = bindMemoryToCpuNode(affinity_.baseCpu);
+    baseLoop_->setPlacement(affinity_.baseCpu, node);
+  }
+}
+
+// 第 index 个 I/O 线程应绑定的 CPU，-1 表示不绑核
+int EventLoopThreadPool::cpuForThread(int index) const {
+  if (!affinity_.ioCpus.empty()) {
+    return affinity_.ioCpus[index % affinity_.ioCpus.size()];
+  }
+  if (!affinity_.autoPin) {
+    return -1;
+  }
+  std::vector<int> cpus = allowedCpus();
+  // 有多余的核时，I/O 线程避开主 loop 所在的核
+  if (cpus.size() > 1) {
+    std::erase(cpus, affinity_.baseCpu);
+  }
+  return cpus.empty() ? -1 : cpus[index % cpus.size()];
 }
 
 EventLoop *EventLoopThreadPool::getNextLoop() {
@@ -22,4 +52,67 @@ EventLoop *EventLoopThreadPool::getNextLoop() {
   EventLoop *loop = loops_[next_];
   next_ = (next_ + 1) % loops_.size();
   return loop;
-}
\ No newline at end of file
+}
+
+EventLoop *EventLoopThreadPool::getLoopForCpu(int cpu) {
+  if (cpuLoops_.empty()) {
+    buildCpuMap();
+  }
+  if (cpu < 0 || cpu >= static_cast<int>(cpuLoops_.size()) ||
+      cpuLoops_[cpu].empty()) {
+    return getNextLoop();
+  }
+  std::vector<EventLoop *> &candidates = cpuLoops_[cpu];
+  size_t &next = cpuNext_[cpu];
+  EventLoop *loop = candidates[next];
+  next = (next + 1) % candidates.size();
+  return loop;
+}
+
+/**
+ * @brief 按 CPU 拓扑为每个 CPU 找出离它最近的、绑了核的 I/O loop
+ */
+void EventLoopThreadPool::buildCpuMap() {
+  int count = configuredCpuCount();
+  cpuLoops_.assign(count, {});
+  cpuNext_.assign(count, 0);
+  std::vector<std::vector<int>> siblings(count);
+  std::vector<int> nodes(count);
+  std::vector<int> packages(count);
+  for (int cpu = 0; cpu < count; ++cpu) {
+    siblings[cpu] = cpuThreadSiblings(cpu);
+    nodes[cpu] = cpuNumaNode(cpu);
+    packages[cpu] = cpuPackage(cpu);
+  }
+  for (int cpu = 0; cpu < count; ++cpu) {
+    std::vector<EventLoop *> &candidates = cpuLoops_[cpu];
+    auto collect = [&](auto near) {
+      for (EventLoop *loop : loops_) {
+        int c = loop->cpu();
+        if (c >= 0 && c < count && near(c)) {
+          candidates.push_back(loop);
+        }
+      }
+    };
+    collect([&](int c) { return c == cpu; });
+    if (candidates.empty()) {
+      collect([&](int c) {
+        return std::find(siblings[cpu].begin(), siblings[cpu].end(), c) !=
+               siblings[cpu].end();
+      });
+    }
+    if (candidates.empty() && nodes[cpu] >= 0) {
+      collect([&](int c) { return nodes[c] == nodes[cpu]; });
+    }
+    if (candidates.empty() && packages[cpu] >= 0) {
+      collect([&](int c) { return packages[c] == packages[cpu]; });
+    }
+  }
+}
+
+std::vector<EventLoop *> EventLoopThreadPool::getAllLoops() const {
+  if (loops_.empty()) {
+    return {baseLoop_};
+  }
+  return loops_;
+}
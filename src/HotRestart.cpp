@@ -0,0 +1,223 @@
+#include "../include/HotRestart.h"
+#include "../include/Channel.h"
+#include "../include/InetAddress.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static constexpr size_t kHeaderLen = 9;
+
+static bool writeAll(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool readAll(int fd, char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::recv(fd, data, len, 0);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR)
+        continue;
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+// 交接中途失败：关闭已经通过 SCM_RIGHTS 收到的 fd（包括当前这条消息带的 fd），
+// 调用方拿不到它们，不关就泄漏了
+static bool discardState(InheritedState &state, int fd) {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  if (state.listenFd >= 0) {
+    ::close(state.listenFd);
+    state.listenFd = -1;
+  }
+  for (const auto &conn : state.connections) {
+    ::close(conn.fd);
+  }
+  state.connections.clear();
+  return false;
+}
+
+int HotRestart::listenForUpgrade(const std::string &path) {
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    logError(strerror(errno), __func__);
+    return -1;
+  }
+  InetAddress addr = InetAddress::fromUnixPath(path);
+  if (path[0] != '@') {
+    // 旧进程的 socket 文件可能还在，新进程接管后直接替换
+    ::unlink(path.c_str());
+  }
+  if (::bind(fd, addr.getAddr(), addr.getAddrLen()) < 0 ||
+      ::listen(fd, 1) < 0) {
+    logError(strerror(errno), __func__);
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool HotRestart::takeOver(const std::string &path, InheritedState &state,
+                          int timeoutMs) {
+  int sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock < 0) {
+    return false;
+  }
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  ::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  InetAddress addr = InetAddress::fromUnixPath(path);
+  if (::connect(sock, addr.getAddr(), addr.getAddrLen()) < 0) {
+    // 没有旧进程在运行，正常冷启动
+    ::close(sock);
+    return false;
+  }
+  bool ok = recvState(sock, state);
+  ::close(sock);
+  if (ok && state.listenFd < 0) {
+    ok = discardState(state, -1);
+  }
+  if (!ok) {
+    logError("hot restart handoff from " + path + " failed", __func__);
+  }
+  return ok;
+}
+
+bool HotRestart::sendMessage(int sock, char type, int fd,
+                             const std::string &input,
+                             const std::string &output) {
+  char header[kHeaderLen];
+  uint32_t inputLen = static_cast<uint32_t>(input.size());
+  uint32_t outputLen = static_cast<uint32_t>(output.size());
+  header[0] = type;
+  std::memcpy(header + 1, &inputLen, sizeof(inputLen));
+  std::memcpy(header + 5, &outputLen, sizeof(outputLen));
+
+  struct iovec iov;
+  iov.iov_base = header;
+  iov.iov_len = sizeof(header);
+  struct msghdr msg;
+  bzero(&msg, sizeof msg);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  if (fd >= 0) {
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+
+  // 带辅助数据的那一次 sendmsg 必须把头整个发出去
+  ssize_t n;
+  do {
+    n = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    logError(strerror(errno), __func__);
+    return false;
+  }
+  if (static_cast<size_t>(n) < sizeof(header) &&
+      !writeAll(sock, header + n, sizeof(header) - n)) {
+    return false;
+  }
+  return writeAll(sock, input.data(), input.size()) &&
+         writeAll(sock, output.data(), output.size());
+}
+
+bool HotRestart::sendState(int sock, const InheritedState &state) {
+  if (!sendMessage(sock, 'L', state.listenFd, "", "")) {
+    return false;
+  }
+  for (const auto &conn : state.connections) {
+    if (!sendMessage(sock, 'C', conn.fd, conn.input, conn.output)) {
+      return false;
+    }
+  }
+  return sendMessage(sock, 'E', -1, "", "");
+}
+
+bool HotRestart::recvState(int sock, InheritedState &state) {
+  while (true) {
+    char header[kHeaderLen];
+    size_t got = 0;
+    int fd = -1;
+    // 辅助数据跟随头的第一个字节到达
+    while (got < sizeof(header)) {
+      struct iovec iov;
+      iov.iov_base = header + got;
+      iov.iov_len = sizeof(header) - got;
+      alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+      struct msghdr msg;
+      bzero(&msg, sizeof msg);
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      ssize_t n = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+      if (n <= 0) {
+        if (n < 0 && errno == EINTR)
+          continue;
+        return discardState(state, fd);
+      }
+      for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+           cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+          std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+      }
+      got += n;
+    }
+
+    uint32_t inputLen, outputLen;
+    std::memcpy(&inputLen, header + 1, sizeof(inputLen));
+    std::memcpy(&outputLen, header + 5, sizeof(outputLen));
+    std::string input(inputLen, '\0');
+    std::string output(outputLen, '\0');
+    if (!readAll(sock, input.data(), inputLen) ||
+        !readAll(sock, output.data(), outputLen)) {
+      return discardState(state, fd);
+    }
+
+    switch (header[0]) {
+    case 'L':
+      state.listenFd = fd;
+      break;
+    case 'C':
+      state.connections.push_back({fd, std::move(input), std::move(output)});
+      break;
+    case 'E':
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      return true;
+    default:
+      logError("unknown hot restart message", __func__);
+      return discardState(state, fd);
+    }
+  }
+}
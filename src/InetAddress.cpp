@@ -1,33 +1,78 @@
 #include "../include/InetAddress.h"
+#include <algorithm>
+#include <cstddef>
 #include <cstring>
 
 InetAddress::InetAddress(uint16_t port, bool loopbackOnly) {
-  bzero(&addr_, sizeof addr_);
+  bzero(&unix_, sizeof unix_);
   addr_.sin_family = AF_INET;
   addr_.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
   addr_.sin_port = htons(port);
+  len_ = sizeof(addr_);
 }
 
 InetAddress::InetAddress(const std::string &ip, uint16_t port) {
-  bzero(&addr_, sizeof addr_);
+  bzero(&unix_, sizeof unix_);
   addr_.sin_family = AF_INET;
   if (::inet_pton(AF_INET, ip.c_str(), &addr_.sin_addr) <= 0) {
     // Here you should ideally log an error
   }
   addr_.sin_port = htons(port);
+  len_ = sizeof(addr_);
+}
+
+InetAddress InetAddress::fromUnixPath(const std::string &path) {
+  InetAddress addr;
+  bzero(&addr.unix_, sizeof addr.unix_);
+  addr.unix_.sun_family = AF_UNIX;
+  size_t len = std::min(path.size(), sizeof(addr.unix_.sun_path) - 1);
+  std::memcpy(addr.unix_.sun_path, path.data(), len);
+  bool abstract = !path.empty() && path[0] == '@';
+  if (abstract) {
+    addr.unix_.sun_path[0] = '\0';
+  }
+  // 抽象地址的长度不含结尾 '\0'，普通路径包含
+  addr.len_ = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) +
+                                     len + (abstract ? 0 : 1));
+  return addr;
 }
 
 std::string InetAddress::getIp() const {
+  if (isUnix()) {
+    size_t offset = offsetof(struct sockaddr_un, sun_path);
+    if (len_ <= offset) {
+      return ""; // 未命名的 Unix 套接字（例如 accept 得到的客户端）
+    }
+    if (unix_.sun_path[0] == '\0') {
+      return "@" + std::string(unix_.sun_path + 1, len_ - offset - 1);
+    }
+    return unix_.sun_path;
+  }
   char buf[64] = "";
   ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
   return buf;
 }
 
-uint16_t InetAddress::getPort() const { return ntohs(addr_.sin_port); }
+uint16_t InetAddress::getPort() const {
+  return isUnix() ? 0 : ntohs(addr_.sin_port);
+}
+
+std::string InetAddress::toString() const {
+  if (isUnix()) {
+    return "unix:" + getIp();
+  }
+  return getIp() + ":" + std::to_string(getPort());
+}
 
 const struct sockaddr *InetAddress::getAddr() const {
   return static_cast<const struct sockaddr *>(
       static_cast<const void *>(&addr_));
 }
 
-InetAddress::~InetAddress() {}
\ No newline at end of file
+void InetAddress::setAddr(const struct sockaddr *addr, socklen_t len) {
+  bzero(&unix_, sizeof unix_);
+  len_ = std::min<socklen_t>(len, sizeof(unix_));
+  std::memcpy(&unix_, addr, len_);
+}
+
+InetAddress::~InetAddress() {}
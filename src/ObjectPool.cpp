@@ -0,0 +1,104 @@
+#include "../include/ObjectPool.h"
+#include "../include/EventLoop.h"
+#include <new>
+
+FixedBlockPool::FixedBlockPool(size_t maxCached)
+    : blockSize_(0), maxCached_(maxCached) {}
+
+FixedBlockPool::~FixedBlockPool() {
+  for (void *p : free_) {
+    ::operator delete(p);
+  }
+}
+
+/**
+ * @brief 分配一块内存，优先复用缓存的块
+ * @param size
+ * @return
+ */
+void *FixedBlockPool::allocate(size_t size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (blockSize_ == 0) {
+      blockSize_ = size;
+    }
+    if (size == blockSize_ && !free_.empty()) {
+      void *p = free_.back();
+      free_.pop_back();
+      return p;
+    }
+  }
+  return ::operator new(size);
+}
+
+/**
+ * @brief 归还内存，缓存已满或大小不符时直接释放
+ * @param p
+ * @param size
+ */
+void FixedBlockPool::deallocate(void *p, size_t size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size == blockSize_ && free_.size() < maxCached_) {
+      free_.push_back(p);
+      return;
+    }
+  }
+  ::operator delete(p);
+}
+
+size_t FixedBlockPool::cachedBlocks() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return free_.size();
+}
+
+// size 所在的尺寸档，超过最大档返回 -1
+int FrameAllocator::classIndex(size_t size) {
+  size_t block = kMinBlock;
+  for (size_t i = 0; i < kNumClasses; ++i, block <<= 1) {
+    if (size <= block) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+size_t FrameAllocator::blockSize(size_t size) {
+  int index = classIndex(size);
+  return index < 0 ? size : kMinBlock << index;
+}
+
+void *FrameAllocator::allocate(size_t size) {
+  int index = classIndex(size);
+  if (index < 0) {
+    return ::operator new(size);
+  }
+  return pools_[index].allocate(kMinBlock << index);
+}
+
+void FrameAllocator::deallocate(void *p, size_t size) {
+  int index = classIndex(size);
+  if (index < 0) {
+    ::operator delete(p);
+    return;
+  }
+  pools_[index].deallocate(p, kMinBlock << index);
+}
+
+void *FrameAllocator::allocateFrame(size_t size) {
+  EventLoop *loop = EventLoop::current();
+  if (loop == nullptr) {
+    // 帧可能在某个 loop 上结束并进它的池，所以同样按档的大小分配
+    return ::operator new(blockSize(size));
+  }
+  return loop->frameAllocator().allocate(size);
+}
+
+void FrameAllocator::deallocateFrame(void *p, size_t size) {
+  EventLoop *loop = EventLoop::current();
+  if (loop == nullptr) {
+    ::operator delete(p);
+    return;
+  }
+  loop->frameAllocator().deallocate(p, size);
+}
@@ -0,0 +1,54 @@
+#include "../include/RateLimiter.h"
+#include <algorithm>
+
+TokenBucket::TokenBucket(double ratePerSec, double burst)
+    : rate_(ratePerSec), burst_(burst > 0 ? burst : ratePerSec),
+      tokens_(burst_), last_(Clock::now()) {}
+
+void TokenBucket::refill(Clock::time_point now) {
+  if (now <= last_) {
+    return;
+  }
+  double elapsed = std::chrono::duration<double>(now - last_).count();
+  tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+  last_ = now;
+}
+
+void TokenBucket::consume(double n, Clock::time_point now) {
+  if (unlimited()) {
+    return;
+  }
+  refill(now);
+  tokens_ -= n;
+}
+
+/**
+ * @brief 透支的令牌按速率补回所需的时间
+ */
+TokenBucket::Clock::duration
+TokenBucket::deficitDelay(Clock::time_point now) {
+  if (unlimited()) {
+    return Clock::duration::zero();
+  }
+  refill(now);
+  if (tokens_ > 0) {
+    return Clock::duration::zero();
+  }
+  // 等到至少攒够一个令牌，保证恢复后至少能读一次
+  double seconds = (-tokens_ + 1) / rate_;
+  return std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(seconds));
+}
+
+RateLimiter::RateLimiter(const RateLimit &limit)
+    : bytes_(limit.bytesPerSec, limit.bytesBurst),
+      messages_(limit.messagesPerSec, limit.messagesBurst) {}
+
+TokenBucket::Clock::duration RateLimiter::consume(size_t bytes,
+                                                  size_t messages) {
+  TokenBucket::Clock::time_point now = TokenBucket::Clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  bytes_.consume(static_cast<double>(bytes), now);
+  messages_.consume(static_cast<double>(messages), now);
+  return std::max(bytes_.deficitDelay(now), messages_.deficitDelay(now));
+}
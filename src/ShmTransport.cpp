@@ -0,0 +1,305 @@
+#include "../include/ShmTransport.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// 环形缓冲区头部，放在共享内存里。head/tail 为单调递增的字节位置，各占一个
+// cache line，避免读写两端互相踩 cache line
+struct ShmTransport::RingHeader {
+  alignas(64) std::atomic<uint64_t> head;          // 写端推进
+  alignas(64) std::atomic<uint64_t> tail;          // 读端推进
+  alignas(64) std::atomic<uint32_t> writerWaiting; // 写端因环满在等空间
+  std::atomic<uint32_t> writerClosed;              // 写端已关闭
+  // 读端已经（或即将）回到 epoll，写端要通过 eventfd 唤醒它；
+  // 读端处理和自旋期间为 0，写端不发通知
+  std::atomic<uint32_t> readerSleeping;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory ring needs lock-free 64-bit atomics");
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+static size_t roundUpPowerOfTwo(size_t n) {
+  size_t size = 4096;
+  while (size < n) {
+    size <<= 1;
+  }
+  return size;
+}
+
+// 每个环：192 字节头部 + ringSize 字节数据，两个环首尾相接
+static constexpr size_t kRingHeaderSize = 192;
+
+static size_t mappingSizeFor(size_t ringSize) {
+  return 2 * (kRingHeaderSize + ringSize);
+}
+
+bool ShmTransport::createPair(size_t ringSize, ShmEndpoint &a,
+                              ShmEndpoint &b) {
+  ringSize = roundUpPowerOfTwo(ringSize);
+  size_t total = mappingSizeFor(ringSize);
+  int memfd = ::memfd_create("reactor-shm", MFD_CLOEXEC);
+  if (memfd < 0 || ::ftruncate(memfd, static_cast<off_t>(total)) < 0) {
+    logError(strerror(errno), __func__);
+    if (memfd >= 0) {
+      ::close(memfd);
+    }
+    return false;
+  }
+  // 在共享内存里构造两个环的头部
+  void *p =
+      ::mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+  if (p == MAP_FAILED) {
+    logError(strerror(errno), __func__);
+    ::close(memfd);
+    return false;
+  }
+  char *base = static_cast<char *>(p);
+  // 读端 start() 之前还没有在处理，写端的第一批数据要通知它
+  new (base) RingHeader{};
+  new (base + total / 2) RingHeader{};
+  reinterpret_cast<RingHeader *>(base)->readerSleeping.store(1);
+  reinterpret_cast<RingHeader *>(base + total / 2)->readerSleeping.store(1);
+  ::munmap(p, total);
+
+  int fds[6] = {memfd, ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC),
+                ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), -1, -1, -1};
+  if (fds[1] >= 0 && fds[2] >= 0) {
+    fds[3] = ::dup(memfd);
+    fds[4] = ::dup(fds[2]);
+    fds[5] = ::dup(fds[1]);
+  }
+  if (std::any_of(fds, fds + 6, [](int fd) { return fd < 0; })) {
+    logError(strerror(errno), __func__);
+    for (int fd : fds) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    return false;
+  }
+  a = ShmEndpoint{fds[0], fds[1], fds[2], 0, ringSize};
+  b = ShmEndpoint{fds[3], fds[4], fds[5], 1, ringSize};
+  return true;
+}
+
+ShmTransport::ShmTransport(EventLoop *loop, const ShmEndpoint &endpoint)
+    : loop_(loop), endpoint_(endpoint), mapping_(nullptr),
+      mappingSize_(mappingSizeFor(endpoint.ringSize)), tx_(nullptr),
+      txData_(nullptr), rx_(nullptr), rxData_(nullptr),
+      mask_(endpoint.ringSize - 1),
+      channel_(std::make_unique<Channel>(endpoint.notifyFd,
+                                         loop->getPoller())),
+      spinIterations_(0), closed_(false), notifications_(0) {
+  mapping_ = ::mmap(nullptr, mappingSize_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    endpoint_.memfd, 0);
+  if (mapping_ == MAP_FAILED) {
+    logError(strerror(errno), "ShmTransport");
+    exit(EXIT_FAILURE);
+  }
+  static_assert(sizeof(RingHeader) <= kRingHeaderSize);
+  char *ring0 = static_cast<char *>(mapping_);
+  char *ring1 = ring0 + mappingSize_ / 2;
+  char *txRing = endpoint_.side == 0 ? ring0 : ring1;
+  char *rxRing = endpoint_.side == 0 ? ring1 : ring0;
+  tx_ = reinterpret_cast<RingHeader *>(txRing);
+  txData_ = txRing + kRingHeaderSize;
+  rx_ = reinterpret_cast<RingHeader *>(rxRing);
+  rxData_ = rxRing + kRingHeaderSize;
+}
+
+ShmTransport::~ShmTransport() {
+  if (channel_->isInEpoll()) {
+    loop_->getPoller()->removeChannel(channel_.get());
+  }
+  ::munmap(mapping_, mappingSize_);
+  ::close(endpoint_.memfd);
+  ::close(endpoint_.notifyFd);
+  ::close(endpoint_.peerNotifyFd);
+}
+
+void ShmTransport::start() {
+  channel_->setReadCallback([this]() { handleRead(); });
+  channel_->enableReading();
+  // 启动前对端可能已经写了数据
+  loop_->queueInLoop([self = shared_from_this()]() { self->handleRead(); });
+}
+
+void ShmTransport::close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  tx_->writerClosed.store(1, std::memory_order_release);
+  notifyPeer();
+  channel_->disableAll();
+  loop_->getPoller()->removeChannel(channel_.get());
+}
+
+void ShmTransport::send(const std::string &data) {
+  send(data.data(), data.size());
+}
+
+void ShmTransport::send(const char *data, size_t len) {
+  if (loop_->isInLoopThread()) {
+    sendInLoop(data, len);
+  } else {
+    loop_->queueInLoop(
+        [self = shared_from_this(), buf = std::string(data, len)]() {
+          self->sendInLoop(buf.data(), buf.size());
+        });
+  }
+}
+
+void ShmTransport::sendInLoop(const char *data, size_t len) {
+  if (closed_) {
+    return;
+  }
+  // 已经有积压时追加到积压后面，保证顺序
+  if (pending_.readableBytes() == 0) {
+    size_t n = writeRing(data, len);
+    data += n;
+    len -= n;
+  }
+  if (len > 0) {
+    pending_.append(data, len);
+    flushPending();
+  }
+}
+
+// 尽量写入发送环，返回写入的字节数
+size_t ShmTransport::writeRing(const char *data, size_t len) {
+  uint64_t head = tx_->head.load(std::memory_order_relaxed);
+  uint64_t tail = tx_->tail.load(std::memory_order_acquire);
+  size_t capacity = mask_ + 1;
+  size_t n = std::min(len, capacity - static_cast<size_t>(head - tail));
+  if (n == 0) {
+    return 0;
+  }
+  size_t offset = head & mask_;
+  size_t first = std::min(n, capacity - offset);
+  std::memcpy(txData_ + offset, data, first);
+  std::memcpy(txData_, data + first, n - first);
+  tx_->head.store(head + n, std::memory_order_release);
+
+  // 与读端的 "置 readerSleeping -> fence -> 读 head" 配对：要么读端回 epoll
+  // 之前看到新的 head，要么这里看到它要睡了，此时通知对端。清掉标志，
+  // 读端醒来之前的后续写入不再重复通知；读端在处理或自旋时不通知
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (tx_->readerSleeping.load(std::memory_order_relaxed) &&
+      tx_->readerSleeping.exchange(0, std::memory_order_relaxed)) {
+    notifyPeer();
+  }
+  return n;
+}
+
+// 把接收环里的数据全部搬进 inputBuffer_，返回读到的字节数
+size_t ShmTransport::readRing() {
+  size_t total = 0;
+  size_t capacity = mask_ + 1;
+  while (true) {
+    uint64_t tail = rx_->tail.load(std::memory_order_relaxed);
+    uint64_t head = rx_->head.load(std::memory_order_acquire);
+    if (head == tail) {
+      break;
+    }
+    size_t n = static_cast<size_t>(head - tail);
+    size_t offset = tail & mask_;
+    size_t first = std::min(n, capacity - offset);
+    inputBuffer_.ensureWritableBytes(n);
+    std::memcpy(inputBuffer_.beginWrite(), rxData_ + offset, first);
+    std::memcpy(inputBuffer_.beginWrite() + first, rxData_, n - first);
+    inputBuffer_.hasWritten(n);
+    rx_->tail.store(head, std::memory_order_release);
+    total += n;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // 对端因环满在等空间
+    if (rx_->writerWaiting.load(std::memory_order_relaxed)) {
+      rx_->writerWaiting.store(0, std::memory_order_relaxed);
+      notifyPeer();
+    }
+  }
+  return total;
+}
+
+void ShmTransport::handleRead() {
+  if (closed_) {
+    return;
+  }
+  uint64_t count;
+  ssize_t ret = ::read(endpoint_.notifyFd, &count, sizeof(count));
+  (void)ret;
+
+  ShmTransportPtr guardThis(shared_from_this());
+  // 醒着的时候对端写入不用发 eventfd
+  rx_->readerSleeping.store(0, std::memory_order_relaxed);
+  // 自己的发送环可能刚被对端腾出空间
+  flushPending();
+  // 读空之后再自旋一会儿，期间来的数据对端也不发 eventfd
+  int spins = 0;
+  while (true) {
+    if (readRing() > 0) {
+      if (messageCallback_) {
+        messageCallback_(guardThis, inputBuffer_);
+      }
+      spins = 0;
+    } else if (spins++ < spinIterations_) {
+      cpuRelax();
+    } else {
+      // 回 epoll 之前登记睡眠，再检查一次：置位之前写入的数据对端不会通知
+      rx_->readerSleeping.store(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (rx_->head.load(std::memory_order_relaxed) ==
+          rx_->tail.load(std::memory_order_relaxed)) {
+        break;
+      }
+      rx_->readerSleeping.store(0, std::memory_order_relaxed);
+      spins = 0;
+    }
+  }
+  if (inputBuffer_.readableBytes() == 0) {
+    inputBuffer_.release();
+  }
+
+  if (rx_->writerClosed.load(std::memory_order_acquire) && !closed_) {
+    close();
+    if (closeCallback_) {
+      closeCallback_(guardThis);
+    }
+  }
+}
+
+void ShmTransport::flushPending() {
+  while (pending_.readableBytes() > 0) {
+    size_t n = writeRing(pending_.peek(), pending_.readableBytes());
+    pending_.retrieve(n);
+    if (n == 0) {
+      // 环满：登记等待，对端读走数据后会通过 eventfd 唤醒我们
+      tx_->writerWaiting.store(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      uint64_t head = tx_->head.load(std::memory_order_relaxed);
+      if (head - tx_->tail.load(std::memory_order_relaxed) == mask_ + 1) {
+        return;
+      }
+      tx_->writerWaiting.store(0, std::memory_order_relaxed);
+    }
+  }
+  pending_.release();
+}
+
+void ShmTransport::notifyPeer() {
+  uint64_t one = 1;
+  ssize_t n = ::write(endpoint_.peerNotifyFd, &one, sizeof(one));
+  (void)n;
+  ++notifications_;
+}
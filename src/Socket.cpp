@@ -8,8 +8,12 @@
 #include <sys/types.h>
 #include <unistd.h>
 
-int createNonblockingSocket() {
-  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, IPPROTO_TCP);
+int createNonblockingSocket(int family, int type) {
+  int protocol = 0;
+  if (family != AF_UNIX) {
+    protocol = type == SOCK_DGRAM ? IPPROTO_UDP : IPPROTO_TCP;
+  }
+  int fd = ::socket(family, type | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
   if (fd == -1) {
     std::cerr << __FILE__ << ":" << __LINE__ << " " << __func__ << " "
               << strerror(errno) << std::endl;
@@ -45,51 +49,148 @@ void Socket::setKeepAlive(bool on) {
   ::setsockopt(fd_, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt));
 }
 
-void Socket::bind(const InetAddress &addr) {
-  if (::bind(fd_, addr.getAddr(), sizeof(struct sockaddr_in)) == -1) {
-    std::cerr << __FILE__ << ":" << __LINE__ << " " << __func__ << " "
+// 设置一个 int 类型的选项，失败时打印选项名和错误
+static bool setIntOption(int fd, int level, int name, int value,
+                         const char *what) {
+  if (::setsockopt(fd, level, name, &value, sizeof(value)) == -1) {
+    std::cerr << __FILE__ << ":" << __LINE__ << " " << what << " "
               << strerror(errno) << std::endl;
-    exit(EXIT_FAILURE);
+    return false;
+  }
+  return true;
+}
+
+bool Socket::setRecvBufferSize(int bytes) {
+  return setIntOption(fd_, SOL_SOCKET, SO_RCVBUF, bytes, "SO_RCVBUF");
+}
+
+bool Socket::setSendBufferSize(int bytes) {
+  return setIntOption(fd_, SOL_SOCKET, SO_SNDBUF, bytes, "SO_SNDBUF");
+}
+
+bool Socket::setUserTimeout(int ms) {
+  return setIntOption(fd_, IPPROTO_TCP, TCP_USER_TIMEOUT, ms,
+                      "TCP_USER_TIMEOUT");
+}
+
+bool Socket::setNotSentLowat(int bytes) {
+  return setIntOption(fd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, bytes,
+                      "TCP_NOTSENT_LOWAT");
+}
+
+bool Socket::setQuickAck(bool on) {
+  return setIntOption(fd_, IPPROTO_TCP, TCP_QUICKACK, on ? 1 : 0,
+                      "TCP_QUICKACK");
+}
+
+bool Socket::setFastOpen(int queueLen) {
+  if (!setIntOption(fd_, IPPROTO_TCP, TCP_FASTOPEN, queueLen,
+                    "TCP_FASTOPEN")) {
+    return false;
+  }
+  // 选项本身总能设置成功，服务端是否真的启用 TFO 由 sysctl 决定
+  FILE *fp = ::fopen("/proc/sys/net/ipv4/tcp_fastopen", "r");
+  int mode = 0;
+  if (fp != nullptr) {
+    if (::fscanf(fp, "%d", &mode) != 1) {
+      mode = 0;
+    }
+    ::fclose(fp);
+  }
+  if (!(mode & 2)) {
+    std::cerr << __FILE__ << ":" << __LINE__ << " " << __func__
+              << " net.ipv4.tcp_fastopen=" << mode
+              << ", server side fast open is disabled" << std::endl;
+  }
+  return true;
+}
+
+bool Socket::setDeferAccept(int seconds) {
+  return setIntOption(fd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, seconds,
+                      "TCP_DEFER_ACCEPT");
+}
+
+bool Socket::setIncomingCpu(int cpu) {
+  return setIntOption(fd_, SOL_SOCKET, SO_INCOMING_CPU, cpu,
+                      "SO_INCOMING_CPU");
+}
+
+bool Socket::tryBind(const InetAddress &addr) {
+  if (addr.isUnix() && addr.getIp()[0] != '@') {
+    // 上次运行留下的 socket 文件会让 bind 失败
+    ::unlink(addr.getIp().c_str());
   }
+  if (::bind(fd_, addr.getAddr(), addr.getAddrLen()) == -1) {
+    std::cerr << __FILE__ << ":" << __LINE__ << " " << __func__ << " "
+              << addr.toString() << ": " << strerror(errno) << std::endl;
+    return false;
+  }
+  return true;
 }
 
-void Socket::listen() {
-  if (::listen(fd_, SOMAXCONN) == -1) {
+bool Socket::tryListen(int backlog) {
+  if (::listen(fd_, backlog) == -1) {
     std::cerr << __FILE__ << ":" << __LINE__ << " " << __func__ << " "
               << strerror(errno) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void Socket::bind(const InetAddress &addr) {
+  if (!tryBind(addr)) {
+    exit(EXIT_FAILURE);
+  }
+}
+
+void Socket::listen(int backlog) {
+  if (!tryListen(backlog)) {
     exit(EXIT_FAILURE);
   }
 }
 
 int Socket::accept(InetAddress &addr) {
-  struct sockaddr_in client_addr;
+  struct sockaddr_storage client_addr;
   socklen_t len = sizeof(client_addr);
   int connfd = ::accept4(fd_, (struct sockaddr *)&client_addr, &len,
                          SOCK_NONBLOCK | SOCK_CLOEXEC);
   if (connfd >= 0) {
-    addr.setAddr(client_addr);
+    addr.setAddr((struct sockaddr *)&client_addr, len);
   }
   return connfd;
 }
 
-struct sockaddr_in Socket::getLocalAddr(int sockfd) {
-  struct sockaddr_in localaddr;
+InetAddress Socket::getLocalAddr(int sockfd) {
+  struct sockaddr_storage localaddr;
   bzero(&localaddr, sizeof localaddr);
   socklen_t addrlen = sizeof(localaddr);
   if (::getsockname(sockfd, (struct sockaddr *)&localaddr, &addrlen) < 0) {
     std::cerr << __FILE__ << ":" << __LINE__ << " " << __func__ << " "
               << strerror(errno) << std::endl;
   }
-  return localaddr;
-  }
+  InetAddress addr;
+  addr.setAddr((struct sockaddr *)&localaddr, addrlen);
+  return addr;
+}
 
-struct sockaddr_in Socket::getPeerAddr(int sockfd) {
-  struct sockaddr_in peeraddr;
+InetAddress Socket::getPeerAddr(int sockfd) {
+  struct sockaddr_storage peeraddr;
   bzero(&peeraddr, sizeof peeraddr);
   socklen_t addrlen = sizeof(peeraddr);
   if (::getpeername(sockfd, (struct sockaddr *)&peeraddr, &addrlen) < 0) {
     std::cerr << __FILE__ << ":" << __LINE__ << " " << __func__ << " "
               << strerror(errno) << std::endl;
   }
-  return peeraddr;
-}
\ No newline at end of file
+  InetAddress addr;
+  addr.setAddr((struct sockaddr *)&peeraddr, addrlen);
+  return addr;
+}
+
+int Socket::getIncomingCpu(int sockfd) {
+  int cpu = -1;
+  socklen_t len = sizeof(cpu);
+  if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0) {
+    return -1;
+  }
+  return cpu;
+}
@@ -0,0 +1,105 @@
+#include "../include/TcpClient.h"
+#include "../include/Socket.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+TcpClient::TcpClient(EventLoop *loop, const InetAddress &serverAddr,
+                     const std::string &name)
+    : loop_(loop), serverAddr_(serverAddr), name_(name), connectingFd_(-1),
+      connectionCallback_(nullptr), messageCallback_(nullptr),
+      writeCompleteCallback_(nullptr) {}
+
+TcpClient::~TcpClient() {
+  if (connectingFd_ >= 0) {
+    loop_->getPoller()->removeChannel(connectChannel_.get());
+    ::close(connectingFd_);
+  }
+}
+
+void TcpClient::connect() {
+  if (loop_->isInLoopThread()) {
+    connectInLoop();
+  } else {
+    loop_->queueInLoop([this]() { connectInLoop(); });
+  }
+}
+
+void TcpClient::disconnect() {
+  TcpConnectionPtr conn = connection();
+  if (conn) {
+    conn->shutdown();
+  }
+}
+
+TcpConnectionPtr TcpClient::connection() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return connection_;
+}
+
+void TcpClient::connectInLoop() {
+  int fd = createNonblockingSocket(serverAddr_.family());
+  int ret = ::connect(fd, serverAddr_.getAddr(), serverAddr_.getAddrLen());
+  // Unix 域套接字可能直接连上（ret == 0），TCP 一般是 EINPROGRESS，统一等可写
+  if (ret < 0 && errno != EINPROGRESS && errno != EAGAIN) {
+    logError("connect " + serverAddr_.toString() + ": " + strerror(errno),
+             "connectInLoop");
+    ::close(fd);
+    return;
+  }
+  connectingFd_ = fd;
+  connectChannel_ = std::make_unique<Channel>(fd, loop_->getPoller());
+  connectChannel_->setWriteCallback([this]() { handleConnected(); });
+  connectChannel_->enableWriting();
+}
+
+void TcpClient::handleConnected() {
+  int fd = connectingFd_;
+  connectChannel_->disableAll();
+  loop_->getPoller()->removeChannel(connectChannel_.get());
+  connectingFd_ = -1;
+  // 正在 connectChannel_ 的回调里，不能立刻析构它
+  loop_->queueInLoop([this]() { connectChannel_.reset(); });
+
+  int err = 0;
+  socklen_t len = sizeof(err);
+  ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+  if (err != 0) {
+    logError("connect " + serverAddr_.toString() + ": " + strerror(err),
+             "handleConnected");
+    ::close(fd);
+    return;
+  }
+
+  auto conn = std::allocate_shared<TcpConnection>(
+      PoolAllocator<TcpConnection>(loop_->connectionPool()), loop_, name_, fd,
+      Socket::getLocalAddr(fd), serverAddr_);
+  conn->setConnectionCallback(connectionCallback_);
+  conn->setMessageCallback(messageCallback_);
+  conn->setWriteCompleteCallback(writeCompleteCallback_);
+  conn->setCloseCallback(
+      [this](const TcpConnectionPtr &c) { removeConnection(c); });
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connection_ = conn;
+  }
+  if (!serverAddr_.isUnix()) {
+    conn->setTcpNoDelay(true);
+  }
+  if (tlsContext_) {
+    conn->startTls(tlsContext_, false, tlsServerName_);
+  }
+  if (compression_) {
+    conn->enableCompression(*compression_, false);
+  }
+  conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr &conn) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connection_.reset();
+  }
+  loop_->queueInLoop([conn]() { conn->connectDestroyed(); });
+}
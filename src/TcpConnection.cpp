@@ -1,66 +1,615 @@
 #include "../include/TcpConnection.h"
+#include "../include/Trace.h"
+#include <algorithm>
 #include <cstring>
+#include <utility>
 
 TcpConnection::TcpConnection(EventLoop *loop, const std::string &name,
                              int connfd, const InetAddress &localAddr,
                              const InetAddress &peerAddr)
     : loop_(loop), name_(name), state_(kDisconnected),
-      socket_(std::make_unique<Socket>(connfd)),
-      channel_(std::make_unique<Channel>(connfd, loop->getPoller())),
+      socket_(connfd), channel_(connfd, loop->getPoller()),
       localAddr_(localAddr), peerAddr_(peerAddr), connectionCallback_(nullptr),
       messageCallback_(nullptr), writeCompleteCallback_(nullptr),
-      closeCallback_(nullptr), inputBuffer_(), outputBuffer_() {
+      closeCallback_(nullptr), highWaterMarkCallback_(nullptr),
+      inputBuffer_(), outputBuffer_(), highWaterMark_(64 * 1024 * 1024),
+      reading_(false), readPausedByWaterMark_(false), inputHighWaterMark_(0),
+      inputLowWaterMark_(0), readBudgetBytes_(0), readBudgetReads_(0),
+      readScheduled_(false), closed_(false), writeFailed_(false),
+      readPausedByRateLimit_(false),
+      rateLimitTimer_(0), corked_(false),
+      corkThreshold_(kDefaultCorkThreshold), flushScheduled_(false),
+      captureId_(0), readWaiter_(nullptr), writeWaiter_(nullptr),
+      migrating_(false), activity_(0) {
   log("TcpConnection created", "TcpConnection");
 }
 
 TcpConnection::~TcpConnection() {}
 
 void TcpConnection::connectEstablished() {
-  setState(kConnected);
-  channel_->setReadCallback([this]() { handleRead(); });
-  channel_->setCloseCallback([this]() { handleClose(); });
-  channel_->setWriteCallback([this]() { handleWrite(); });
+  // TLS 连接握手完成之前处于 kConnecting，不能 send，也不回调用户
+  setState(tls_ ? kConnecting : kConnected);
+  channel_.setReadCallback([this]() { handleRead(); });
+  channel_.setCloseCallback([this]() { handleClose(); });
+  channel_.setWriteCallback([this]() { handleWrite(); });
   // 这里面会调用epoll_ctl(EPOLL_CTL_ADD)，把fd加入到epoll红黑树里面
-  channel_->useEdgeTrigger(true);
-  channel_->enableReading();
+  channel_.useEdgeTrigger(true);
+  if (capture_) {
+    captureId_ = capture_->openConnection(peerAddr_.toString());
+  }
+  reading_ = true;
+  channel_.enableReading();
+  if (tls_) {
+    // 客户端这里发出 ClientHello，服务端多半先得到 WANT_READ
+    handleHandshake();
+    return;
+  }
+  startCompression();
   // 第一次调用时候进入这个回调，这个回调来自main
   // 以后直接调用handleRead()，就是下面的handleRead()回调
-  connectionCallback_(shared_from_this());
+  TcpConnectionPtr guardThis(shared_from_this());
+  connectionCallback_(guardThis);
+  // 热重启接管的连接可能带着旧进程没处理完的数据
+  if (outputBuffer_.readableBytes() > 0) {
+    channel_.enableWriting();
+  }
+  if (inputBuffer_.readableBytes() > 0) {
+    deliverInput(guardThis);
+  }
 }
 
 void TcpConnection::connectDestroyed() {
-  if (state_ == kConnected) {
+  // handleClose 已经把状态改成 kDisconnecting，这里同样要通知连接断开
+  if (state_ == kConnected || state_ == kDisconnecting) {
     setState(kDisconnected);
-    channel_->disableAll();
+    channel_.disableAll();
 
     connectionCallback_(shared_from_this());
   }
-  loop_->getPoller()->removeChannel(channel_.get());
+  if (rateLimitTimer_ != 0) {
+    getLoop()->cancelTimer(std::exchange(rateLimitTimer_, 0));
+  }
+  if (captureId_ != 0) {
+    capture_->closeConnection(std::exchange(captureId_, 0));
+  }
+  getLoop()->getPoller()->removeChannel(&channel_);
+}
+
+void TcpConnection::setRateLimit(const RateLimit &limit,
+                                 const std::shared_ptr<RateLimiter> &shared) {
+  rateLimiter_ =
+      limit.enabled() ? std::make_unique<RateLimiter>(limit) : nullptr;
+  sharedRateLimiter_ = shared;
+}
+
+bool TcpConnection::detachForHandoff(InheritedConnection &out) {
+  // TLS 会话和压缩流的状态无法随 fd 交出，这类连接留在旧进程里处理完；
+  // 正在迁移到别的 loop 的连接同样留下
+  if (state_ != kConnected || tls_ || codec_ || !inOwnerLoop()) {
+    return false;
+  }
+  channel_.disableAll();
+  getLoop()->getPoller()->removeChannel(&channel_);
+  // 新进程收到 fd 之前，这份 dup 保证 socket 不会因为本对象析构而被关闭
+  out.fd = ::dup(socket_.getFd());
+  out.input = inputBuffer_.retrieveAllAsString();
+  out.output = outputBuffer_.retrieveAllAsString();
+  // 连接交给新进程后不再回调 connectionCallback_
+  setState(kDisconnected);
+  return out.fd >= 0;
+}
+
+void TcpConnection::queueInOwnerLoop(std::function<void()> task) {
+  std::lock_guard<std::mutex> lock(migrationMutex_);
+  // 持锁读 loop_：迁移结束时先换 loop_ 再在锁内清 migrating_，
+  // 这里看到 migrating_ 为 false 时 loop_ 已经是新 loop
+  if (migrating_.load(std::memory_order_relaxed)) {
+    migrationBacklog_.push_back(std::move(task));
+  } else {
+    getLoop()->queueInLoop(std::move(task));
+  }
+}
+
+void TcpConnection::migrateTo(EventLoop *newLoop, MigrateCallback detached,
+                              MigrateCallback attached) {
+  queueInOwnerLoop([self = shared_from_this(), newLoop,
+                    detached = std::move(detached),
+                    attached = std::move(attached)]() {
+    self->startMigration(newLoop, detached, attached);
+  });
+}
+
+/**
+ * @brief 在原 loop 线程上开始迁移：置位 migrating_ 之后新投递的任务都进积压
+ * 队列，之前已经投递到原 loop 的任务排在摘下连接的任务前面，先执行完
+ */
+void TcpConnection::startMigration(EventLoop *newLoop,
+                                   const MigrateCallback &detached,
+                                   const MigrateCallback &attached) {
+  if (newLoop == nullptr || newLoop == getLoop() || state_ != kConnected ||
+      migrating()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(migrationMutex_);
+    migrating_.store(true, std::memory_order_release);
+  }
+  getLoop()->queueInLoop(
+      [self = shared_from_this(), newLoop, detached, attached]() {
+        self->detachForMigration(newLoop, detached, attached);
+      });
+}
+
+/**
+ * @brief 在原 loop 线程上把连接从 epoll 摘下，交给新 loop
+ *
+ * 就绪队列和 beforePoll 队列里这个连接的任务（读预算用完、写合并）留在原 loop
+ * 上会作废：攒下的数据在这里写出，排着的读到新 loop 上重新排。连接已经关闭
+ * 或者有协程在等待（协程要在原 loop 上恢复）时放弃迁移。
+ */
+void TcpConnection::detachForMigration(EventLoop *newLoop,
+                                       const MigrateCallback &detached,
+                                       const MigrateCallback &attached) {
+  if (closed_ || state_ != kConnected || readWaiter_ != nullptr ||
+      writeWaiter_ != nullptr) {
+    finishMigration();
+    return;
+  }
+  if (flushScheduled_) {
+    flushCorked();
+  }
+  bool readPending = std::exchange(readScheduled_, false);
+  // 限速暂停的状态保留，到新 loop 上重新定时
+  if (rateLimitTimer_ != 0) {
+    getLoop()->cancelTimer(std::exchange(rateLimitTimer_, 0));
+  }
+  channel_.disableAll();
+  getLoop()->getPoller()->removeChannel(&channel_);
+  TcpConnectionPtr guardThis(shared_from_this());
+  if (detached) {
+    detached(guardThis);
+  }
+  loop_.store(newLoop, std::memory_order_release);
+  channel_.setPoller(newLoop->getPoller());
+  newLoop->queueInLoop([guardThis, attached, readPending]() {
+    guardThis->attachAfterMigration(attached, readPending);
+  });
+}
+
+// 在新 loop 线程上重新注册。边缘触发下 EPOLL_CTL_ADD 会为内核里
+// 已有的数据报一次事件，迁移期间到达的数据不会漏掉
+void TcpConnection::attachAfterMigration(const MigrateCallback &attached,
+                                         bool readPending) {
+  channel_.useEdgeTrigger(true);
+  if (reading_) {
+    channel_.enableReading();
+  }
+  if (outputBuffer_.readableBytes() > 0) {
+    channel_.enableWriting();
+  }
+  if (attached) {
+    attached(shared_from_this());
+  }
+  finishMigration();
+  if (readPausedByRateLimit_) {
+    // 令牌还没补回来时 handleRead 开头会重新暂停并定时
+    resumeAfterThrottle();
+  }
+  // 读预算用完时 socket 里还有数据，边缘触发不会再报事件
+  if (readPending && reading_) {
+    scheduleRead();
+  }
+}
+
+// 结束迁移（或放弃迁移），按投递顺序执行迁移期间积压的任务
+void TcpConnection::finishMigration() {
+  std::vector<std::function<void()>> backlog;
+  {
+    std::lock_guard<std::mutex> lock(migrationMutex_);
+    migrating_.store(false, std::memory_order_release);
+    backlog.swap(migrationBacklog_);
+  }
+  for (const auto &task : backlog) {
+    task();
+  }
+}
+
+void TcpConnection::startTls(const std::shared_ptr<TlsContext> &ctx,
+                              bool isServer, const std::string &serverName) {
+  tls_ = std::make_unique<TlsSession>(ctx, socket_.getFd(), isServer,
+                                      serverName);
+}
+
+/**
+ * @brief 推进 TLS 握手。完成后进入 kConnected 并回调 connectionCallback_，
+ * 握手报文里可能已经带着应用数据，边缘触发不会再通知，需要立即读一次
+ */
+void TcpConnection::handleHandshake() {
+  switch (tls_->handshake()) {
+  case TlsSession::kOk:
+    break;
+  case TlsSession::kWantRead:
+    if (channel_.isWriting()) {
+      channel_.disableWriting();
+    }
+    return;
+  case TlsSession::kWantWrite:
+    if (!channel_.isWriting()) {
+      channel_.enableWriting();
+    }
+    return;
+  default:
+    logError("TLS handshake failed with " + peerAddr_.toString(),
+             "handleHandshake");
+    handleClose();
+    return;
+  }
+
+  setState(kConnected);
+  if (channel_.isWriting()) {
+    channel_.disableWriting();
+  }
+  startCompression();
+  TcpConnectionPtr guardThis(shared_from_this());
+  connectionCallback_(guardThis);
+  if (state_ == kConnected) {
+    handleRead();
+  }
+}
+
+// 明文连接直接 readv；TLS 连接读解密后的数据，凑不出完整记录时按 EAGAIN 处理
+ssize_t TcpConnection::readInput() {
+  if (!tls_) {
+    return inputBuffer_.readFd(socket_.getFd());
+  }
+  size_t n = 0;
+  switch (tls_->read(inputBuffer_, kTlsReadChunk, n)) {
+  case TlsSession::kOk:
+    return static_cast<ssize_t>(n);
+  case TlsSession::kWantRead:
+  case TlsSession::kWantWrite:
+    errno = EAGAIN;
+    return -1;
+  default:
+    // 收到 close_notify、对端断开或者协议错误，都按连接关闭处理
+    return 0;
+  }
+}
+
+// 内核接管了 TLS 发送方向（kTLS）之后明文直接写 socket，否则由 OpenSSL 加密
+ssize_t TcpConnection::writeOutput(const char *data, size_t len) {
+  if (!tls_ || tls_->ktlsSend()) {
+    return ::send(socket_.getFd(), data, len, MSG_NOSIGNAL);
+  }
+  size_t n = 0;
+  switch (tls_->write(data, len, n)) {
+  case TlsSession::kOk:
+    return static_cast<ssize_t>(n);
+  case TlsSession::kWantRead:
+  case TlsSession::kWantWrite:
+    errno = EWOULDBLOCK;
+    return -1;
+  default:
+    errno = EPIPE;
+    return -1;
+  }
+}
+
+void TcpConnection::restoreBuffers(const std::string &input,
+                                   const std::string &output) {
+  inputBuffer_.append(input.data(), input.size());
+  outputBuffer_.append(output.data(), output.size());
 }
 
 void TcpConnection::send(const std::string &buf) {
   if (state_ == kConnected) {
-    if (loop_->isInLoopThread()) {
+    if (inOwnerLoop()) {
       sendInLoop(buf);
     } else {
-      loop_->queueInLoop([this, buf]() { sendInLoop(buf); });
+      queueInOwnerLoop([this, buf]() { sendInLoop(buf); });
+    }
+  }
+}
+
+void TcpConnection::send(const SharedPayload &payload) {
+  if (state_ == kConnected) {
+    if (inOwnerLoop()) {
+      sendInLoop(payload->data(), payload->size());
+    } else {
+      queueInOwnerLoop([self = shared_from_this(), payload]() {
+        self->sendInLoop(payload->data(), payload->size());
+      });
     }
   }
 }
 
 void TcpConnection::sendInLoop(const std::string &buf) {
-  ::send(socket_->getFd(), buf.c_str(), buf.size(), 0);
-  log("Sent " + std::to_string(buf.size()) + " bytes to client", "handleData");
+  sendInLoop(buf.data(), buf.size());
+}
+
+void TcpConnection::sendInLoop(const char *data, size_t len) {
+  if (state_ != kConnected) {
+    return;
+  }
+  if (codec_ && codec_->active()) {
+    const std::string &frame = codec_->encode(data, len);
+    // 协商还没完成时数据缓存在 codec 里
+    if (!frame.empty()) {
+      writeInLoop(frame.data(), frame.size());
+    }
+    return;
+  }
+  writeInLoop(data, len);
+}
+
+void TcpConnection::writeInLoop(const char *data, size_t len) {
+  TRACE_SCOPE("sendInLoop", len);
+  if (writeFailed_) {
+    return;
+  }
+  if (corked_) {
+    size_t oldLen = outputBuffer_.readableBytes();
+    if (oldLen + len >= highWaterMark_ && oldLen < highWaterMark_ &&
+        highWaterMarkCallback_) {
+      queueInOwnerLoop([self = shared_from_this(), n = oldLen + len]() {
+        self->highWaterMarkCallback_(self, n);
+      });
+    }
+    outputBuffer_.append(data, len);
+    // 已经在等 EPOLLOUT 时由 handleWrite 写出
+    if (channel_.isWriting()) {
+      return;
+    }
+    if (outputBuffer_.readableBytes() >= corkThreshold_) {
+      flushCorked();
+    } else if (!flushScheduled_) {
+      flushScheduled_ = true;
+      getLoop()->queueBeforePoll([self = shared_from_this()]() {
+        // 连接已经迁到别的 loop 时作废，摘下时已经写出
+        if (self->getLoop()->isInLoopThread()) {
+          self->flushCorked();
+        }
+      });
+    }
+    return;
+  }
+  ssize_t nwrote = 0;
+  size_t remaining = len;
+  // 输出缓冲区为空时直接写 socket，写不完的部分放进 outputBuffer_
+  if (!channel_.isWriting() && outputBuffer_.readableBytes() == 0) {
+    nwrote = writeOutput(data, len);
+    if (nwrote >= 0) {
+      activity_ += nwrote;
+      remaining = len - nwrote;
+      log("Sent " + std::to_string(nwrote) + " bytes to client", "handleData");
+      if (remaining == 0 && writeCompleteCallback_) {
+        queueInOwnerLoop([self = shared_from_this()]() {
+          self->writeCompleteCallback_(self);
+        });
+      }
+    } else {
+      nwrote = 0;
+      if (checkWriteError("sendInLoop")) {
+        return;
+      }
+    }
+  }
+
+  if (remaining > 0) {
+    size_t oldLen = outputBuffer_.readableBytes();
+    if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ &&
+        highWaterMarkCallback_) {
+      queueInOwnerLoop([self = shared_from_this(), n = oldLen + remaining]() {
+        self->highWaterMarkCallback_(self, n);
+      });
+    }
+    outputBuffer_.append(data + nwrote, remaining);
+    if (!channel_.isWriting()) {
+      channel_.enableWriting();
+    }
+  }
+}
+
+void TcpConnection::shutdown() {
+  if (state_ == kConnected) {
+    setState(kDisconnecting);
+    queueInOwnerLoop([self = shared_from_this()]() {
+      self->shutdownInLoop();
+    });
+  }
+}
+
+// 输出缓冲区还有数据时先不关写端，等 handleWrite 发完再关
+void TcpConnection::forceClose() {
+  if (state_ == kConnected || state_ == kDisconnecting) {
+    setState(kDisconnecting);
+    queueInOwnerLoop([self = shared_from_this()]() {
+      // 可能已经因为对端关闭走过 handleClose
+      if (!self->closed_) {
+        self->outputBuffer_.retrieveAll();
+        self->handleClose();
+      }
+    });
+  }
+}
+
+void TcpConnection::shutdownInLoop() {
+  // 写合并模式下缓冲区里可能还有没写出的数据，写完后由 outputDrained 再来关闭；
+  // 压缩协商完成前缓存的数据由 decodeInput 发出后再来关闭
+  if (!channel_.isWriting() && outputBuffer_.readableBytes() == 0 &&
+      !(codec_ && codec_->hasPending())) {
+    if (tls_) {
+      tls_->shutdown();
+    }
+    ::shutdown(socket_.getFd(), SHUT_WR);
+  }
+}
+
+// 用户主动暂停优先于限速：取消等待中的恢复定时器，免得它把读重新打开
+void TcpConnection::stopRead() {
+  auto stop = [](TcpConnection *conn) {
+    conn->readPausedByWaterMark_ = false;
+    conn->readPausedByRateLimit_ = false;
+    if (conn->rateLimitTimer_ != 0) {
+      conn->getLoop()->cancelTimer(std::exchange(conn->rateLimitTimer_, 0));
+    }
+    conn->stopReadInLoop();
+  };
+  if (inOwnerLoop()) {
+    stop(this);
+  } else {
+    queueInOwnerLoop(
+        [self = shared_from_this(), stop]() { stop(self.get()); });
+  }
+}
+
+// 限速暂停中的连接不在这里恢复，等令牌补回来由定时器恢复
+void TcpConnection::startRead() {
+  if (inOwnerLoop()) {
+    readPausedByWaterMark_ = false;
+    if (!readPausedByRateLimit_) {
+      startReadInLoop();
+    }
+  } else {
+    queueInOwnerLoop([self = shared_from_this()]() {
+      self->readPausedByWaterMark_ = false;
+      if (!self->readPausedByRateLimit_) {
+        self->startReadInLoop();
+      }
+    });
+  }
+}
+
+void TcpConnection::stopReadInLoop() {
+  if (state_ == kConnected && reading_) {
+    reading_ = false;
+    channel_.disableReading();
+  }
+}
+
+// 重新关注 EPOLLIN，边缘触发下 EPOLL_CTL_MOD 会为内核里已有的数据再报一次事件
+void TcpConnection::startReadInLoop() {
+  if (state_ == kConnected && !reading_) {
+    reading_ = true;
+    channel_.enableReading();
+  }
+}
+
+void TcpConnection::retrieveInput(size_t len) {
+  userInput().retrieve(len);
+  checkInputWaterMarks();
+}
+
+void TcpConnection::checkInputWaterMarks() {
+  if (inputHighWaterMark_ == 0) {
+    return;
+  }
+  size_t readable = inputBuffer_.readableBytes();
+  if (reading_ && readable >= inputHighWaterMark_) {
+    readPausedByWaterMark_ = true;
+    stopReadInLoop();
+  } else if (readPausedByWaterMark_ && readable <= inputLowWaterMark_) {
+    readPausedByWaterMark_ = false;
+    if (!readPausedByRateLimit_) {
+      startReadInLoop();
+    }
+  }
+}
+
+// 回调里透支时暂停读，handleRead 的循环看到 reading_ 为 false 后停下
+void TcpConnection::countMessages(size_t n) {
+  if ((rateLimiter_ || sharedRateLimiter_) && n > 0) {
+    throttleRead(0, n);
+  }
+}
+
+/**
+ * @brief 按读到的量记账，令牌透支时暂停读，并定时在令牌补回后恢复
+ *
+ * 先读后记账，一次最多超额一次读的量（readv 上限），之后的暂停会把它还回来。
+ * 暂停期间数据留在内核接收缓冲区，窗口填满后由 TCP 反压对端。
+ * @return 是否已暂停
+ */
+bool TcpConnection::throttleRead(size_t bytes, size_t messages) {
+  TokenBucket::Clock::duration delay = TokenBucket::Clock::duration::zero();
+  if (rateLimiter_) {
+    delay = rateLimiter_->consume(bytes, messages);
+  }
+  if (sharedRateLimiter_) {
+    delay = std::max(delay, sharedRateLimiter_->consume(bytes, messages));
+  }
+  if (delay <= TokenBucket::Clock::duration::zero()) {
+    return false;
+  }
+  readPausedByRateLimit_ = true;
+  stopReadInLoop();
+  if (rateLimitTimer_ == 0) {
+    std::weak_ptr<TcpConnection> weakThis = weak_from_this();
+    rateLimitTimer_ = getLoop()->runAfter(delay, [weakThis]() {
+      if (TcpConnectionPtr self = weakThis.lock()) {
+        self->resumeAfterThrottle();
+      }
+    });
+  }
+  return true;
+}
+
+void TcpConnection::resumeAfterThrottle() {
+  rateLimitTimer_ = 0;
+  if (!readPausedByRateLimit_) {
+    return;
+  }
+  readPausedByRateLimit_ = false;
+  if (readPausedByWaterMark_) {
+    return;
+  }
+  startReadInLoop();
+  // TLS 库里可能还留着已解密的数据，epoll 不会为它报事件
+  if (tls_) {
+    scheduleRead();
+  }
 }
 
 void TcpConnection::handleRead() {
-  // 循环读取数据，直到读取到0，或者读取到错误
-  while (true) {
-    ssize_t bytes_read = inputBuffer_.readFd(socket_->getFd());
+  if (state_ == kConnecting) {
+    handleHandshake();
+    return;
+  }
+  // 整个读事件只取一次引用，避免每读一块就做一对原子加减
+  TcpConnectionPtr guardThis(shared_from_this());
+  size_t bytesThisRound = 0;
+  int readsThisRound = 0;
+  bool limited = rateLimiter_ || sharedRateLimiter_;
+  // 共享限额可能已被其他连接用光，读之前先看一眼
+  if (limited && throttleRead(0, 0)) {
+    return;
+  }
+  // 循环读取数据，直到读取到0，或者读取到错误，或者读被暂停
+  while (reading_) {
+    // 预算用完时 socket 里可能还有数据，边缘触发不会再通知，自己排到下一轮
+    if ((readBudgetBytes_ > 0 && bytesThisRound >= readBudgetBytes_) ||
+        (readBudgetReads_ > 0 && readsThisRound >= readBudgetReads_)) {
+      scheduleRead();
+      break;
+    }
+    ssize_t bytes_read = readInput();
     if (bytes_read > 0) {
       log("Read " + std::to_string(bytes_read) + " bytes from client",
           "handleData");
-      messageCallback_(shared_from_this(), inputBuffer_);
+      bytesThisRound += bytes_read;
+      ++readsThisRound;
+      if (captureId_ != 0) {
+        // 新读到的数据在缓冲区末尾，消息回调取走之前录下来
+        capture_->data(captureId_,
+                       inputBuffer_.peek() + inputBuffer_.readableBytes() -
+                           bytes_read,
+                       static_cast<size_t>(bytes_read));
+      }
+      deliverInput(guardThis);
+      checkInputWaterMarks();
+      if (limited && throttleRead(static_cast<size_t>(bytes_read), 0)) {
+        break;
+      }
     } else if (bytes_read == 0) {
       handleClose();
       break;
@@ -69,17 +618,315 @@ void TcpConnection::handleRead() {
       break;
     }
   }
+  activity_ += bytesThisRound;
+  reclaimBuffer(inputBuffer_);
 }
 
-void TcpConnection::handleWrite() {}
+// 缓冲区读空就归还存储（空闲连接不占缓冲区），突发后变大的缓冲区收缩回去。
+// 存储在 I/O 线程上按需分配，内存落在该线程所在的 NUMA 节点
+void TcpConnection::reclaimBuffer(Buffer &buf) {
+  if (buf.readableBytes() == 0) {
+    buf.release();
+  } else if (buf.capacity() > kShrinkThreshold &&
+             buf.readableBytes() < buf.capacity() / 4) {
+    buf.shrink(Buffer::kInitialSize);
+  }
+}
+
+void TcpConnection::scheduleRead() {
+  if (readScheduled_) {
+    return;
+  }
+  readScheduled_ = true;
+  getLoop()->queueReady([self = shared_from_this()]() {
+    // 连接已经迁到别的 loop 时作废，新 loop 上会重新排
+    if (!self->getLoop()->isInLoopThread()) {
+      return;
+    }
+    self->readScheduled_ = false;
+    if (self->state_ == kConnected) {
+      self->handleRead();
+    }
+  });
+}
+
+void TcpConnection::handleWrite() {
+  if (!channel_.isWriting()) {
+    return;
+  }
+  if (state_ == kConnecting) {
+    handleHandshake();
+    return;
+  }
+  if (drainOutput()) {
+    channel_.disableWriting();
+    outputDrained();
+  }
+}
+
+// 边缘触发：一直写到 EAGAIN 或者写完，返回是否写完
+bool TcpConnection::drainOutput() {
+  while (outputBuffer_.readableBytes() > 0) {
+    ssize_t n =
+        writeOutput(outputBuffer_.peek(), outputBuffer_.readableBytes());
+    if (n > 0) {
+      activity_ += n;
+      outputBuffer_.retrieve(n);
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else {
+      if (n < 0 && checkWriteError("drainOutput")) {
+        return false;
+      }
+      break;
+    }
+  }
+  reclaimBuffer(outputBuffer_);
+  return outputBuffer_.readableBytes() == 0;
+}
+
+/**
+ * @brief 写失败后调用。EAGAIN 之外的错误（EPIPE、ECONNRESET 等）说明对端
+ * 已经不在，停止关注可写并关闭连接，输出缓冲区随之丢弃
+ * @return 是否是这种错误
+ */
+bool TcpConnection::checkWriteError(const char *where) {
+  if (errno == EWOULDBLOCK || errno == EINTR) {
+    return false;
+  }
+  logError(strerror(errno), where);
+  writeFailed_ = true;
+  if (channel_.isWriting()) {
+    channel_.disableWriting();
+  }
+  forceClose();
+  return true;
+}
+
+// 输出缓冲区写空：唤醒等写的协程，回调 writeComplete，完成延后的 shutdown
+void TcpConnection::outputDrained() {
+  if (writeWaiter_ != nullptr) {
+    WriteAwaiter *waiter = std::exchange(writeWaiter_, nullptr);
+    waiter->ok_ = true;
+    waiter->handle_.resume();
+  }
+  if (writeCompleteCallback_) {
+    queueInOwnerLoop([self = shared_from_this()]() {
+      self->writeCompleteCallback_(self);
+    });
+  }
+  if (state_ == kDisconnecting) {
+    shutdownInLoop();
+  }
+}
+
+// 写合并模式下把攒下的数据一次写出，写不完的部分等 EPOLLOUT 由 handleWrite 接着写
+void TcpConnection::flushCorked() {
+  flushScheduled_ = false;
+  if ((state_ != kConnected && state_ != kDisconnecting) ||
+      channel_.isWriting() || outputBuffer_.readableBytes() == 0) {
+    return;
+  }
+  if (drainOutput()) {
+    outputDrained();
+  } else if (!writeFailed_) {
+    channel_.enableWriting();
+  }
+}
 
 void TcpConnection::handleClose() {
-  state_ = kDisconnecting;
-  channel_->disableAll();
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  TRACE_SCOPE("close", socket_.getFd());
+  // 握手没完成的 TLS 连接从未通知过用户上线，关闭时也不通知下线
+  state_ = state_ == kConnecting ? kDisconnected : kDisconnecting;
+  channel_.disableAll();
 
   // 确保在handleClose里面，TcpConnectionPtr不会被释放
   TcpConnectionPtr guardThis(shared_from_this());
+  resumeWaiters();
   closeCallback_(guardThis);
 }
 
-void TcpConnection::handleError() {}
\ No newline at end of file
+void TcpConnection::handleError() {}
+// 有协程在等读时交给协程，否则交给 messageCallback_
+void TcpConnection::deliverInput(const TcpConnectionPtr &guardThis) {
+  if (codec_ && codec_->active() && !decodeInput()) {
+    return;
+  }
+  // 压缩连接交出解码后的数据，协商退回明文后就是 inputBuffer_
+  Buffer &input = userInput();
+  if (readWaiter_ != nullptr) {
+    if (readWaiter_->satisfied(readWaiter_->len_)) {
+      std::exchange(readWaiter_, nullptr)->handle_.resume();
+    }
+  } else if (messageCallback_ && (!codec_ || input.readableBytes() > 0)) {
+    messageCallback_(guardThis, input);
+  }
+}
+
+// 客户端在连接可用、用户回调之前发出压缩协商的 hello；两端都开始计时，
+// 超时由 negotiationTimedOut 处理
+void TcpConnection::startCompression() {
+  if (!codec_) {
+    return;
+  }
+  std::string hello;
+  if (codec_->takeControl(hello)) {
+    writeInLoop(hello.data(), hello.size());
+  }
+  std::weak_ptr<TcpConnection> weakThis = weak_from_this();
+  getLoop()->runAfter(codec_->options().negotiationTimeout, [weakThis]() {
+    if (TcpConnectionPtr self = weakThis.lock()) {
+      // 连接可能已经迁到别的 loop
+      self->queueInOwnerLoop([self]() { self->negotiationTimedOut(); });
+    }
+  });
+}
+
+void TcpConnection::negotiationTimedOut() {
+  if (closed_ || !codec_->negotiating()) {
+    return;
+  }
+  if (!codec_->abandonNegotiation()) {
+    logError("compression negotiation with " + peerAddr_.toString() +
+                 " timed out",
+             "negotiationTimedOut");
+    handleClose();
+    return;
+  }
+  sendNegotiated();
+  // 对端已经发来的不完整 hello 前缀现在按明文交给用户
+  if (inputBuffer_.readableBytes() > 0) {
+    deliverInput(shared_from_this());
+  }
+}
+
+/**
+ * @brief 解码收到的帧。协商刚完成时先写出服务端的应答，再把协商期间缓存的
+ * send 按新的方式发出；协议错误时关闭连接
+ */
+bool TcpConnection::decodeInput() {
+  bool ok = codec_->decode(inputBuffer_);
+  sendNegotiated();
+  if (!ok) {
+    logError("compression protocol error from " + peerAddr_.toString(),
+             "decodeInput");
+    handleClose();
+  }
+  return ok;
+}
+
+// 协商结束后写出应答和协商期间缓存的 send
+void TcpConnection::sendNegotiated() {
+  std::string out;
+  if (codec_->takeControl(out)) {
+    writeInLoop(out.data(), out.size());
+  }
+  if (codec_->takePending(out)) {
+    if (codec_->compressing()) {
+      const std::string &frame = codec_->encode(out.data(), out.size());
+      writeInLoop(frame.data(), frame.size());
+    } else {
+      writeInLoop(out.data(), out.size());
+    }
+    if (state_ == kDisconnecting) {
+      shutdownInLoop();
+    }
+  }
+}
+
+// 连接关闭时唤醒所有等待中的协程，读返回剩余数据，写返回 false
+void TcpConnection::resumeWaiters() {
+  if (readWaiter_ != nullptr) {
+    ReadAwaiter *waiter = std::exchange(readWaiter_, nullptr);
+    waiter->satisfied(waiter->len_);
+    waiter->handle_.resume();
+  }
+  if (writeWaiter_ != nullptr) {
+    WriteAwaiter *waiter = std::exchange(writeWaiter_, nullptr);
+    waiter->ok_ = false;
+    waiter->handle_.resume();
+  }
+}
+
+bool ReadAwaiter::await_ready() {
+  return conn_->inOwnerLoop() && satisfied(len_);
+}
+
+void ReadAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  handle_ = handle;
+  if (conn_->inOwnerLoop()) {
+    conn_->readWaiter_ = this;
+    return;
+  }
+  // 在别的线程里等待：转到 loop 线程检查和登记，保证在 loop 上恢复
+  conn_->queueInOwnerLoop([this]() {
+    if (satisfied(len_)) {
+      handle_.resume();
+    } else {
+      conn_->readWaiter_ = this;
+    }
+  });
+}
+
+std::string ReadAwaiter::await_resume() {
+  std::string result = conn_->userInput().retrieveAsString(len_);
+  conn_->checkInputWaterMarks();
+  return result;
+}
+
+bool ReadAwaiter::satisfied(size_t &len) {
+  Buffer &buf = conn_->userInput();
+  const size_t readable = buf.readableBytes();
+  if (delim_.empty()) {
+    if (readable >= n_) {
+      len = n_;
+      return true;
+    }
+  } else if (readable >= delim_.size()) {
+    // 从上次找过的位置往回退 delim 长度减一，分隔符可能跨两次到达的数据
+    size_t from = scanned_ >= delim_.size() ? scanned_ - delim_.size() + 1 : 0;
+    std::string_view data(buf.peek(), readable);
+    size_t pos = data.find(delim_, from);
+    if (pos != std::string_view::npos) {
+      len = pos + delim_.size();
+      return true;
+    }
+    scanned_ = readable;
+  }
+  if (conn_->state_ != TcpConnection::kConnected) {
+    len = std::min(readable, delim_.empty() ? n_ : readable);
+    return true;
+  }
+  return false;
+}
+
+bool WriteAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  handle_ = handle;
+  if (conn_->inOwnerLoop()) {
+    return startInLoop();
+  }
+  conn_->queueInOwnerLoop([this]() {
+    if (!startInLoop()) {
+      handle_.resume();
+    }
+  });
+  return true;
+}
+
+bool WriteAwaiter::startInLoop() {
+  if (conn_->state_ != TcpConnection::kConnected) {
+    ok_ = false;
+    return false;
+  }
+  conn_->sendInLoop(data_.data(), data_.size());
+  ok_ = true;
+  if (conn_->outputBuffer_.readableBytes() == 0) {
+    return false;
+  }
+  conn_->writeWaiter_ = this;
+  return true;
+}
@@ -2,79 +2,345 @@
 #include "../include/Channel.h"
 #include "../include/EventLoop.h"
 #include "../include/EventLoopThreadPool.h"
+#include "../include/HotRestart.h"
 #include "../include/InetAddress.h"
 #include "../include/Socket.h"
 #include "../include/TcpConnection.h"
+#include "../include/Trace.h"
+#include <cerrno>
+#include <cmath>
 #include <cstring>
 #include <functional>
 #include <memory>
 #include <type_traits>
+#include <unistd.h>
 
-TcpServer::TcpServer(const std::string &ip, const uint16_t port)
+TcpServer::TcpServer(const std::string &ip, const uint16_t port,
+                     const std::string &upgradePath)
+    : TcpServer(InetAddress(ip, port), upgradePath) {}
+
+TcpServer::TcpServer(const InetAddress &listenAddr,
+                     const std::string &upgradePath)
+    : TcpServer(listenAddr, ServerOptions(), upgradePath) {}
+
+TcpServer::TcpServer(const InetAddress &listenAddr,
+                     const ServerOptions &options,
+                     const std::string &upgradePath)
     : eventLoop_(std::make_unique<EventLoop>()),
       threadPool_(std::make_unique<EventLoopThreadPool>(eventLoop_.get(),
-                                                        4 /*numThreads*/)),
-      ip_(ip), port_(port), listensock_(std::make_unique<Socket>()),
-      listen_channel_(std::make_unique<Channel>(listensock_->getFd(),
-                                                eventLoop_->getPoller())),
-      server_addr_(ip, port), connectionCallback_(nullptr),
-      messageCallback_(nullptr), writeCompleteCallback_(nullptr),
-      connections_() {
-  listensock_->bind(server_addr_);
-  listensock_->listen();
-  listensock_->setReuseAddr(true);
-  listensock_->setReusePort(true);
-  listensock_->setTcpNoDelay(true);
-  listensock_->setKeepAlive(true);
+                                                        options.numThreads)),
+      options_(options), numThreads_(options.numThreads),
+      ip_(listenAddr.getIp()), port_(listenAddr.getPort()),
+      connectionCallback_(nullptr), messageCallback_(nullptr),
+      writeCompleteCallback_(nullptr), connections_(),
+      server_addr_(listenAddr), upgradeFd_(-1),
+      passConnections_(false), draining_(false), readBudgetBytes_(0),
+      readBudgetReads_(0), rebalancing_(false), migrations_(0) {
+  // 热重启：旧进程还在时直接接管它的监听 socket，不再 bind
+  InheritedState inherited;
+  if (!upgradePath.empty() && HotRestart::takeOver(upgradePath, inherited)) {
+    log("Took over listen fd and " +
+            std::to_string(inherited.connections.size()) +
+            " connections from old process",
+        "TcpServer");
+    listensock_ = std::make_unique<Socket>(inherited.listenFd);
+    server_addr_ = Socket::getLocalAddr(inherited.listenFd);
+    inherited_ = std::move(inherited.connections);
+  } else {
+    // 主监听 socket 要和各 loop 的监听 socket 在同一个 SO_REUSEPORT 组里
+    if (options_.listenerPerLoop) {
+      options_.reusePort = true;
+    }
+    // 交接中途失败时旧进程恢复了服务，没开 reusePort 的话这里 bind 会失败
+    listensock_ = createListenSocket(server_addr_, options_);
+    if (!listensock_) {
+      logError("cannot listen on " + server_addr_.toString(), "TcpServer");
+      return;
+    }
+  }
 
   // 为监听socket创建Channel
+  listen_channel_ = std::make_unique<Channel>(listensock_->getFd(),
+                                              eventLoop_->getPoller());
   listen_channel_->setWriteCallback([this]() { handleWrite(); });
   // 设置监听socket的读回调
-  listen_channel_->setReadCallback([this]() { handleNewConnection(); });
+  listen_channel_->setReadCallback(
+      [this]() { handleNewConnection(*listensock_); });
   listen_channel_->enableReading();
 }
 
+/**
+ * @brief 创建并监听一个 TCP 或 Unix 域套接字。顺序有讲究：端口复用要在 bind
+ * 之前，缓冲区大小要在 listen 之前（决定通告的窗口扩大因子），FASTOPEN 和
+ * DEFER_ACCEPT 要在 listen 之前；连接级选项设在监听 socket 上由新连接继承
+ * @return bind 或 listen 失败时返回 nullptr
+ */
+std::unique_ptr<Socket>
+TcpServer::createListenSocket(const InetAddress &addr,
+                              const ServerOptions &options) {
+  auto sock =
+      std::make_unique<Socket>(createNonblockingSocket(addr.family()));
+  bool tcp = !addr.isUnix();
+  if (tcp) {
+    sock->setReuseAddr(options.reuseAddr);
+    sock->setReusePort(options.reusePort);
+  }
+  if (options.recvBufferSize > 0) {
+    sock->setRecvBufferSize(options.recvBufferSize);
+  }
+  if (options.sendBufferSize > 0) {
+    sock->setSendBufferSize(options.sendBufferSize);
+  }
+  if (tcp) {
+    sock->setTcpNoDelay(options.tcpNoDelay);
+    sock->setKeepAlive(options.keepAlive);
+    if (options.userTimeoutMs > 0) {
+      sock->setUserTimeout(options.userTimeoutMs);
+    }
+    if (options.notSentLowat > 0) {
+      sock->setNotSentLowat(options.notSentLowat);
+    }
+  }
+  if (!sock->tryBind(addr)) {
+    return nullptr;
+  }
+  if (tcp) {
+    if (options.fastOpenQueue > 0) {
+      sock->setFastOpen(options.fastOpenQueue);
+    }
+    if (options.deferAcceptSeconds > 0) {
+      sock->setDeferAccept(options.deferAcceptSeconds);
+    }
+  }
+  if (!sock->tryListen(options.backlog)) {
+    return nullptr;
+  }
+  return sock;
+}
+
+void TcpServer::addListener(const InetAddress &addr) {
+  Listener listener;
+  listener.sock = createListenSocket(addr, options_);
+  if (!listener.sock) {
+    logError("cannot listen on " + addr.toString(), "addListener");
+    return;
+  }
+  listener.channel = std::make_unique<Channel>(listener.sock->getFd(),
+                                               eventLoop_->getPoller());
+  // 端口为 0 时记下实际拿到的端口，热重启失败后按它重建
+  listener.addr =
+      addr.isUnix() ? addr : Socket::getLocalAddr(listener.sock->getFd());
+  Socket *sock = listener.sock.get();
+  listener.channel->setReadCallback(
+      [this, sock]() { handleNewConnection(*sock); });
+  listener.channel->enableReading();
+  log("Also listening on " + addr.toString(), "addListener");
+  extraListeners_.push_back(std::move(listener));
+}
+
 TcpServer::~TcpServer() {
-  // 智能指针会自动释放资源，无需手动delete
+  // 先停 I/O 线程：否则它们关闭连接时还会访问正在析构的 connections_
+  threadPool_.reset();
+  // 其余智能指针会自动释放资源，无需手动delete
+  if (upgradeFd_ >= 0) {
+    ::close(upgradeFd_);
+  }
 }
 
 void TcpServer::stop() {
-  // 智能指针会自动释放资源，无需手动delete
+  // 让 start() 返回；I/O 线程在 TcpServer 析构时退出
+  eventLoop_->quit();
 }
 
 void TcpServer::setThreadNum(int numThreads) {
-  threadPool_ =
-      std::make_unique<EventLoopThreadPool>(eventLoop_.get(), numThreads);
+  numThreads_ = numThreads;
+  threadPool_ = std::make_unique<EventLoopThreadPool>(eventLoop_.get(),
+                                                      numThreads_, affinity_);
+}
+
+void TcpServer::setThreadAffinity(const ThreadAffinity &affinity) {
+  affinity_ = affinity;
+  threadPool_ = std::make_unique<EventLoopThreadPool>(eventLoop_.get(),
+                                                      numThreads_, affinity_);
+}
+
+void TcpServer::setRateLimit(const RateLimit &perConnection,
+                             const RateLimit &total) {
+  connectionRateLimit_ = perConnection;
+  totalRateLimiter_ =
+      total.enabled() ? std::make_shared<RateLimiter>(total) : nullptr;
 }
 
 void TcpServer::start() {
+  if (!listensock_) {
+    logError("not listening, server not started", "start");
+    return;
+  }
   // 启动线程池
   threadPool_->start();
+  for (EventLoop *loop : threadPool_->getAllLoops()) {
+    loopConnections_[loop];
+  }
+  if (options_.listenerPerLoop) {
+    startLoopListeners();
+  }
+  // 接管旧进程交过来的连接
+  for (const auto &ic : inherited_) {
+    adoptConnection(ic);
+  }
+  inherited_.clear();
+  if (rebalancing_) {
+    for (EventLoop *loop : threadPool_->getAllLoops()) {
+      lastCpuNanos_[loop] = loop->cpuTimeNanos();
+    }
+    lastRebalance_ = std::chrono::steady_clock::now();
+    eventLoop_->runAfter(rebalanceOptions_.period, [this]() { rebalance(); });
+  }
   // 启动事件循环
   eventLoop_->loop();
 }
 
+// 接管一条摘下来的连接（来自旧进程，或者交接失败后收回）
+void TcpServer::adoptConnection(const InheritedConnection &ic) {
+  InetAddress peerAddr = Socket::getPeerAddr(ic.fd);
+  auto conn =
+      newConnection(threadPool_->getNextLoop(), ic.fd, peerAddr, true);
+  conn->restoreBuffers(ic.input, ic.output);
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    connections_[conn->name()] = conn;
+  }
+  establishConnection(conn);
+}
+
 // 判断T是否是TcpConnection的引用
 template <typename T>
 concept IsTcpConnRef =
     std::is_same_v<std::remove_cvref_t<T>, std::shared_ptr<TcpConnection>>;
 
-// 处理新连接的回调函数。并设置客户端数据处理回调
-void TcpServer::handleNewConnection() {
-  // 获取客户端地址
-  InetAddress peerAddr;
-  int connfd = listensock_->accept(peerAddr);
-  if (connfd < 0) {
-    logError(strerror(errno), "handleNewConnection");
+/**
+ * @brief 监听 socket 可读：把已完成握手的连接一次取完，按目标 I/O loop 分组，
+ * 每个 loop 只投递一个任务（一次加锁、一次唤醒）。TcpConnection 在所属 loop
+ * 上构造，内存由使用它的线程第一次写入
+ */
+void TcpServer::handleNewConnection(Socket &listener, EventLoop *owner) {
+  TRACE_SCOPE("accept");
+  std::unordered_map<EventLoop *, std::vector<AcceptedFd>> batches;
+  for (int i = 0; i < kMaxAcceptsPerEvent; ++i) {
+    InetAddress peerAddr;
+    int connfd = listener.accept(peerAddr);
+    if (connfd < 0) {
+      // 对端在 accept 之前就断开了，继续取下一个
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        logError(strerror(errno), "handleNewConnection");
+      }
+      break;
+    }
+    EventLoop *ioLoop = owner;
+    if (ioLoop == nullptr) {
+      ioLoop = options_.steerByIncomingCpu
+                   ? threadPool_->getLoopForCpu(Socket::getIncomingCpu(connfd))
+                   : threadPool_->getNextLoop();
+    }
+    batches[ioLoop].push_back(AcceptedFd{connfd, peerAddr});
+  }
+  for (auto &[ioLoop, batch] : batches) {
+    establishBatch(ioLoop, std::move(batch));
+  }
+}
+
+/**
+ * @brief 每个 I/O loop 在同一地址上各开一个 SO_REUSEPORT 监听 socket，
+ * 由内核在它们之间分配新连接；按收包 CPU 分配时设置 SO_INCOMING_CPU，
+ * 让内核把在某个 CPU 上收到的连接交给绑在该 CPU 上的 loop
+ */
+void TcpServer::startLoopListeners() {
+  std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+  // 没有 I/O 线程时主监听 socket 就是唯一的 loop 的监听 socket
+  if (server_addr_.isUnix() || loops.front() == eventLoop_.get()) {
     return;
   }
+  // 端口为 0 时各监听 socket 要用主监听 socket 实际拿到的端口
+  InetAddress addr = Socket::getLocalAddr(listensock_->getFd());
+  ServerOptions options = options_;
+  options.reusePort = true;
+  for (EventLoop *loop : loops) {
+    Listener listener;
+    listener.loop = loop;
+    listener.sock = createListenSocket(addr, options);
+    if (!listener.sock) {
+      // 这个 loop 只是少了自己的监听 socket，主监听 socket 照常分配连接
+      logError("cannot listen on " + addr.toString(), "startLoopListeners");
+      continue;
+    }
+    if (options_.steerByIncomingCpu && loop->cpu() >= 0) {
+      listener.sock->setIncomingCpu(loop->cpu());
+    }
+    listener.channel =
+        std::make_unique<Channel>(listener.sock->getFd(), loop->getPoller());
+    Socket *sock = listener.sock.get();
+    Channel *channel = listener.channel.get();
+    channel->setReadCallback(
+        [this, sock, loop]() { handleNewConnection(*sock, loop); });
+    // Poller 只在所属 loop 线程里修改
+    loop->queueInLoop([channel]() { channel->enableReading(); });
+    loopListeners_.push_back(std::move(listener));
+  }
+}
 
-  EventLoop *ioLoop = threadPool_->getNextLoop();
+// acceptHandoff 事件：从 accept 线程投递到 I/O 线程开始执行之间的排队时间
+void TcpServer::establishBatch(EventLoop *ioLoop,
+                               std::vector<AcceptedFd> batch) {
+  uint64_t queuedAt = traceNow();
+  ioLoop->queueInLoop([this, ioLoop, batch = std::move(batch), queuedAt]() {
+    traceSince("acceptHandoff", queuedAt, batch.size());
+    std::vector<std::shared_ptr<TcpConnection>> conns;
+    conns.reserve(batch.size());
+    for (const AcceptedFd &accepted : batch) {
+      conns.push_back(newConnection(ioLoop, accepted.fd, accepted.peerAddr));
+    }
+    // 存到map中，先于connectEstablished，避免连接立刻关闭时map里残留
+    {
+      std::lock_guard<std::mutex> lock(connections_mutex_);
+      for (const auto &conn : conns) {
+        connections_[conn->name()] = conn;
+      }
+    }
+    auto &established = loopConnections_.at(ioLoop);
+    for (const auto &conn : conns) {
+      established.insert(conn.get());
+      conn->connectEstablished();
+    }
+  });
+}
 
-  // 创建TcpConnection
-  std::shared_ptr<TcpConnection> conn = std::make_shared<TcpConnection>(
-      ioLoop, "conn" + std::to_string(connfd), connfd,
-      InetAddress(Socket::getLocalAddr(connfd)), peerAddr);
+// 在I/O线程中调用connectEstablished，并登记到该 loop 的连接表
+void TcpServer::establishConnection(
+    const std::shared_ptr<TcpConnection> &conn) {
+  uint64_t queuedAt = traceNow();
+  conn->getLoop()->queueInLoop([this, conn, queuedAt]() {
+    traceSince("acceptHandoff", queuedAt, conn->fd());
+    loopConnections_.at(conn->getLoop()).insert(conn.get());
+    conn->connectEstablished();
+  });
+}
+
+// 创建TcpConnection，设置回调
+std::shared_ptr<TcpConnection>
+TcpServer::newConnection(EventLoop *ioLoop, int connfd,
+                         const InetAddress &peerAddr, bool inherited) {
+  // 创建TcpConnection，对象和控制块从 ioLoop 的内存池一次分配
+  std::shared_ptr<TcpConnection> conn = std::allocate_shared<TcpConnection>(
+      PoolAllocator<TcpConnection>(ioLoop->connectionPool()), ioLoop,
+      "conn" + std::to_string(connfd), connfd,
+      Socket::getLocalAddr(connfd), peerAddr);
+
+  if (options_.quickAck && !peerAddr.isUnix()) {
+    conn->setQuickAck(true);
+  }
 
   // 设置回调函数
   // 设置TcpConnection的连接回调为TcpServer::connectionCallback_,来自于main
@@ -83,32 +349,327 @@ void TcpServer::handleNewConnection() {
   // 待确定
   conn->setMessageCallback(messageCallback_);
   conn->setWriteCompleteCallback(writeCompleteCallback_);
+  conn->setReadBudget(readBudgetBytes_, readBudgetReads_);
+  if (connectionRateLimit_.enabled() || totalRateLimiter_) {
+    conn->setRateLimit(connectionRateLimit_, totalRateLimiter_);
+  }
+  if (capture_) {
+    conn->setCapture(capture_);
+  }
+  if (!inherited && tlsContext_) {
+    conn->startTls(tlsContext_, true);
+  }
+  if (!inherited && compression_) {
+    conn->enableCompression(*compression_, true);
+  }
 
   // 设置TcpConnection的关闭回调为TcpServer::removeConnection
   conn->setCloseCallback([this]<IsTcpConnRef T>(T &&PH1) {
     removeConnection(std::forward<T>(PH1));
   });
-
-  // 在I/O线程中调用connectEstablished
-  ioLoop->queueInLoop([conn]() { conn->connectEstablished(); });
-
-  // 存到map中
-  {
-    std::lock_guard<std::mutex> lock(connections_mutex_);
-    connections_[conn->name()] = conn;
-  }
+  return conn;
 }
 
 void TcpServer::removeConnection(const std::shared_ptr<TcpConnection> &conn) {
   log("Removing connection: " + conn->name(), "removeConnection");
 
   // 在I/O线程中调用connectDestroyed
-  conn->getLoop()->queueInLoop([conn]() { conn->connectDestroyed(); });
+  conn->getLoop()->queueInLoop([this, conn]() {
+    loopConnections_.at(conn->getLoop()).erase(conn.get());
+    conn->connectDestroyed();
+  });
   // 从map中移除连接
+  bool drained = false;
   {
     std::lock_guard<std::mutex> lock(connections_mutex_);
     connections_.erase(conn->name());
+    drained = draining_ && connections_.empty();
+  }
+  // 热重启后的旧进程：最后一个连接关闭即退出
+  if (drained) {
+    eventLoop_->quit();
+  }
+}
+
+// 在 loop 线程里直接执行，否则投递过去
+static void runInLoop(EventLoop *loop, std::function<void()> func) {
+  if (loop->isInLoopThread()) {
+    func();
+  } else {
+    loop->queueInLoop(std::move(func));
+  }
+}
+
+void TcpServer::broadcast(const SharedPayload &payload) {
+  for (auto &[loop, conns] : loopConnections_) {
+    runInLoop(loop, [&conns, payload]() {
+      for (TcpConnection *conn : conns) {
+        conn->send(payload);
+      }
+    });
+  }
+}
+
+void TcpServer::broadcast(const std::vector<TcpConnectionPtr> &group,
+                          const SharedPayload &payload) {
+  std::unordered_map<EventLoop *, std::vector<TcpConnectionPtr>> byLoop;
+  for (const TcpConnectionPtr &conn : group) {
+    byLoop[conn->getLoop()].push_back(conn);
+  }
+  for (auto &[loop, conns] : byLoop) {
+    runInLoop(loop, [conns = std::move(conns), payload]() {
+      for (const TcpConnectionPtr &conn : conns) {
+        conn->send(payload);
+      }
+    });
+  }
+}
+
+void TcpServer::migrateConnection(const TcpConnectionPtr &conn,
+                                  EventLoop *target) {
+  if (loopConnections_.count(target) == 0) {
+    logError("migration target is not an I/O loop of this server",
+             "migrateConnection");
+    return;
+  }
+  // 连接表跟着连接走：在原 loop 上摘下时移出，在新 loop 上接管时加入
+  conn->migrateTo(
+      target,
+      [this](const TcpConnectionPtr &c) {
+        loopConnections_.at(c->getLoop()).erase(c.get());
+      },
+      [this](const TcpConnectionPtr &c) {
+        loopConnections_.at(c->getLoop()).insert(c.get());
+        migrations_.fetch_add(1, std::memory_order_relaxed);
+      });
+}
+
+void TcpServer::enableRebalancer(const RebalanceOptions &options) {
+  rebalancing_ = true;
+  rebalanceOptions_ = options;
+}
+
+/**
+ * @brief 算出上个周期各 loop 线程占用 CPU 的比例，给每个 loop 投递一个任务：
+ * 最忙的 loop 在它自己的线程上挑连接迁走，其余的 loop 清零各连接的读写量，
+ * 让下个周期的统计只包含下个周期
+ */
+void TcpServer::rebalance() {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double elapsed = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now -
+                                                           lastRebalance_)
+          .count());
+  lastRebalance_ = now;
+  EventLoop *heavy = nullptr;
+  EventLoop *light = nullptr;
+  double heavyBusy = 0;
+  double lightBusy = 0;
+  std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+  for (EventLoop *loop : loops) {
+    uint64_t cpu = loop->cpuTimeNanos();
+    double ratio = elapsed > 0 ? (cpu - lastCpuNanos_[loop]) / elapsed : 0;
+    lastCpuNanos_[loop] = cpu;
+    if (heavy == nullptr || ratio > heavyBusy) {
+      heavy = loop;
+      heavyBusy = ratio;
+    }
+    if (light == nullptr || ratio < lightBusy) {
+      light = loop;
+      lightBusy = ratio;
+    }
+  }
+  bool imbalanced =
+      heavy != light && heavyBusy - lightBusy >= rebalanceOptions_.minImbalance;
+  for (EventLoop *loop : loops) {
+    if (imbalanced && loop == heavy) {
+      loop->queueInLoop([this, heavy, light, heavyBusy, lightBusy]() {
+        migrateFrom(heavy, light, heavyBusy, lightBusy);
+      });
+    } else {
+      loop->queueInLoop([this, loop]() {
+        for (TcpConnection *conn : loopConnections_.at(loop)) {
+          conn->takeActivity();
+        }
+      });
+    }
+  }
+  eventLoop_->runAfter(rebalanceOptions_.period, [this]() { rebalance(); });
+}
+
+/**
+ * @brief 按读写字节数估计每个连接占 heavy 忙碌时间的比例，挑最接近
+ * 两边差值一半的连接迁到 light。迁走的量达到差值就只是把热点换了个地方
+ * （例如 heavy 上只有一个活跃连接），这样的连接不迁
+ */
+void TcpServer::migrateFrom(EventLoop *heavy, EventLoop *light,
+                            double heavyBusy, double lightBusy) {
+  std::vector<std::pair<uint64_t, TcpConnection *>> candidates;
+  uint64_t total = 0;
+  for (TcpConnection *conn : loopConnections_.at(heavy)) {
+    uint64_t activity = conn->takeActivity();
+    total += activity;
+    if (activity > 0 && !conn->migrating()) {
+      candidates.emplace_back(activity, conn);
+    }
+  }
+  if (total == 0) {
+    return;
+  }
+  double gap = (heavyBusy - lightBusy) / heavyBusy * total;
+  double wanted = gap / 2;
+  for (int i = 0; i < rebalanceOptions_.maxMigrationsPerPeriod && wanted > 0;
+       ++i) {
+    auto best = candidates.end();
+    for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+      if (it->first < gap &&
+          (best == candidates.end() ||
+           std::fabs(it->first - wanted) < std::fabs(best->first - wanted))) {
+        best = it;
+      }
+    }
+    if (best == candidates.end()) {
+      break;
+    }
+    migrateConnection(best->second->shared_from_this(), light);
+    gap -= best->first;
+    wanted -= best->first;
+    candidates.erase(best);
+  }
+}
+
+void TcpServer::enableHotRestart(const std::string &path,
+                                 bool passConnections) {
+  upgradeFd_ = HotRestart::listenForUpgrade(path);
+  if (upgradeFd_ < 0) {
+    return;
+  }
+  passConnections_ = passConnections;
+  upgradeChannel_ =
+      std::make_unique<Channel>(upgradeFd_, eventLoop_->getPoller());
+  upgradeChannel_->setReadCallback([this]() { handleUpgradeRequest(); });
+  upgradeChannel_->enableReading();
+}
+
+// 新进程连上来：停止 accept，交出监听 fd（以及所有连接），然后退出
+void TcpServer::handleUpgradeRequest() {
+  int peer = ::accept4(upgradeFd_, nullptr, nullptr, SOCK_CLOEXEC);
+  if (peer < 0) {
+    logError(strerror(errno), "handleUpgradeRequest");
+    return;
+  }
+  // 只处理一次升级
+  upgradeChannel_->disableAll();
+  eventLoop_->getPoller()->removeChannel(upgradeChannel_.get());
+  listen_channel_->disableAll();
+  eventLoop_->getPoller()->removeChannel(listen_channel_.get());
+  // addListener 的额外监听 socket 不交接，新进程自己 addListener。
+  // 取完已经排队的连接后立即关闭，新进程才能 bind，也不会有连接落进
+  // 没人 accept 的 backlog；只留下地址，交接失败时重建
+  for (auto &listener : extraListeners_) {
+    listener.channel->disableAll();
+    eventLoop_->getPoller()->removeChannel(listener.channel.get());
+    handleNewConnection(*listener.sock);
+    listener.channel.reset();
+    listener.sock.reset();
+  }
+  // 各 loop 自己的 SO_REUSEPORT 监听 socket 不交接：在所属 loop 上取完已经
+  // 排队的连接后立即关闭，内核把它们移出 reuseport 组，新连接只落到交出去的
+  // 主监听 socket 上，不会被哈希到没人 accept 的 socket 里
+  for (auto &listener : loopListeners_) {
+    auto owned = std::make_shared<Listener>(std::move(listener));
+    EventLoop *loop = owned->loop;
+    loop->queueInLoop([this, owned, loop]() {
+      owned->channel->disableAll();
+      loop->getPoller()->removeChannel(owned->channel.get());
+      handleNewConnection(*owned->sock, loop);
+      owned->sock.reset();
+    });
+  }
+  loopListeners_.clear();
+
+  auto handoff = std::make_shared<Handoff>();
+  handoff->peer = peer;
+  if (passConnections_) {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    for (auto &[name, conn] : connections_) {
+      handoff->conns.push_back(conn);
+    }
+  }
+  handoff->pending = handoff->conns.size();
+  if (handoff->pending == 0) {
+    finishUpgrade(handoff);
+    return;
+  }
+
+  // 每个连接在自己的 I/O 线程里摘下，最后一个完成时回到主线程发送
+  for (auto &conn : handoff->conns) {
+    conn->getLoop()->queueInLoop([this, conn, handoff]() {
+      InheritedConnection ic;
+      bool detached = conn->detachForHandoff(ic);
+      bool last = false;
+      {
+        std::lock_guard<std::mutex> lock(handoff->mutex);
+        if (detached) {
+          handoff->state.connections.push_back(std::move(ic));
+        }
+        last = --handoff->pending == 0;
+      }
+      if (detached) {
+        removeConnection(conn);
+      }
+      if (last) {
+        eventLoop_->queueInLoop([this, handoff]() { finishUpgrade(handoff); });
+      }
+    });
+  }
+}
+
+// 状态发送成功之后才关闭交出的 fd 并排空；失败时新进程没有接管任何东西，
+// 旧进程恢复 accept 并收回摘下的连接，继续服务
+void TcpServer::finishUpgrade(const std::shared_ptr<Handoff> &handoff) {
+  handoff->state.listenFd = listensock_->getFd();
+  bool sent = HotRestart::sendState(handoff->peer, handoff->state);
+  ::close(handoff->peer);
+  if (!sent) {
+    logError("hot restart handoff failed, resuming service", "finishUpgrade");
+    resumeAfterFailedUpgrade(handoff);
+    return;
+  }
+  for (auto &ic : handoff->state.connections) {
+    ::close(ic.fd);
+  }
+  log("Handed off " + std::to_string(handoff->state.connections.size()) +
+          " connections, draining",
+      "finishUpgrade");
+
+  bool drained = false;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    draining_ = true;
+    drained = connections_.empty();
+  }
+  if (drained) {
+    eventLoop_->quit();
+  }
+}
+
+void TcpServer::resumeAfterFailedUpgrade(
+    const std::shared_ptr<Handoff> &handoff) {
+  listen_channel_->enableReading();
+  std::vector<Listener> closed = std::move(extraListeners_);
+  extraListeners_.clear();
+  for (const auto &listener : closed) {
+    addListener(listener.addr);
+  }
+  if (options_.listenerPerLoop) {
+    startLoopListeners();
+  }
+  for (const auto &ic : handoff->state.connections) {
+    adoptConnection(ic);
   }
+  // 允许再次升级
+  upgradeChannel_->enableReading();
 }
 
 void TcpServer::handleWrite() { log("Handling write event...", "handleWrite"); }
\ No newline at end of file
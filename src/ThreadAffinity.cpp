@@ -0,0 +1,177 @@
+#include "../include/ThreadAffinity.h"
+#include "../include/Channel.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief 把当前线程绑定到指定 CPU
+ * @param cpu
+ * @return
+ */
+bool pinCurrentThread(int cpu) {
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+  if (ret != 0) {
+    logError("pin to cpu " + std::to_string(cpu) + " failed: " + strerror(ret),
+             __func__);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 设置当前线程名字
+ * @param name
+ */
+void setCurrentThreadName(const std::string &name) {
+  // pthread_setname_np 要求长度不超过 16 字节（含结尾 '\0'）
+  std::string truncated = name.substr(0, 15);
+  ::pthread_setname_np(::pthread_self(), truncated.c_str());
+}
+
+/**
+ * @brief 读取 sysfs 得到 cpu 所在的 NUMA 节点
+ * @param cpu
+ * @return 节点号，非 NUMA 机器或失败返回 -1
+ */
+// 内核 MAX_NUMNODES 的上限（CONFIG_NODES_SHIFT 最大为 10）
+static constexpr int kMaxNumaNodes = 1024;
+
+int cpuNumaNode(int cpu) {
+  for (int node = 0; node < kMaxNumaNodes; ++node) {
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                       "/node" + std::to_string(node);
+    if (::access(path.c_str(), F_OK) == 0) {
+      return node;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief 把当前线程的内存策略设为优先使用 cpu 所在节点
+ * @param cpu
+ * @return
+ */
+int bindMemoryToCpuNode(int cpu) {
+  int node = cpuNumaNode(cpu);
+  if (node < 0) {
+    return -1;
+  }
+  if (node >= kMaxNumaNodes) {
+    logError("NUMA node " + std::to_string(node) + " out of range", __func__);
+    return -1;
+  }
+  // 节点位图按 unsigned long 数组传，内核只读 maxnode - 1 位，所以多传 1
+  constexpr int kBitsPerWord = 8 * sizeof(unsigned long);
+  unsigned long mask[kMaxNumaNodes / kBitsPerWord] = {};
+  mask[node / kBitsPerWord] |= 1UL << (node % kBitsPerWord);
+  // 直接走系统调用，避免引入 libnuma 依赖
+  if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask,
+                kMaxNumaNodes + 1) != 0) {
+    logError(strerror(errno), __func__);
+    return -1;
+  }
+  return node;
+}
+
+/**
+ * @brief 返回当前进程允许运行的 CPU 列表
+ * @return
+ */
+std::vector<int> allowedCpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int i = 0; i < CPU_SETSIZE; ++i) {
+      if (CPU_ISSET(i, &set)) {
+        cpus.push_back(i);
+      }
+    }
+  }
+  return cpus;
+}
+
+int configuredCpuCount() {
+  long n = ::sysconf(_SC_NPROCESSORS_CONF);
+  return n > 0 ? static_cast<int>(n) : 1;
+}
+
+/**
+ * @brief 解析 sysfs 里 "0-3,8,10-11" 格式的 CPU 列表
+ * @param path
+ * @return 文件不存在或格式不对时返回空
+ */
+static std::vector<int> readCpuList(const std::string &path) {
+  std::vector<int> cpus;
+  std::ifstream in(path);
+  std::string list;
+  if (!std::getline(in, list)) {
+    return cpus;
+  }
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = list.find(',', pos);
+    std::string range = list.substr(pos, end - pos);
+    int first = 0;
+    int last = 0;
+    int n = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+    if (n == 1) {
+      last = first;
+    } else if (n != 2) {
+      return {};
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+    if (end == std::string::npos) {
+      break;
+    }
+    pos = end + 1;
+  }
+  return cpus;
+}
+
+/**
+ * @brief 读取 sysfs 得到 cpu 的 SMT 兄弟
+ * @param cpu
+ * @return
+ */
+std::vector<int> cpuThreadSiblings(int cpu) {
+  std::vector<int> siblings =
+      readCpuList("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                  "/topology/thread_siblings_list");
+  if (siblings.empty()) {
+    siblings.push_back(cpu);
+  }
+  return siblings;
+}
+
+/**
+ * @brief 读取 sysfs 得到 cpu 所在的物理封装号
+ * @param cpu
+ * @return
+ */
+int cpuPackage(int cpu) {
+  std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                   "/topology/physical_package_id");
+  int package = -1;
+  if (!(in >> package)) {
+    return -1;
+  }
+  return package;
+}
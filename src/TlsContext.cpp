@@ -0,0 +1,319 @@
+#include "../include/TlsContext.h"
+#include "../include/Channel.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+// 取出并清空当前线程的 OpenSSL 错误队列
+static std::string sslErrors() {
+  std::string result;
+  unsigned long err;
+  while ((err = ERR_get_error()) != 0) {
+    char buf[256];
+    ERR_error_string_n(err, buf, sizeof(buf));
+    if (!result.empty()) {
+      result += "; ";
+    }
+    result += buf;
+  }
+  return result.empty() ? "unknown error" : result;
+}
+
+static int (*socketWrite)(BIO *, const char *, int);
+
+/**
+ * @brief 调用原来的 socket 写回调，期间在本线程屏蔽 SIGPIPE，
+ * 写到已关闭的连接产生的 SIGPIPE 在恢复屏蔽字之前取走
+ */
+static int writeBlockingSigpipe(BIO *bio, const char *data, int len) {
+  sigset_t pipe, pending, old;
+  sigemptyset(&pipe);
+  sigaddset(&pipe, SIGPIPE);
+  sigpending(&pending);
+  bool alreadyPending = sigismember(&pending, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe, &old);
+  int ret = socketWrite(bio, data, len);
+  int savedErrno = errno;
+  if (ret < 0 && savedErrno == EPIPE && !alreadyPending) {
+    struct timespec zero = {0, 0};
+    sigtimedwait(&pipe, nullptr, &zero);
+  }
+  pthread_sigmask(SIG_SETMASK, &old, nullptr);
+  errno = savedErrno;
+  return ret;
+}
+
+/**
+ * @brief socket BIO 的写回调，换成 send(MSG_NOSIGNAL)，对端关闭后再写
+ * 只返回 EPIPE，不会收到 SIGPIPE
+ *
+ * 开启 kTLS 发送后 OpenSSL 发 alert 等控制记录要带 cmsg，
+ * 这部分仍交给原来的回调
+ */
+static int noSigpipeWrite(BIO *bio, const char *data, int len) {
+  if (BIO_get_ktls_send(bio)) {
+    return writeBlockingSigpipe(bio, data, len);
+  }
+  errno = 0;
+  int ret = static_cast<int>(
+      ::send(static_cast<int>(BIO_get_fd(bio, nullptr)), data, len,
+             MSG_NOSIGNAL));
+  BIO_clear_retry_flags(bio);
+  if (ret <= 0 && BIO_sock_should_retry(ret)) {
+    BIO_set_retry_write(bio);
+  }
+  return ret;
+}
+
+/**
+ * @brief 除写回调外和 BIO_s_socket() 完全相同的 BIO_METHOD，
+ * kTLS 的 ctrl 仍由原来的 socket ctrl 处理
+ */
+static const BIO_METHOD *noSigpipeSocketMethod() {
+  static BIO_METHOD *method = []() {
+    const BIO_METHOD *socket = BIO_s_socket();
+    socketWrite = BIO_meth_get_write(socket);
+    BIO_METHOD *m =
+        BIO_meth_new(BIO_TYPE_SOCKET, "socket without SIGPIPE");
+    BIO_meth_set_write(m, noSigpipeWrite);
+    BIO_meth_set_read(m, BIO_meth_get_read(socket));
+    BIO_meth_set_puts(m, BIO_meth_get_puts(socket));
+    BIO_meth_set_gets(m, BIO_meth_get_gets(socket));
+    BIO_meth_set_ctrl(m, BIO_meth_get_ctrl(socket));
+    BIO_meth_set_create(m, BIO_meth_get_create(socket));
+    BIO_meth_set_destroy(m, BIO_meth_get_destroy(socket));
+    return m;
+  }();
+  return method;
+}
+
+/**
+ * @brief 创建 SSL_CTX：只允许 TLS 1.2 及以上，开启 kTLS，允许部分写和移动写缓冲区
+ * （待发送数据留在 Buffer 里，重试时地址可能变化）
+ */
+static SSL_CTX *newContext(const SSL_METHOD *method) {
+  SSL_CTX *ctx = SSL_CTX_new(method);
+  if (ctx == nullptr) {
+    logError(sslErrors(), "TlsContext");
+    return nullptr;
+  }
+  SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+  SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+  SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                            SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                            SSL_MODE_RELEASE_BUFFERS);
+  return ctx;
+}
+
+std::shared_ptr<TlsContext>
+TlsContext::newServer(const std::string &certFile, const std::string &keyFile) {
+  SSL_CTX *ctx = newContext(TLS_server_method());
+  if (ctx == nullptr) {
+    return nullptr;
+  }
+  if (SSL_CTX_use_certificate_chain_file(ctx, certFile.c_str()) != 1 ||
+      SSL_CTX_use_PrivateKey_file(ctx, keyFile.c_str(), SSL_FILETYPE_PEM) !=
+          1 ||
+      SSL_CTX_check_private_key(ctx) != 1) {
+    logError(certFile + ": " + sslErrors(), "newServer");
+    SSL_CTX_free(ctx);
+    return nullptr;
+  }
+  return std::make_shared<TlsContext>(ctx);
+}
+
+std::shared_ptr<TlsContext>
+TlsContext::newSelfSignedServer(const std::string &commonName) {
+  SSL_CTX *ctx = newContext(TLS_server_method());
+  if (ctx == nullptr) {
+    return nullptr;
+  }
+  EVP_PKEY *key = EVP_EC_gen("P-256");
+  X509 *cert = X509_new();
+  bool ok = key != nullptr && cert != nullptr;
+  if (ok) {
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(
+        name, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char *>(commonName.c_str()), -1, -1,
+        0);
+    X509_set_issuer_name(cert, name);
+    ok = X509_sign(cert, key, EVP_sha256()) > 0 &&
+         SSL_CTX_use_certificate(ctx, cert) == 1 &&
+         SSL_CTX_use_PrivateKey(ctx, key) == 1;
+  }
+  // SSL_CTX 持有自己的引用
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  if (!ok) {
+    logError(sslErrors(), "newSelfSignedServer");
+    SSL_CTX_free(ctx);
+    return nullptr;
+  }
+  return std::make_shared<TlsContext>(ctx);
+}
+
+std::shared_ptr<TlsContext> TlsContext::newClient() {
+  std::shared_ptr<TlsContext> client = newClientInsecure();
+  if (client && !client->setVerifyPeer(true)) {
+    return nullptr;
+  }
+  return client;
+}
+
+std::shared_ptr<TlsContext> TlsContext::newClientInsecure() {
+  SSL_CTX *ctx = newContext(TLS_client_method());
+  if (ctx == nullptr) {
+    return nullptr;
+  }
+  return std::make_shared<TlsContext>(ctx);
+}
+
+TlsContext::TlsContext(ssl_ctx_st *ctx) : ctx_(ctx) {}
+
+TlsContext::~TlsContext() { SSL_CTX_free(ctx_); }
+
+bool TlsContext::setVerifyPeer(bool on, const std::string &caFile) {
+  if (!on) {
+    SSL_CTX_set_verify(ctx_, SSL_VERIFY_NONE, nullptr);
+    return true;
+  }
+  int ret = caFile.empty()
+                ? SSL_CTX_set_default_verify_paths(ctx_)
+                : SSL_CTX_load_verify_locations(ctx_, caFile.c_str(), nullptr);
+  if (ret != 1) {
+    logError(sslErrors(), "setVerifyPeer");
+    return false;
+  }
+  SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT,
+                     nullptr);
+  return true;
+}
+
+void TlsContext::setKtlsEnabled(bool on) {
+  if (on) {
+    SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS);
+  } else {
+    SSL_CTX_clear_options(ctx_, SSL_OP_ENABLE_KTLS);
+  }
+}
+
+TlsSession::TlsSession(const std::shared_ptr<TlsContext> &ctx, int fd,
+                       bool isServer, const std::string &serverName)
+    : ctx_(ctx), ssl_(SSL_new(ctx->native())), handshakeDone_(false),
+      ktlsSend_(false), ktlsRecv_(false) {
+  // 用 socket BIO 而不是内存 BIO：kTLS 需要 OpenSSL 直接持有 socket。
+  // 和 SSL_set_fd 一样先给 socket 挂上 tls ULP，之后才能开启 kTLS
+  BIO *bio = BIO_new(noSigpipeSocketMethod());
+  BIO_set_fd(bio, fd, BIO_NOCLOSE);
+  SSL_set_bio(ssl_, bio, bio);
+  ::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls"));
+  if (isServer) {
+    SSL_set_accept_state(ssl_);
+  } else {
+    SSL_set_connect_state(ssl_);
+    if (!serverName.empty()) {
+      SSL_set_tlsext_host_name(ssl_, serverName.c_str());
+      SSL_set1_host(ssl_, serverName.c_str());
+    }
+  }
+}
+
+TlsSession::~TlsSession() { SSL_free(ssl_); }
+
+TlsSession::Result TlsSession::handshake() {
+  int ret = SSL_do_handshake(ssl_);
+  if (ret != 1) {
+    return translate(ret, "handshake");
+  }
+  handshakeDone_ = true;
+  ktlsSend_ = BIO_get_ktls_send(SSL_get_wbio(ssl_));
+  ktlsRecv_ = BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+  log(std::string(SSL_get_version(ssl_)) + " " + cipher() +
+          ", kTLS tx=" + (ktlsSend_ ? "on" : "off") +
+          " rx=" + (ktlsRecv_ ? "on" : "off"),
+      "TlsSession");
+  return kOk;
+}
+
+/**
+ * @brief 一直读到 socket 里没有完整的记录或者读满 maxBytes，
+ * 每次 SSL_read 最多返回一个记录（16KB）
+ */
+TlsSession::Result TlsSession::read(Buffer &buf, size_t maxBytes, size_t &n) {
+  static constexpr size_t kRecordSize = 16 * 1024;
+  n = 0;
+  while (n < maxBytes) {
+    buf.ensureWritableBytes(kRecordSize);
+    size_t got = 0;
+    int ret = SSL_read_ex(ssl_, buf.beginWrite(), buf.writableBytes(), &got);
+    if (ret != 1) {
+      Result r = translate(ret, "read");
+      // 已经读到的数据先交给上层，下次再报告关闭或错误
+      return n > 0 ? kOk : r;
+    }
+    buf.hasWritten(got);
+    n += got;
+  }
+  return kOk;
+}
+
+TlsSession::Result TlsSession::write(const char *data, size_t len, size_t &n) {
+  n = 0;
+  int ret = SSL_write_ex(ssl_, data, len, &n);
+  if (ret != 1) {
+    return translate(ret, "write");
+  }
+  return kOk;
+}
+
+void TlsSession::shutdown() {
+  if (handshakeDone_) {
+    SSL_shutdown(ssl_);
+  }
+}
+
+std::string TlsSession::cipher() const {
+  const char *name = SSL_get_cipher_name(ssl_);
+  return name != nullptr ? name : "";
+}
+
+TlsSession::Result TlsSession::translate(int ret, const char *func) {
+  switch (SSL_get_error(ssl_, ret)) {
+  case SSL_ERROR_WANT_READ:
+    return kWantRead;
+  case SSL_ERROR_WANT_WRITE:
+    return kWantWrite;
+  case SSL_ERROR_ZERO_RETURN:
+    return kClosed;
+  case SSL_ERROR_SYSCALL:
+    // socket 出错（例如 ECONNRESET），按对端关闭处理
+    ERR_clear_error();
+    return kClosed;
+  case SSL_ERROR_SSL:
+    // 对端没发 close_notify 就断开，同样按关闭处理，不当作错误
+    if (ERR_GET_REASON(ERR_peek_error()) ==
+        SSL_R_UNEXPECTED_EOF_WHILE_READING) {
+      ERR_clear_error();
+      return kClosed;
+    }
+    logError(sslErrors(), func);
+    return kError;
+  default:
+    logError(sslErrors(), func);
+    return kError;
+  }
+}
@@ -0,0 +1,198 @@
+#include "../include/Trace.h"
+#include "../include/Channel.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static_assert((Tracer::kRingCapacity & (Tracer::kRingCapacity - 1)) == 0,
+              "ring capacity must be a power of two");
+
+// 一个线程的环形缓冲区：只有所属线程写，导出时其他线程读。
+// head 是写入过的事件总数，写完一个槽位后 release 发布；读的一方复制完
+// 再看一次 head，复制期间可能被覆盖的槽位丢掉
+struct TraceRing {
+  std::unique_ptr<TraceEvent[]> events;
+  std::atomic<uint64_t> head{0};
+  pid_t tid = 0;
+  std::string threadName;
+};
+
+// 线程退出后缓冲区仍保留在这里，导出时照样能看到它的事件
+static std::mutex gRingsMutex;
+static std::vector<std::shared_ptr<TraceRing>> gRings;
+static thread_local TraceRing *tRing = nullptr;
+
+static TraceRing *createThreadRing() {
+  auto ring = std::make_shared<TraceRing>();
+  ring->events = std::make_unique<TraceEvent[]>(Tracer::kRingCapacity);
+  ring->tid = ::gettid();
+  char name[16] = {0};
+  if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0) {
+    ring->threadName = name;
+  }
+  std::lock_guard<std::mutex> lock(gRingsMutex);
+  gRings.push_back(ring);
+  tRing = ring.get();
+  return tRing;
+}
+
+void Tracer::record(const char *name, uint64_t start, uint64_t duration,
+                    uint64_t arg) {
+  TraceRing *ring = tRing != nullptr ? tRing : createThreadRing();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  ring->events[head & (kRingCapacity - 1)] =
+      TraceEvent{name, start, duration, arg};
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+// 复制一个线程缓冲区里仍然有效的事件
+static std::vector<TraceEvent> snapshot(const TraceRing &ring) {
+  uint64_t end = ring.head.load(std::memory_order_acquire);
+  uint64_t begin = end > Tracer::kRingCapacity ? end - Tracer::kRingCapacity
+                                               : 0;
+  std::vector<TraceEvent> events;
+  events.reserve(end - begin);
+  for (uint64_t i = begin; i < end; ++i) {
+    events.push_back(ring.events[i & (Tracer::kRingCapacity - 1)]);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  // 复制期间写入方又前进到 after，[after - 容量, after] 对应的槽位可能已被改写
+  uint64_t after = ring.head.load(std::memory_order_relaxed);
+  if (after + 1 > Tracer::kRingCapacity) {
+    uint64_t firstValid = after + 1 - Tracer::kRingCapacity;
+    if (firstValid > begin) {
+      size_t drop = static_cast<size_t>(
+          std::min<uint64_t>(firstValid - begin, events.size()));
+      events.erase(events.begin(), events.begin() + drop);
+    }
+  }
+  return events;
+}
+
+// Tracer::now() 计数和 steady_clock 纳秒的对应关系。进程启动时取一个锚点，
+// 导出时再取一个，两点之间的斜率就是每个计数的纳秒数
+struct TraceClock {
+  uint64_t ticks;
+  uint64_t ns;
+
+  static TraceClock sample() {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch());
+    return TraceClock{Tracer::now(), static_cast<uint64_t>(ns.count())};
+  }
+};
+
+static const TraceClock gClockAnchor = TraceClock::sample();
+
+static double nsPerTick() {
+#if defined(__x86_64__) || defined(__i386__)
+  TraceClock now = TraceClock::sample();
+  // 离锚点太近时斜率误差大，等一会儿再取
+  while (now.ns - gClockAnchor.ns < 10 * 1000 * 1000) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    now = TraceClock::sample();
+  }
+  return static_cast<double>(now.ns - gClockAnchor.ns) /
+         static_cast<double>(now.ticks - gClockAnchor.ticks);
+#else
+  return 1.0;
+#endif
+}
+
+/**
+ * @brief 导出为 Chrome trace 格式（JSON Object Format），"X" 为完整区间事件，
+ * 时间单位为微秒。chrome://tracing 和 ui.perfetto.dev 都能直接打开
+ */
+bool Tracer::dump(const std::string &path) {
+  std::vector<std::shared_ptr<TraceRing>> rings;
+  {
+    std::lock_guard<std::mutex> lock(gRingsMutex);
+    rings = gRings;
+  }
+  FILE *fp = ::fopen(path.c_str(), "w");
+  if (fp == nullptr) {
+    logError(path + ": " + strerror(errno), "Tracer::dump");
+    return false;
+  }
+  double scale = nsPerTick();
+  auto toUs = [scale](int64_t ticks) { return ticks * scale / 1e3; };
+  int pid = ::getpid();
+  size_t total = 0;
+  bool first = true;
+  std::fputs("{\"traceEvents\":[\n", fp);
+  for (const auto &ring : rings) {
+    std::fprintf(fp,
+                 "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                 "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 first ? "" : ",\n", pid, ring->tid,
+                 ring->threadName.c_str());
+    first = false;
+    for (const TraceEvent &e : snapshot(*ring)) {
+      std::fprintf(fp,
+                   ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                   "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"arg\":%llu}}",
+                   e.name, pid, ring->tid,
+                   gClockAnchor.ns / 1e3 +
+                       toUs(static_cast<int64_t>(e.start - gClockAnchor.ticks)),
+                   toUs(static_cast<int64_t>(e.duration)),
+                   static_cast<unsigned long long>(e.arg));
+      ++total;
+    }
+  }
+  std::fputs("\n]}\n", fp);
+  bool ok = std::fclose(fp) == 0;
+  log("Dumped " + std::to_string(total) + " trace events to " + path,
+      "Tracer::dump");
+  return ok;
+}
+
+static int gDumpPipe[2] = {-1, -1};
+
+static void onDumpSignal(int) {
+  int savedErrno = errno;
+  char c = 0;
+  [[maybe_unused]] ssize_t n = ::write(gDumpPipe[1], &c, 1);
+  errno = savedErrno;
+}
+
+bool Tracer::installDumpSignal(int sig, const std::string &path) {
+  if (gDumpPipe[0] >= 0) {
+    logError("dump signal already installed", "Tracer::installDumpSignal");
+    return false;
+  }
+  if (::pipe2(gDumpPipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+    logError(strerror(errno), "Tracer::installDumpSignal");
+    return false;
+  }
+  // 读端改回阻塞，后台线程阻塞在 read 上；写端保持非阻塞，信号处理函数不会卡住
+  ::fcntl(gDumpPipe[0], F_SETFL, 0);
+  std::thread([path]() {
+    char buf[64];
+    while (true) {
+      ssize_t n = ::read(gDumpPipe[0], buf, sizeof(buf));
+      if (n > 0) {
+        dump(path);
+      } else if (n < 0 && errno == EINTR) {
+        continue;
+      } else {
+        break;
+      }
+    }
+  }).detach();
+
+  struct sigaction sa;
+  std::memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onDumpSignal;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  return ::sigaction(sig, &sa, nullptr) == 0;
+}
@@ -0,0 +1,213 @@
+#include "../include/TrafficCapture.h"
+#include "../include/Channel.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+static constexpr char kMagic[4] = {'R', 'C', 'A', 'P'};
+// 单条记录内容的上限，读到更大的长度按文件损坏处理
+static constexpr uint64_t kMaxRecordSize = 1ULL << 30;
+
+static void putVarint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+// 写满 len 字节，失败返回 false
+static bool writeAll(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    len -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+std::shared_ptr<TrafficCapture> TrafficCapture::open(const std::string &path,
+                                                     size_t maxPending) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    logError(path + ": " + strerror(errno), "TrafficCapture::open");
+    return nullptr;
+  }
+  char header[sizeof(kMagic) + 1];
+  memcpy(header, kMagic, sizeof(kMagic));
+  header[sizeof(kMagic)] = static_cast<char>(kVersion);
+  if (!writeAll(fd, header, sizeof(header))) {
+    logError(path + ": " + strerror(errno), "TrafficCapture::open");
+    ::close(fd);
+    return nullptr;
+  }
+  return std::make_shared<TrafficCapture>(fd, maxPending);
+}
+
+TrafficCapture::TrafficCapture(int fd, size_t maxPending)
+    : fd_(fd), maxPending_(maxPending),
+      start_(std::chrono::steady_clock::now()),
+      writer_([this]() { writerLoop(); }) {}
+
+TrafficCapture::~TrafficCapture() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cond_.notify_one();
+  writer_.join();
+  ::close(fd_);
+}
+
+uint64_t TrafficCapture::openConnection(const std::string &peer) {
+  uint64_t connId = nextConnId_.fetch_add(1, std::memory_order_relaxed);
+  append(kOpen, connId, peer.data(), peer.size());
+  return connId;
+}
+
+void TrafficCapture::data(uint64_t connId, const char *data, size_t len) {
+  append(kData, connId, data, len);
+}
+
+void TrafficCapture::closeConnection(uint64_t connId) {
+  append(kClose, connId, nullptr, 0);
+}
+
+/**
+ * @brief 编码一条记录追加到待写缓冲区。时间在持锁时取，保证文件里的时间单调，
+ * 相邻记录只存差值。积压超限时数据记录换成这个连接的 kGap
+ */
+void TrafficCapture::append(RecordType type, uint64_t connId,
+                            const char *data, size_t len) {
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (type == kData && truncated_.count(connId) > 0) {
+      droppedBytes_.fetch_add(len, std::memory_order_relaxed);
+      return;
+    }
+    if (type == kData && pending_.size() + len > maxPending_) {
+      droppedBytes_.fetch_add(len, std::memory_order_relaxed);
+      truncatedConnections_.fetch_add(1, std::memory_order_relaxed);
+      truncated_.insert(connId);
+      type = kGap;
+      len = 0;
+    } else if (type == kClose) {
+      truncated_.erase(connId);
+    }
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start_)
+                      .count();
+    us = std::max(us, lastUs_);
+    pending_.push_back(static_cast<char>(type));
+    putVarint(pending_, connId);
+    putVarint(pending_, us - lastUs_);
+    putVarint(pending_, len);
+    pending_.append(data, len);
+    lastUs_ = us;
+    wake = pending_.size() >= kWakeThreshold;
+  }
+  if (wake) {
+    cond_.notify_one();
+  }
+}
+
+void TrafficCapture::writerLoop() {
+  std::string batch;
+  bool failed = false;
+  while (true) {
+    bool stopping = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait_for(lock, std::chrono::milliseconds(50), [this]() {
+        return stopping_ || pending_.size() >= kWakeThreshold;
+      });
+      // 交换后 pending_ 沿用上一批的存储，稳定后不再分配
+      batch.swap(pending_);
+      stopping = stopping_;
+    }
+    if (!batch.empty() && !failed &&
+        !writeAll(fd_, batch.data(), batch.size())) {
+      // 只报一次，之后的数据丢弃
+      logError(strerror(errno), "TrafficCapture");
+      failed = true;
+    }
+    batch.clear();
+    if (stopping) {
+      break;
+    }
+  }
+}
+
+CaptureReader::~CaptureReader() {
+  if (fp_ != nullptr) {
+    ::fclose(fp_);
+  }
+}
+
+bool CaptureReader::open(const std::string &path) {
+  fp_ = ::fopen(path.c_str(), "rb");
+  if (fp_ == nullptr) {
+    logError(path + ": " + strerror(errno), "CaptureReader::open");
+    return false;
+  }
+  char header[sizeof(kMagic) + 1];
+  if (::fread(header, 1, sizeof(header), fp_) != sizeof(header) ||
+      memcmp(header, kMagic, sizeof(kMagic)) != 0 ||
+      header[sizeof(kMagic)] < 1 ||
+      header[sizeof(kMagic)] > TrafficCapture::kVersion) {
+    logError(path + ": not a capture file", "CaptureReader::open");
+    return false;
+  }
+  return true;
+}
+
+bool CaptureReader::readVarint(uint64_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = ::fgetc(fp_);
+    if (c == EOF) {
+      return false;
+    }
+    value |= static_cast<uint64_t>(c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CaptureReader::next(CaptureRecord &record) {
+  if (fp_ == nullptr || corrupted_) {
+    return false;
+  }
+  int type = ::fgetc(fp_);
+  if (type == EOF) {
+    return false;
+  }
+  uint64_t connId = 0, deltaUs = 0, len = 0;
+  if (type < TrafficCapture::kOpen || type > TrafficCapture::kGap ||
+      !readVarint(connId) || !readVarint(deltaUs) || !readVarint(len) ||
+      len > kMaxRecordSize) {
+    corrupted_ = true;
+    return false;
+  }
+  record.data.resize(len);
+  if (len > 0 && ::fread(record.data.data(), 1, len, fp_) != len) {
+    corrupted_ = true;
+    return false;
+  }
+  timeUs_ += deltaUs;
+  record.type = static_cast<TrafficCapture::RecordType>(type);
+  record.connId = connId;
+  record.time = std::chrono::microseconds(timeUs_);
+  return true;
+}
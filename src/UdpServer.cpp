@@ -0,0 +1,377 @@
+#include "../include/UdpServer.h"
+#include "../include/Channel.h"
+#include "../include/EventLoop.h"
+#include "../include/EventLoopThreadPool.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// 一次 recvmmsg 读满一批后最多再读几批，防止一个繁忙的套接字独占 loop
+static constexpr int kMaxBatchesPerEvent = 8;
+// 内核限制：一次 GSO 最多 64 段，总长不超过一个 IPv4 UDP 报文
+static constexpr size_t kMaxGsoSegments = 64;
+static constexpr size_t kMaxUdpPayload = 65507;
+// GRO 合并后的报文最长 64KB
+static constexpr size_t kGroBufferSize = 65535;
+static constexpr size_t kRecvControlSize = CMSG_SPACE(sizeof(int));
+static constexpr size_t kSendControlSize = CMSG_SPACE(sizeof(uint16_t));
+
+/**
+ * @brief 创建非阻塞 UDP 套接字并绑定。GRO/GSO 在内核不支持时自动关闭
+ */
+UdpSocket::UdpSocket(EventLoop *loop, const InetAddress &bindAddr,
+                     const UdpOptions &options)
+    : loop_(loop), socket_(createNonblockingSocket(AF_INET, SOCK_DGRAM)),
+      channel_(socket_.getFd(), loop->getPoller()), options_(options),
+      outHead_(0), handlingRead_(false), flushScheduled_(false),
+      recvCalls_(0), recvDatagrams_(0), sendCalls_(0), sendDatagrams_(0) {
+  socket_.setReuseAddr(true);
+  socket_.setReusePort(true);
+  int fd = socket_.getFd();
+  if (options_.recvBufSize > 0) {
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &options_.recvBufSize,
+                 sizeof(options_.recvBufSize));
+  }
+  if (options_.sendBufSize > 0) {
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &options_.sendBufSize,
+                 sizeof(options_.sendBufSize));
+  }
+  if (options_.gro) {
+    int on = 1;
+    if (::setsockopt(fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) < 0) {
+      logError(std::string("UDP_GRO unavailable: ") + strerror(errno),
+               "UdpSocket");
+      options_.gro = false;
+    } else {
+      // 合并后的报文需要整块放得下，否则会被截断
+      options_.maxDatagramSize =
+          std::max(options_.maxDatagramSize, kGroBufferSize);
+    }
+  }
+  if (options_.gso) {
+    int segment = 0;
+    socklen_t len = sizeof(segment);
+    if (::getsockopt(fd, SOL_UDP, UDP_SEGMENT, &segment, &len) < 0) {
+      logError(std::string("UDP_SEGMENT unavailable: ") + strerror(errno),
+               "UdpSocket");
+      options_.gso = false;
+    }
+  }
+  options_.batchSize = std::max(options_.batchSize, 1);
+  socket_.bind(bindAddr);
+
+  // 接收批只分配一次，之后每次 recvmmsg 复用
+  const size_t batch = options_.batchSize;
+  recvData_.resize(batch * options_.maxDatagramSize);
+  recvMsgs_.resize(batch);
+  recvIovecs_.resize(batch);
+  recvAddrs_.resize(batch);
+  recvControl_.resize(options_.gro ? batch * kRecvControlSize : 0);
+  for (size_t i = 0; i < batch; ++i) {
+    recvIovecs_[i].iov_base = recvData_.data() + i * options_.maxDatagramSize;
+    recvIovecs_[i].iov_len = options_.maxDatagramSize;
+    struct msghdr &hdr = recvMsgs_[i].msg_hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_name = &recvAddrs_[i];
+    hdr.msg_iov = &recvIovecs_[i];
+    hdr.msg_iovlen = 1;
+    if (options_.gro) {
+      hdr.msg_control = recvControl_.data() + i * kRecvControlSize;
+    }
+  }
+  sendMsgs_.resize(batch);
+  sendIovecs_.resize(batch);
+  sendControl_.resize(options_.gso ? batch * kSendControlSize : 0);
+}
+
+// Poller 批量提交兴趣集修改，待提交队列里存着 Channel 指针，只关闭 fd
+// 不够：必须先 removeChannel 撤销待提交的修改，否则下一次 poll 会访问
+// 已经析构的 Channel。因此要在所属 loop 线程、loop 还在时析构
+UdpSocket::~UdpSocket() {
+  channel_.disableAll();
+  loop_->getPoller()->removeChannel(&channel_);
+}
+
+void UdpSocket::start() {
+  channel_.setReadCallback([this]() { handleRead(); });
+  channel_.setWriteCallback([this]() { handleWrite(); });
+  channel_.enableReading();
+}
+
+/**
+ * @brief 批量接收：每次 recvmmsg 读一批，回调里产生的回复在本轮结束后一次发出
+ */
+void UdpSocket::handleRead() {
+  handlingRead_ = true;
+  const int batch = options_.batchSize;
+  for (int round = 0; round < kMaxBatchesPerEvent; ++round) {
+    for (int i = 0; i < batch; ++i) {
+      struct msghdr &hdr = recvMsgs_[i].msg_hdr;
+      hdr.msg_namelen = sizeof(recvAddrs_[i]);
+      hdr.msg_controllen = options_.gro ? kRecvControlSize : 0;
+      hdr.msg_flags = 0;
+    }
+    int n = ::recvmmsg(socket_.getFd(), recvMsgs_.data(), batch, MSG_DONTWAIT,
+                       nullptr);
+    ++recvCalls_;
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        logError(strerror(errno), __func__);
+      }
+      break;
+    }
+    for (int i = 0; i < n; ++i) {
+      struct msghdr &hdr = recvMsgs_[i].msg_hdr;
+      if (hdr.msg_flags & MSG_TRUNC) {
+        logError("datagram larger than maxDatagramSize dropped", __func__);
+        continue;
+      }
+      int groSize = 0;
+      if (options_.gro) {
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+          if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            std::memcpy(&groSize, CMSG_DATA(cmsg), sizeof(groSize));
+          }
+        }
+      }
+      InetAddress peer;
+      peer.setAddr(reinterpret_cast<struct sockaddr *>(&recvAddrs_[i]),
+                   hdr.msg_namelen);
+      deliver(peer, static_cast<const char *>(recvIovecs_[i].iov_base),
+              recvMsgs_[i].msg_len, groSize);
+    }
+    if (n < batch) {
+      break;
+    }
+  }
+  handlingRead_ = false;
+  flush();
+}
+
+void UdpSocket::handleWrite() { flush(); }
+
+// GRO 合并的报文按 groSize 拆回原来的报文再交给回调
+void UdpSocket::deliver(const InetAddress &peer, const char *data, size_t len,
+                        int groSize) {
+  size_t segment = groSize > 0 ? static_cast<size_t>(groSize) : len;
+  if (segment == 0) {
+    // 空报文也是一个合法的报文
+    ++recvDatagrams_;
+    if (messageCallback_) {
+      messageCallback_(*this, peer, data, 0);
+    }
+    return;
+  }
+  for (size_t offset = 0; offset < len; offset += segment) {
+    ++recvDatagrams_;
+    if (messageCallback_) {
+      messageCallback_(*this, peer, data + offset,
+                       std::min(segment, len - offset));
+    }
+  }
+}
+
+void UdpSocket::send(const InetAddress &peer, const char *data, size_t len) {
+  if (!loop_->isInLoopThread()) {
+    loop_->queueInLoop([this, peer, msg = std::string(data, len)]() {
+      send(peer, msg.data(), msg.size());
+    });
+    return;
+  }
+  enqueue(peer, data, len, 0);
+  scheduleFlush();
+}
+
+void UdpSocket::sendSegmented(const InetAddress &peer, const char *data,
+                              size_t len, size_t segmentSize) {
+  if (segmentSize == 0 || len <= segmentSize) {
+    send(peer, data, len);
+    return;
+  }
+  if (segmentSize > kMaxUdpPayload) {
+    logError("segment size exceeds UDP payload limit", __func__);
+    return;
+  }
+  if (!loop_->isInLoopThread()) {
+    loop_->queueInLoop([this, peer, segmentSize,
+                        msg = std::string(data, len)]() {
+      sendSegmented(peer, msg.data(), msg.size(), segmentSize);
+    });
+    return;
+  }
+  if (options_.gso) {
+    // 每条消息带 UDP_SEGMENT，由内核（或网卡）切成 segmentSize 的报文
+    size_t segments =
+        std::clamp<size_t>(kMaxUdpPayload / segmentSize, 1, kMaxGsoSegments);
+    size_t chunk = segments * segmentSize;
+    for (size_t offset = 0; offset < len; offset += chunk) {
+      enqueue(peer, data + offset, std::min(chunk, len - offset),
+              static_cast<uint16_t>(segmentSize));
+    }
+  } else {
+    for (size_t offset = 0; offset < len; offset += segmentSize) {
+      enqueue(peer, data + offset, std::min(segmentSize, len - offset), 0);
+    }
+  }
+  scheduleFlush();
+}
+
+void UdpSocket::enqueue(const InetAddress &peer, const char *data, size_t len,
+                        uint16_t segmentSize) {
+  size_t offset = outData_.size();
+  outData_.insert(outData_.end(), data, data + len);
+  outQueue_.push_back(OutMessage{peer, offset, len, segmentSize});
+}
+
+// 在回调里发的回复等本轮接收结束后统一 flush；其他时候攒满一批立即发，
+// 不满一批就留到本轮 loop 的 pending 阶段，把同一轮里的多次 send 合并
+void UdpSocket::scheduleFlush() {
+  if (handlingRead_ || channel_.isWriting()) {
+    return;
+  }
+  if (outQueue_.size() - outHead_ >= static_cast<size_t>(options_.batchSize)) {
+    flush();
+    return;
+  }
+  if (!flushScheduled_) {
+    flushScheduled_ = true;
+    loop_->queueInLoop([this]() {
+      flushScheduled_ = false;
+      flush();
+    });
+  }
+}
+
+/**
+ * @brief 用 sendmmsg 每次发一批。发送缓冲区满时关注可写事件，剩下的等可写再发
+ */
+void UdpSocket::flush() {
+  const int fd = socket_.getFd();
+  while (outHead_ < outQueue_.size()) {
+    size_t n = std::min<size_t>(outQueue_.size() - outHead_,
+                                static_cast<size_t>(options_.batchSize));
+    for (size_t i = 0; i < n; ++i) {
+      const OutMessage &m = outQueue_[outHead_ + i];
+      sendIovecs_[i].iov_base = outData_.data() + m.offset;
+      sendIovecs_[i].iov_len = m.len;
+      struct msghdr &hdr = sendMsgs_[i].msg_hdr;
+      std::memset(&hdr, 0, sizeof(hdr));
+      hdr.msg_name = const_cast<struct sockaddr *>(m.peer.getAddr());
+      hdr.msg_namelen = m.peer.getAddrLen();
+      hdr.msg_iov = &sendIovecs_[i];
+      hdr.msg_iovlen = 1;
+      if (m.segmentSize > 0) {
+        hdr.msg_control = sendControl_.data() + i * kSendControlSize;
+        hdr.msg_controllen = kSendControlSize;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        std::memcpy(CMSG_DATA(cmsg), &m.segmentSize, sizeof(uint16_t));
+      }
+    }
+    int sent = ::sendmmsg(fd, sendMsgs_.data(), n, MSG_DONTWAIT);
+    ++sendCalls_;
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+        if (!channel_.isWriting()) {
+          channel_.enableWriting();
+        }
+        return;
+      }
+      // 队首这条发不出去（例如目的地址不可达），丢掉它继续发后面的
+      logError(strerror(errno), __func__);
+      ++outHead_;
+      continue;
+    }
+    for (int i = 0; i < sent; ++i) {
+      const OutMessage &m = outQueue_[outHead_ + i];
+      sendDatagrams_ +=
+          m.segmentSize > 0 ? (m.len + m.segmentSize - 1) / m.segmentSize : 1;
+    }
+    outHead_ += sent;
+  }
+  outQueue_.clear();
+  outData_.clear();
+  outHead_ = 0;
+  if (channel_.isWriting()) {
+    channel_.disableWriting();
+  }
+}
+
+UdpServer::UdpServer(const InetAddress &listenAddr, const UdpOptions &options)
+    : eventLoop_(std::make_unique<EventLoop>()),
+      threadPool_(std::make_unique<EventLoopThreadPool>(eventLoop_.get(), 0)),
+      numThreads_(0), listenAddr_(listenAddr), options_(options) {}
+
+/**
+ * @brief 先在各自的 loop 线程里析构套接字（从 Poller 摘下 Channel），
+ * 再停 I/O 线程；主 loop 此时已经退出（start() 已返回），直接析构
+ */
+UdpServer::~UdpServer() {
+  for (auto &sock : sockets_) {
+    EventLoop *loop = sock->getLoop();
+    if (loop == eventLoop_.get() || loop->isInLoopThread()) {
+      sock.reset();
+      continue;
+    }
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+    loop->queueInLoop([&]() {
+      sock.reset();
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+      cond.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&]() { return done; });
+  }
+  sockets_.clear();
+  threadPool_.reset();
+}
+
+void UdpServer::setThreadNum(int numThreads) {
+  numThreads_ = numThreads;
+  threadPool_ = std::make_unique<EventLoopThreadPool>(eventLoop_.get(),
+                                                      numThreads_, affinity_);
+}
+
+void UdpServer::setThreadAffinity(const ThreadAffinity &affinity) {
+  affinity_ = affinity;
+  threadPool_ = std::make_unique<EventLoopThreadPool>(eventLoop_.get(),
+                                                      numThreads_, affinity_);
+}
+
+/**
+ * @brief 每个 loop 绑定一个 SO_REUSEPORT 套接字。第一个套接字确定端口，
+ * 其余套接字绑定到同一端口
+ */
+void UdpServer::start() {
+  threadPool_->start();
+  for (EventLoop *loop : threadPool_->getAllLoops()) {
+    auto sock = std::make_unique<UdpSocket>(loop, listenAddr_, options_);
+    if (sockets_.empty()) {
+      listenAddr_ = sock->localAddress();
+    }
+    sock->setMessageCallback(messageCallback_);
+    UdpSocket *raw = sock.get();
+    loop->queueInLoop([raw]() { raw->start(); });
+    sockets_.push_back(std::move(sock));
+  }
+  log("UDP listening on " + listenAddr_.toString() + " with " +
+          std::to_string(sockets_.size()) + " socket(s)",
+      "UdpServer");
+  eventLoop_->loop();
+}
+
+void UdpServer::stop() { eventLoop_->quit(); }